@@ -0,0 +1,282 @@
+#pragma once
+#include <ice/coroutine.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Snapshots of previous runtime implementations that the benchmarks compare against.
+namespace baseline {
+
+class event {
+public:
+  event() noexcept = default;
+  event(const event& other) = delete;
+  event& operator=(const event& other) = delete;
+
+  virtual ~event() = default;
+
+  void resume() noexcept {
+    awaiter_.resume();
+  }
+
+  ice::coroutine_handle<> awaiter_;
+  std::atomic<event*> next_ = nullptr;
+};
+
+// The original ice::context.
+// Events are pushed onto a Treiber stack and resumed in LIFO order within a batch.
+// Every schedule call notifies the condition variable and the runner locks the mutex on every iteration.
+class lifo_context {
+public:
+  lifo_context() = default;
+
+  lifo_context(const lifo_context& other) = delete;
+  lifo_context& operator=(const lifo_context& other) = delete;
+
+  void run() noexcept {
+    thread_.store(std::this_thread::get_id(), std::memory_order_release);
+    std::unique_lock lock{ mutex_ };
+    lock.unlock();
+    while (true) {
+      lock.lock();
+      auto head = head_.exchange(nullptr, std::memory_order_acquire);
+      while (!head) {
+        if (stop_.load(std::memory_order_acquire)) {
+          lock.unlock();
+          return;
+        }
+        cv_.wait(lock, []() { return true; });
+        head = head_.exchange(nullptr, std::memory_order_acquire);
+      }
+      lock.unlock();
+      while (head) {
+        auto next = head->next_.load(std::memory_order_relaxed);
+        head->resume();
+        head = next;
+      }
+    }
+  }
+
+  bool is_current() const noexcept {
+    return thread_.load(std::memory_order_acquire) == std::this_thread::get_id();
+  }
+
+  void stop() noexcept {
+    stop_.store(true, std::memory_order_release);
+    cv_.notify_all();
+  }
+
+  void schedule(event* ev) noexcept {
+    auto head = head_.load(std::memory_order_acquire);
+    do {
+      ev->next_.store(head, std::memory_order_relaxed);
+    } while (!head_.compare_exchange_weak(head, ev, std::memory_order_release, std::memory_order_acquire));
+    cv_.notify_one();
+  }
+
+private:
+  std::atomic_bool stop_ = false;
+  std::atomic<event*> head_ = nullptr;
+  std::atomic<std::thread::id> thread_;
+  std::condition_variable cv_;
+  std::mutex mutex_;
+};
+
+// The ice::context with the FIFO queue, but before the parking protocol.
+// Every schedule call notifies the condition variable and the runner locks the mutex on every iteration.
+class notify_context {
+public:
+  notify_context() = default;
+
+  notify_context(const notify_context& other) = delete;
+  notify_context& operator=(const notify_context& other) = delete;
+
+  void run() noexcept {
+    thread_.store(std::this_thread::get_id(), std::memory_order_release);
+    std::unique_lock lock{ mutex_ };
+    lock.unlock();
+    while (true) {
+      lock.lock();
+      while (empty()) {
+        if (stop_.load(std::memory_order_acquire)) {
+          lock.unlock();
+          return;
+        }
+        cv_.wait(lock, []() { return true; });
+      }
+      lock.unlock();
+      drain();
+    }
+  }
+
+  bool is_current() const noexcept {
+    return thread_.load(std::memory_order_acquire) == std::this_thread::get_id();
+  }
+
+  void stop() noexcept {
+    stop_.store(true, std::memory_order_release);
+    cv_.notify_all();
+  }
+
+  void schedule(event* ev) noexcept {
+    push(ev);
+    cv_.notify_one();
+  }
+
+private:
+  void push(event* ev) noexcept {
+    ev->next_.store(nullptr, std::memory_order_relaxed);
+    const auto back = back_.exchange(ev, std::memory_order_acq_rel);
+    back->next_.store(ev, std::memory_order_release);
+  }
+
+  bool empty() const noexcept {
+    return front_ == &stub_ && back_.load(std::memory_order_acquire) == &stub_;
+  }
+
+  event* pop() noexcept {
+    auto front = front_;
+    auto next = front->next_.load(std::memory_order_acquire);
+    if (front == &stub_) {
+      if (!next) {
+        return nullptr;
+      }
+      front_ = front = next;
+      next = next->next_.load(std::memory_order_acquire);
+    }
+    if (next) {
+      front_ = next;
+      return front;
+    }
+    if (front != back_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    push(&stub_);
+    next = front->next_.load(std::memory_order_acquire);
+    if (next) {
+      front_ = next;
+      return front;
+    }
+    return nullptr;
+  }
+
+  void drain() noexcept {
+    const auto last = back_.load(std::memory_order_acquire);
+    while (const auto ev = pop()) {
+      const auto done = ev == last;
+      ev->resume();
+      if (done) {
+        break;
+      }
+    }
+  }
+
+  std::atomic_bool stop_ = false;
+  event stub_;
+  std::atomic<event*> back_ = &stub_;
+  event* front_ = &stub_;
+  std::atomic<std::thread::id> thread_;
+  std::condition_variable cv_;
+  std::mutex mutex_;
+};
+
+// Minimal eagerly started task that allocates every coroutine frame with the global operator new.
+template <typename T>
+class task {
+public:
+  struct promise_type {
+    task get_return_object() noexcept {
+      return task{ ice::coroutine_handle<promise_type>::from_promise(*this) };
+    }
+
+    ice::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    auto final_suspend() noexcept {
+      struct awaitable {
+        bool await_ready() const noexcept {
+          return false;
+        }
+
+        void await_suspend(ice::coroutine_handle<promise_type> coroutine) noexcept {
+          if (const auto continuation = coroutine.promise().continuation) {
+            continuation.resume();
+          }
+        }
+
+        void await_resume() noexcept {
+        }
+      };
+      return awaitable{};
+    }
+
+    void return_value(T result) noexcept {
+      value = result;
+    }
+
+    void unhandled_exception() noexcept {
+    }
+
+    T value{};
+    ice::coroutine_handle<> continuation;
+  };
+
+  explicit task(ice::coroutine_handle<promise_type> coroutine) noexcept : coroutine_(coroutine) {
+  }
+
+  task(task&& other) noexcept : coroutine_(std::exchange(other.coroutine_, nullptr)) {
+  }
+
+  ~task() {
+    if (coroutine_) {
+      coroutine_.destroy();
+    }
+  }
+
+  bool is_ready() const noexcept {
+    return coroutine_.done();
+  }
+
+  bool await_ready() const noexcept {
+    return coroutine_.done();
+  }
+
+  void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+    coroutine_.promise().continuation = awaiter;
+  }
+
+  T await_resume() noexcept {
+    return coroutine_.promise().value;
+  }
+
+private:
+  ice::coroutine_handle<promise_type> coroutine_;
+};
+
+template <typename Context>
+class schedule final : public event {
+public:
+  schedule(Context& context, bool post = false) noexcept : context_(context), ready_(!post && context.is_current()) {
+  }
+
+  constexpr bool await_ready() const noexcept {
+    return ready_;
+  }
+
+  void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+    awaiter_ = awaiter;
+    context_.schedule(this);
+  }
+
+  constexpr void await_resume() const noexcept {
+  }
+
+private:
+  Context& context_;
+  const bool ready_ = true;
+};
+
+}  // namespace baseline
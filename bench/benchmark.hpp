@@ -0,0 +1,85 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace bench {
+
+using clock = std::chrono::steady_clock;
+
+// Returns the number of global operator new calls since the program started.
+std::uint64_t allocations() noexcept;
+
+struct counter {
+  std::string name;
+  double value = 0.0;
+  std::string unit;
+};
+
+class result {
+public:
+  void add(std::string name, double value, std::string unit = {}) {
+    counters_.push_back({ std::move(name), value, std::move(unit) });
+  }
+
+  const std::vector<counter>& counters() const noexcept {
+    return counters_;
+  }
+
+private:
+  std::vector<counter> counters_;
+};
+
+using function = void (*)(result& result);
+
+struct entry {
+  const char* name;
+  function call;
+};
+
+inline std::vector<entry>& registry() {
+  static std::vector<entry> entries;
+  return entries;
+}
+
+struct registration {
+  registration(const char* name, function call) {
+    registry().push_back({ name, call });
+  }
+};
+
+inline double seconds(clock::duration duration) noexcept {
+  return std::chrono::duration<double>(duration).count();
+}
+
+inline std::uint64_t nanoseconds(clock::duration duration) noexcept {
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+// Sorts the samples and returns the value at the given percentile (0.0 - 1.0).
+inline double percentile(std::vector<std::uint64_t>& samples, double p) {
+  if (samples.empty()) {
+    return 0.0;
+  }
+  std::sort(samples.begin(), samples.end());
+  const auto index = static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1) + 0.5);
+  return static_cast<double>(samples[std::min(index, samples.size() - 1)]);
+}
+
+// Adds p50, p99, p99.9 and max counters for the given latency samples in nanoseconds.
+inline void add_latency(result& result, const std::string& prefix, std::vector<std::uint64_t>& samples) {
+  result.add(prefix + "p50", percentile(samples, 0.5), "ns");
+  result.add(prefix + "p99", percentile(samples, 0.99), "ns");
+  result.add(prefix + "p999", percentile(samples, 0.999), "ns");
+  result.add(prefix + "max", percentile(samples, 1.0), "ns");
+}
+
+}  // namespace bench
+
+#define BENCHMARK(name)                                                                                                                    \
+  static void name(bench::result& result);                                                                                                 \
+  static const bench::registration name##_registration{ #name, name };                                                                     \
+  static void name(bench::result& result)
@@ -0,0 +1,87 @@
+#include "benchmark.hpp"
+#include <ice/context.hpp>
+#include <ice/io_service.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <ice/thread_pool.hpp>
+#include <installer/chunk_cache.hpp>
+#include <installer/extract.hpp>
+#include <installer/package.hpp>
+#include <installer/package_writer.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <cstdlib>
+
+namespace {
+
+constexpr std::size_t files = 16;
+constexpr std::size_t file_size = 4 << 20;
+constexpr std::size_t installs = 4;
+
+ice::task<std::error_code> run_extract(ice::context& context, const installer::package& package, const std::filesystem::path& target,
+  ice::thread_pool& pool, ice::io_service& service, installer::extract_options options) noexcept {
+  co_await ice::schedule(context, true);
+  co_return co_await installer::extract(package, target, pool, service, options);
+}
+
+// Installs a package of 64 MiB four times into fresh directories and reports the time of the repeated installs.
+void run_repeat(bench::result& result, bool cached) {
+  const auto root = std::filesystem::temp_directory_path() / "installer-bench-cache";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "source");
+  std::string data(file_size, '\0');
+  for (std::size_t i = 0; i < files; i++) {
+    for (std::size_t j = 0; j < data.size(); j++) {
+      data[j] = static_cast<char>((j * 2654435761u >> 24) % (i + 8));
+    }
+    std::ofstream{ root / "source" / std::to_string(i), std::ios::binary }.write(data.data(), data.size());
+  }
+  std::error_code ec;
+  installer::write_package(root / "source", root / "package", ec);
+  const auto package = installer::package::open(root / "package", ec);
+  if (ec) {
+    std::abort();
+  }
+
+  ice::context context;
+  ice::io_service service{ context };
+  ice::thread_pool pool;
+  std::thread runner([&]() { context.run(); });
+
+  installer::chunk_cache cache{ 256 << 20 };
+  installer::extract_options options;
+  options.incremental = false;
+  options.cache = cached ? &cache : nullptr;
+  auto duration = bench::clock::duration{};
+  for (std::size_t i = 0; i < installs && !ec; i++) {
+    const auto start = bench::clock::now();
+    ec = ice::sync_wait(run_extract(context, package, root / std::to_string(i), pool, service, options));
+    if (i) {
+      duration += bench::clock::now() - start;
+    }
+  }
+
+  context.stop();
+  runner.join();
+  std::filesystem::remove_all(root);
+  if (ec) {
+    std::abort();
+  }
+
+  const auto stats = cache.stats();
+  result.add("hits", static_cast<double>(stats.hits));
+  result.add("misses", static_cast<double>(stats.misses));
+  result.add("time", bench::seconds(duration) * 1e3 / (installs - 1), "ms");
+}
+
+}  // namespace
+
+BENCHMARK(chunk_cache_repeat_install) {
+  run_repeat(result, true);
+}
+
+BENCHMARK(chunk_cache_repeat_install_uncached_baseline) {
+  run_repeat(result, false);
+}
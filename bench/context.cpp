@@ -0,0 +1,253 @@
+#include "baseline.hpp"
+#include "benchmark.hpp"
+#include <ice/context.hpp>
+#include <ice/task.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t producers = 4;
+constexpr std::size_t events = 1 << 20;
+constexpr std::size_t burst = 1024;
+
+template <typename Schedule, typename Context>
+ice::task<void> probe(Context& context, std::uint64_t& sample, std::atomic<std::size_t>& done) noexcept {
+  const auto start = bench::clock::now();
+  co_await Schedule(context, true);
+  sample = bench::nanoseconds(bench::clock::now() - start);
+  done.fetch_add(1, std::memory_order_release);
+}
+
+// Posts bursts of events from several producer threads and measures the time from schedule to resume.
+template <typename Context, typename Schedule>
+void run_queue(bench::result& result) {
+  Context context;
+  std::thread runner([&]() { context.run(); });
+
+  std::vector<std::uint64_t> samples(events);
+  std::atomic<std::size_t> done = 0;
+  std::vector<std::thread> threads;
+  const auto start = bench::clock::now();
+  for (std::size_t i = 0; i < producers; i++) {
+    threads.emplace_back([&, i]() {
+      for (auto j = i; j < events; j += producers) {
+        probe<Schedule>(context, samples[j], done).detach();
+        if (j % burst == 0) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  while (done.load(std::memory_order_acquire) < events) {
+    std::this_thread::yield();
+  }
+  const auto duration = bench::clock::now() - start;
+
+  context.stop();
+  runner.join();
+
+  result.add("events", static_cast<double>(events));
+  result.add("throughput", events / bench::seconds(duration), "events/s");
+  bench::add_latency(result, "latency_", samples);
+}
+
+template <typename Schedule, typename Context>
+ice::task<void> post(Context& context, std::atomic<std::size_t>& done) noexcept {
+  co_await Schedule(context, true);
+  done.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Posts events from several producer threads as fast as possible while the runner is busy.
+template <typename Context, typename Schedule>
+void run_throughput(bench::result& result) {
+  Context context;
+  std::thread runner([&]() { context.run(); });
+
+  std::atomic<std::size_t> done = 0;
+  std::vector<std::thread> threads;
+  const auto start = bench::clock::now();
+  for (std::size_t i = 0; i < producers; i++) {
+    threads.emplace_back([&]() {
+      for (std::size_t j = 0; j < events / producers; j++) {
+        post<Schedule>(context, done).detach();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  while (done.load(std::memory_order_acquire) < events) {
+    std::this_thread::yield();
+  }
+  const auto duration = bench::clock::now() - start;
+
+  context.stop();
+  runner.join();
+
+  result.add("events", static_cast<double>(events));
+  result.add("throughput", events / bench::seconds(duration), "events/s");
+}
+
+// Posts one event at a time and waits for it, so that the runner has to be woken up for every event.
+template <typename Context, typename Schedule>
+void run_ping_pong(bench::result& result) {
+  constexpr std::size_t rounds = 1 << 14;
+
+  Context context;
+  std::thread runner([&]() { context.run(); });
+
+  std::atomic<std::size_t> done = 0;
+  const auto start = bench::clock::now();
+  for (std::size_t i = 0; i < rounds; i++) {
+    post<Schedule>(context, done).detach();
+    while (done.load(std::memory_order_acquire) <= i) {
+      std::this_thread::yield();
+    }
+  }
+  const auto duration = bench::clock::now() - start;
+
+  context.stop();
+  runner.join();
+
+  result.add("rounds", static_cast<double>(rounds));
+  result.add("round_trip", static_cast<double>(bench::nanoseconds(duration) / rounds), "ns");
+}
+
+ice::task<void> yield(ice::context& context, std::vector<std::uint64_t>& samples, std::atomic<bool>& done) noexcept {
+  co_await ice::schedule(context, true);
+  for (auto& sample : samples) {
+    const auto start = bench::clock::now();
+    co_await ice::schedule(context, true);
+    sample = bench::nanoseconds(bench::clock::now() - start);
+  }
+  done.store(true, std::memory_order_release);
+}
+
+// Reposts a coroutine to the context it runs on, which measures schedule and resume without other threads.
+void run_yield(bench::result& result) {
+  ice::context context;
+  std::thread runner([&]() { context.run(); });
+
+  std::vector<std::uint64_t> samples(events);
+  std::atomic<bool> done = false;
+  const auto start = bench::clock::now();
+  yield(context, samples, done).detach();
+  while (!done.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  const auto duration = bench::clock::now() - start;
+
+  context.stop();
+  runner.join();
+
+  result.add("events", static_cast<double>(events));
+  result.add("throughput", events / bench::seconds(duration), "events/s");
+  bench::add_latency(result, "latency_", samples);
+}
+
+ice::task<void> bulk(ice::context& context, std::atomic<std::size_t>& done) noexcept {
+  co_await ice::schedule(context, true);
+  const auto end = bench::clock::now() + std::chrono::microseconds(1);
+  while (bench::clock::now() < end) {
+  }
+  done.fetch_add(1, std::memory_order_release);
+}
+
+ice::task<void> control(ice::context& context, ice::priority priority, std::uint64_t& sample, std::atomic<bool>& done) noexcept {
+  const auto start = bench::clock::now();
+  co_await ice::schedule(context, priority, true);
+  sample = bench::nanoseconds(bench::clock::now() - start);
+  done.store(true, std::memory_order_release);
+}
+
+// Keeps a backlog of bulk events that each take a microsecond on the runner and measures the time from schedule to
+// resume of control events that are posted one at a time on the given lane.
+void run_priority(bench::result& result, ice::priority priority) {
+  constexpr std::size_t backlog = 4096;
+  constexpr std::size_t probes = 1024;
+
+  ice::context context;
+  std::thread runner([&]() { context.run(); });
+
+  std::atomic<std::size_t> done = 0;
+  std::atomic<bool> stop = false;
+  std::size_t posted = 0;
+  std::thread producer([&]() {
+    while (!stop.load(std::memory_order_acquire)) {
+      if (posted - done.load(std::memory_order_acquire) < backlog) {
+        bulk(context, done).detach();
+        posted++;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  std::vector<std::uint64_t> samples(probes);
+  const auto start = bench::clock::now();
+  for (auto& sample : samples) {
+    std::atomic<bool> resumed = false;
+    control(context, priority, sample, resumed).detach();
+    while (!resumed.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+  const auto duration = bench::clock::now() - start;
+  const auto completed = done.load(std::memory_order_acquire);
+
+  stop.store(true, std::memory_order_release);
+  producer.join();
+  while (done.load(std::memory_order_acquire) < posted) {
+    std::this_thread::yield();
+  }
+  context.stop();
+  runner.join();
+
+  result.add("probes", static_cast<double>(probes));
+  result.add("bulk_throughput", completed / bench::seconds(duration), "events/s");
+  bench::add_latency(result, "latency_", samples);
+}
+
+}  // namespace
+
+BENCHMARK(context_priority_high) {
+  run_priority(result, ice::priority::high);
+}
+
+BENCHMARK(context_priority_bulk_baseline) {
+  run_priority(result, ice::priority::bulk);
+}
+
+BENCHMARK(context_yield) {
+  run_yield(result);
+}
+
+BENCHMARK(context_queue_fifo) {
+  run_queue<ice::context, ice::schedule>(result);
+}
+
+BENCHMARK(context_queue_lifo_baseline) {
+  run_queue<baseline::lifo_context, baseline::schedule<baseline::lifo_context>>(result);
+}
+
+BENCHMARK(context_post_throughput) {
+  run_throughput<ice::context, ice::schedule>(result);
+}
+
+BENCHMARK(context_post_throughput_notify_baseline) {
+  run_throughput<baseline::notify_context, baseline::schedule<baseline::notify_context>>(result);
+}
+
+BENCHMARK(context_ping_pong) {
+  run_ping_pong<ice::context, ice::schedule>(result);
+}
+
+BENCHMARK(context_ping_pong_notify_baseline) {
+  run_ping_pong<baseline::notify_context, baseline::schedule<baseline::notify_context>>(result);
+}
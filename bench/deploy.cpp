@@ -0,0 +1,98 @@
+#include "benchmark.hpp"
+#include <ice/context.hpp>
+#include <ice/io_service.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <ice/thread_pool.hpp>
+#include <installer/deploy.hpp>
+#include <installer/directory_transport.hpp>
+#include <installer/package.hpp>
+#include <installer/package_writer.hpp>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+
+constexpr std::size_t targets = 8;
+constexpr std::size_t files = 32;
+constexpr std::size_t file_size = 256 << 10;
+
+ice::task<installer::deploy_result> run_deploy(ice::context& context, const installer::package& package,
+  std::span<installer::transport* const> transports, ice::thread_pool& pool) noexcept {
+  co_await ice::schedule(context, true);
+  co_return co_await installer::deploy(package, transports, context, pool);
+}
+
+// Deploys a package of 32 files with 256 KiB each to 8 directories, either to all of them at once or one after
+// the other, which decodes the package once per target.
+void run_targets(bench::result& result, bool shared) {
+  const auto root = std::filesystem::temp_directory_path() / "installer-bench-deploy";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "source");
+  std::string data(file_size, '\0');
+  for (std::size_t i = 0; i < files; i++) {
+    for (std::size_t j = 0; j < data.size(); j++) {
+      data[j] = static_cast<char>((j * 2654435761u >> 24) % (i + 8));
+    }
+    std::ofstream{ root / "source" / std::to_string(i), std::ios::binary }.write(data.data(), data.size());
+  }
+  std::error_code ec;
+  installer::write_package(root / "source", root / "package", ec);
+  const auto package = installer::package::open(root / "package", ec);
+  if (ec) {
+    std::abort();
+  }
+
+  ice::context context;
+  ice::io_service service{ context };
+  ice::thread_pool pool;
+  std::thread runner([&]() { context.run(); });
+
+  std::vector<std::unique_ptr<installer::directory_transport>> transports;
+  std::vector<installer::transport*> pointers;
+  for (std::size_t i = 0; i < targets; i++) {
+    transports.push_back(std::make_unique<installer::directory_transport>(service, root / std::to_string(i)));
+    pointers.push_back(transports.back().get());
+  }
+  std::uint64_t decoded = 0;
+  const auto start = bench::clock::now();
+  if (shared) {
+    const auto deployed = ice::sync_wait(run_deploy(context, package, pointers, pool));
+    decoded = deployed.decoded;
+    ec = deployed.errors.front();
+  } else {
+    for (const auto pointer : pointers) {
+      const auto deployed = ice::sync_wait(run_deploy(context, package, { &pointer, 1 }, pool));
+      decoded += deployed.decoded;
+      ec = ec ? ec : deployed.errors.front();
+    }
+  }
+  const auto duration = bench::clock::now() - start;
+
+  context.stop();
+  runner.join();
+  std::filesystem::remove_all(root);
+  if (ec) {
+    std::abort();
+  }
+
+  result.add("targets", static_cast<double>(targets));
+  result.add("decoded", static_cast<double>(decoded) / 1e6, "MB");
+  result.add("time", bench::seconds(duration) * 1e3, "ms");
+  result.add("throughput", static_cast<double>(targets * files * file_size) / bench::seconds(duration) / 1e6, "MB/s");
+}
+
+}  // namespace
+
+BENCHMARK(deploy_targets) {
+  run_targets(result, true);
+}
+
+BENCHMARK(deploy_targets_sequential_baseline) {
+  run_targets(result, false);
+}
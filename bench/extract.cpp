@@ -0,0 +1,78 @@
+#include "benchmark.hpp"
+#include <ice/context.hpp>
+#include <ice/io_service.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <ice/thread_pool.hpp>
+#include <installer/extract.hpp>
+#include <installer/package.hpp>
+#include <installer/package_writer.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <cstdlib>
+
+namespace {
+
+constexpr std::size_t files = 100'000;
+constexpr std::size_t directories = 100;
+
+ice::task<std::error_code> run_extract(ice::context& context, const installer::package& package, const std::filesystem::path& target,
+  ice::thread_pool& pool, ice::io_service& service, installer::extract_options options) noexcept {
+  co_await ice::schedule(context, true);
+  co_return co_await installer::extract(package, target, pool, service, options);
+}
+
+// Installs a package of 100k files between 64 bytes and 4 KiB in 100 directories into an empty directory.
+void run_small_files(bench::result& result, bool journal) {
+  const auto root = std::filesystem::temp_directory_path() / "installer-bench-extract";
+  std::filesystem::remove_all(root);
+  std::string data;
+  for (std::size_t i = 0; i < files; i++) {
+    const auto directory = root / "source" / std::to_string(i % directories);
+    if (i < directories) {
+      std::filesystem::create_directories(directory);
+    }
+    data.assign(64 + (i * 2654435761u >> 12) % 4032, static_cast<char>('a' + i % 26));
+    std::ofstream{ directory / std::to_string(i), std::ios::binary }.write(data.data(), data.size());
+  }
+  std::error_code ec;
+  installer::write_package(root / "source", root / "package", ec);
+  const auto package = installer::package::open(root / "package", ec);
+  if (ec) {
+    std::abort();
+  }
+
+  ice::context context;
+  ice::io_service service{ context };
+  ice::thread_pool pool;
+  std::thread runner([&]() { context.run(); });
+
+  installer::extract_options options;
+  options.journal = journal;
+  const auto start = bench::clock::now();
+  ec = ice::sync_wait(run_extract(context, package, root / "target", pool, service, options));
+  const auto duration = bench::clock::now() - start;
+
+  context.stop();
+  runner.join();
+  std::filesystem::remove_all(root);
+  if (ec) {
+    std::abort();
+  }
+
+  result.add("files", static_cast<double>(files));
+  result.add("time", bench::seconds(duration) * 1e3, "ms");
+  result.add("throughput", static_cast<double>(files) / bench::seconds(duration), "files/s");
+}
+
+}  // namespace
+
+BENCHMARK(extract_small_files) {
+  run_small_files(result, true);
+}
+
+BENCHMARK(extract_small_files_unjournaled) {
+  run_small_files(result, false);
+}
@@ -0,0 +1,41 @@
+#include "benchmark.hpp"
+#include <installer/hash.hpp>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+
+constexpr std::size_t size = 256 << 20;
+constexpr std::size_t chunk = 1 << 20;
+
+// Hashes 256 MiB in package sized chunks and reports the throughput of one thread.
+void run_hash(bench::result& result, installer::blake3::kernel kernel) {
+  std::vector<std::byte> data(size);
+  for (std::size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<std::byte>(i * 2654435761u >> 24);
+  }
+  const auto reference = installer::hash(std::span{ data }.first(chunk), installer::blake3::kernel::portable);
+  if (installer::hash(std::span{ data }.first(chunk), kernel) != reference) {
+    std::abort();
+  }
+
+  const auto start = bench::clock::now();
+  volatile std::uint8_t sink = 0;
+  for (std::size_t offset = 0; offset < size; offset += chunk) {
+    sink = sink ^ installer::hash(std::span{ data }.subspan(offset, chunk), kernel).bytes[0];
+  }
+  const auto duration = bench::clock::now() - start;
+  result.add("bytes", static_cast<double>(size));
+  result.add("lanes", static_cast<double>(installer::blake3::lanes(kernel)));
+  result.add("throughput", static_cast<double>(size) / bench::seconds(duration) / 1e9, "GB/s");
+}
+
+}  // namespace
+
+BENCHMARK(hash_throughput) {
+  run_hash(result, installer::blake3::best());
+}
+
+BENCHMARK(hash_throughput_scalar_baseline) {
+  run_hash(result, installer::blake3::kernel::portable);
+}
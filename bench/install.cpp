@@ -0,0 +1,104 @@
+#include "benchmark.hpp"
+#include <ice/context.hpp>
+#include <ice/io_service.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <ice/thread_pool.hpp>
+#include <installer/extract.hpp>
+#include <installer/package.hpp>
+#include <installer/package_writer.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+
+constexpr std::size_t installs = 5;
+
+struct shape {
+  std::size_t files;
+  std::size_t directories;
+  std::size_t min_size;
+  std::size_t max_size;
+};
+
+ice::task<std::error_code> run_extract(ice::context& context, const installer::package& package, const std::filesystem::path& target,
+  ice::thread_pool& pool, ice::io_service& service) noexcept {
+  co_await ice::schedule(context, true);
+  co_return co_await installer::extract(package, target, pool, service);
+}
+
+// Writes a package of files with partly compressible contents and installs it into fresh directories.
+// Reports the median of all installs, since file system timings vary a lot between runs.
+void run_install(bench::result& result, const shape& shape) {
+  const auto root = std::filesystem::temp_directory_path() / "installer-bench-install";
+  std::filesystem::remove_all(root);
+  std::string data;
+  std::uint64_t bytes = 0;
+  for (std::size_t i = 0; i < shape.files; i++) {
+    const auto directory = root / "source" / std::to_string(i % shape.directories);
+    if (i < shape.directories) {
+      std::filesystem::create_directories(directory);
+    }
+    data.resize(shape.min_size + (i * 2654435761u >> 8) % (shape.max_size - shape.min_size + 1));
+    for (std::size_t j = 0; j < data.size(); j++) {
+      data[j] = static_cast<char>(((i + j) * 2654435761u >> 24) % 48);
+    }
+    std::ofstream{ directory / std::to_string(i), std::ios::binary }.write(data.data(), data.size());
+    bytes += data.size();
+  }
+  std::error_code ec;
+  installer::write_package(root / "source", root / "package", ec);
+  const auto package = installer::package::open(root / "package", ec);
+  if (ec) {
+    std::abort();
+  }
+
+  ice::context context;
+  ice::io_service service{ context };
+  ice::thread_pool pool;
+  std::thread runner([&]() { context.run(); });
+
+  std::vector<std::uint64_t> samples;
+  for (std::size_t i = 0; i < installs && !ec; i++) {
+    const auto start = bench::clock::now();
+    ec = ice::sync_wait(run_extract(context, package, root / std::to_string(i), pool, service));
+    samples.push_back(bench::nanoseconds(bench::clock::now() - start));
+  }
+
+  context.stop();
+  runner.join();
+  std::filesystem::remove_all(root);
+  if (ec) {
+    std::abort();
+  }
+
+  const auto seconds = bench::percentile(samples, 0.5) / 1e9;
+  result.add("files", static_cast<double>(shape.files));
+  result.add("bytes", static_cast<double>(bytes));
+  result.add("time", seconds * 1e3, "ms");
+  result.add("min_time", bench::percentile(samples, 0.0) / 1e6, "ms");
+  result.add("throughput", static_cast<double>(bytes) / seconds / 1e6, "MB/s");
+  result.add("file_rate", static_cast<double>(shape.files) / seconds, "files/s");
+}
+
+}  // namespace
+
+// 16 files of 32 to 128 KiB.
+BENCHMARK(install_small_package) {
+  run_install(result, { 16, 1, 32 << 10, 128 << 10 });
+}
+
+// 64 files of 512 KiB to 2 MiB, several chunks each.
+BENCHMARK(install_medium_package) {
+  run_install(result, { 64, 8, 512 << 10, 2 << 20 });
+}
+
+// 10k files of 64 bytes to 1 KiB in 100 directories.
+BENCHMARK(install_tiny_files_package) {
+  run_install(result, { 10'000, 100, 64, 1 << 10 });
+}
@@ -0,0 +1,137 @@
+#include "benchmark.hpp"
+#include <atomic>
+#include <new>
+#include <string_view>
+#include <thread>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocations = 0;
+
+}  // namespace
+
+std::uint64_t bench::allocations() noexcept {
+  return g_allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (const auto ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  std::abort();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+// Writes a string with the characters that JSON requires to be escaped.
+void write_string(std::FILE* file, std::string_view string) {
+  std::fputc('"', file);
+  for (const auto c : string) {
+    if (c == '"' || c == '\\') {
+      std::fprintf(file, "\\%c", c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      std::fprintf(file, "\\u%04x", static_cast<unsigned>(c));
+    } else {
+      std::fputc(c, file);
+    }
+  }
+  std::fputc('"', file);
+}
+
+void write_text(std::FILE* file, const char* name, const bench::result& result) {
+  std::fprintf(file, "%s\n", name);
+  for (const auto& counter : result.counters()) {
+    std::fprintf(file, "  %-24s %16.2f %s\n", counter.name.c_str(), counter.value, counter.unit.c_str());
+  }
+}
+
+// Writes one element of the benchmarks array. Values that JSON cannot represent are written as null.
+void write_json(std::FILE* file, const char* name, const bench::result& result, bool first) {
+  std::fprintf(file, "%s\n    { \"name\": ", first ? "" : ",");
+  write_string(file, name);
+  std::fprintf(file, ", \"counters\": {");
+  for (std::size_t i = 0; i < result.counters().size(); i++) {
+    const auto& counter = result.counters()[i];
+    std::fprintf(file, "%s\n      ", i ? "," : "");
+    write_string(file, counter.name);
+    if (std::isfinite(counter.value)) {
+      std::fprintf(file, ": { \"value\": %.17g, \"unit\": ", counter.value);
+    } else {
+      std::fprintf(file, ": { \"value\": null, \"unit\": ");
+    }
+    write_string(file, counter.unit);
+    std::fprintf(file, " }");
+  }
+  std::fprintf(file, "%s}}", result.counters().empty() ? "" : "\n    ");
+}
+
+}  // namespace
+
+// Usage: benchmark [--json] [--output=<file>] [filter]
+// Runs the benchmarks whose names contain the filter. With --json, the results are written as one JSON document
+// instead of text once all benchmarks have finished.
+int main(int argc, char* argv[]) {
+  const char* filter = nullptr;
+  const char* output = nullptr;
+  auto json = false;
+  for (int i = 1; i < argc; i++) {
+    const std::string_view argument = argv[i];
+    if (argument == "--json") {
+      json = true;
+    } else if (argument.starts_with("--output=")) {
+      output = argv[i] + 9;
+    } else if (!argument.starts_with("--") && !filter) {
+      filter = argv[i];
+    } else {
+      std::fprintf(stderr, "usage: benchmark [--json] [--output=<file>] [filter]\n");
+      return EXIT_FAILURE;
+    }
+  }
+  auto file = stdout;
+  if (output) {
+    file = std::fopen(output, "wb");
+    if (!file) {
+      std::perror(output);
+      return EXIT_FAILURE;
+    }
+  }
+  if (json) {
+    std::fprintf(file, "{\n  \"threads\": %u,\n  \"benchmarks\": [", std::thread::hardware_concurrency());
+  }
+  auto first = true;
+  for (const auto& entry : bench::registry()) {
+    if (filter && !std::strstr(entry.name, filter)) {
+      continue;
+    }
+    bench::result result;
+    entry.call(result);
+    if (json) {
+      write_json(file, entry.name, result, first);
+      std::fprintf(stderr, "%s\n", entry.name);
+    } else {
+      write_text(file, entry.name, result);
+    }
+    std::fflush(file);
+    first = false;
+  }
+  if (json) {
+    std::fprintf(file, "\n  ]\n}\n");
+  }
+  if (output) {
+    std::fclose(file);
+  }
+  return EXIT_SUCCESS;
+}
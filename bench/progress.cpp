@@ -0,0 +1,91 @@
+#include "benchmark.hpp"
+#include <ice/context.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <installer/progress.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+
+constexpr std::size_t workers = 4;
+constexpr std::size_t events = 1 << 22;
+constexpr std::uint64_t event_size = 4096;
+
+// Fake user interface that counts the updates it receives.
+class counting_sink : public installer::progress_sink {
+public:
+  void update(const installer::progress::state& state) noexcept override {
+    updates++;
+    last = state;
+  }
+
+  std::uint64_t updates = 0;
+  installer::progress::state last;
+};
+
+template <typename Add>
+bench::clock::duration run_workers(Add add) {
+  std::vector<std::thread> threads;
+  const auto start = bench::clock::now();
+  for (std::size_t i = 0; i < workers; i++) {
+    threads.emplace_back([&]() {
+      for (std::size_t j = 0; j < events / workers; j++) {
+        add(j);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return bench::clock::now() - start;
+}
+
+}  // namespace
+
+// Adds written bytes and files from several worker threads while report() samples them at 60 Hz and sends one
+// coalesced update per tick to a fake sink.
+BENCHMARK(progress_updates) {
+  ice::context context;
+  std::thread runner([&]() { context.run(); });
+  installer::progress progress;
+  counting_sink sink;
+  progress.start(events / 16, events * event_size);
+  auto report = installer::report(context, progress, sink, std::chrono::milliseconds(16));
+  const auto duration = run_workers([&](std::size_t j) {
+    progress.add(event_size, j % 16 == 0 ? 1 : 0);
+  });
+  progress.finish();
+  ice::sync_wait(std::move(report));
+  context.stop();
+  runner.join();
+  if (sink.last.bytes != events * event_size || sink.last.files != events / 16 || !sink.last.done) {
+    std::abort();
+  }
+  result.add("events", static_cast<double>(events));
+  result.add("throughput", events / bench::seconds(duration), "events/s");
+  result.add("updates", static_cast<double>(sink.updates));
+}
+
+// Sends an update to the sink for every event, which is what a user interface does that is driven directly by
+// the workers.
+BENCHMARK(progress_per_event_baseline) {
+  std::mutex mutex;
+  installer::progress::state state;
+  state.total_files = events / 16;
+  state.total_bytes = events * event_size;
+  counting_sink sink;
+  const auto duration = run_workers([&](std::size_t j) {
+    std::lock_guard lock{ mutex };
+    state.bytes += event_size;
+    state.files += j % 16 == 0 ? 1 : 0;
+    sink.update(state);
+  });
+  result.add("events", static_cast<double>(events));
+  result.add("throughput", events / bench::seconds(duration), "events/s");
+  result.add("updates", static_cast<double>(sink.updates));
+}
@@ -0,0 +1,208 @@
+#include "baseline.hpp"
+#include "benchmark.hpp"
+#include <ice/coroutine.hpp>
+#include <ice/lazy_task.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#ifdef _MSC_VER
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+namespace {
+
+constexpr std::size_t tasks = 1'000'000;
+
+template <template <typename> class Task>
+Task<int> leaf(int value) noexcept {
+  co_return value + 1;
+}
+
+template <template <typename> class Task>
+Task<int> loop(std::size_t count) noexcept {
+  int sum = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    sum += co_await leaf<Task>(static_cast<int>(i & 0xFF));
+  }
+  co_return sum;
+}
+
+// Awaits a million small tasks and counts how often the global operator new was called.
+template <template <typename> class Task>
+void run_allocations(bench::result& result) {
+  // Warm up the frame cache of this thread.
+  loop<Task>(1024).is_ready();
+
+  const auto allocations = bench::allocations();
+  const auto start = bench::clock::now();
+  auto task = loop<Task>(tasks);
+  const auto duration = bench::clock::now() - start;
+  if (!task.is_ready()) {
+    std::abort();
+  }
+
+  result.add("tasks", static_cast<double>(tasks));
+  result.add("allocations", static_cast<double>(bench::allocations() - allocations));
+  result.add("time_per_task", static_cast<double>(bench::nanoseconds(duration)) / tasks, "ns");
+}
+
+// Awaitable that suspends until the benchmark resumes it manually.
+struct trigger {
+  constexpr bool await_ready() const noexcept {
+    return false;
+  }
+
+  void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+    this->awaiter = awaiter;
+  }
+
+  constexpr void await_resume() const noexcept {
+  }
+
+  ice::coroutine_handle<> awaiter;
+};
+
+BENCH_NOINLINE std::uintptr_t stack_address() noexcept {
+  volatile char marker = 0;
+  return reinterpret_cast<std::uintptr_t>(&marker);
+}
+
+struct stack_range {
+  void update() noexcept {
+    const auto address = stack_address();
+    lowest = std::min(lowest, address);
+    highest = std::max(highest, address);
+  }
+
+  std::uintptr_t lowest = UINTPTR_MAX;
+  std::uintptr_t highest = 0;
+};
+
+template <template <typename> class Task>
+Task<int> chain(std::size_t depth, trigger& trigger, stack_range& stack) noexcept {
+  if (depth == 0) {
+    co_await trigger;
+    stack.update();
+    co_return 0;
+  }
+  const auto value = co_await chain<Task>(depth - 1, trigger, stack);
+  stack.update();
+  co_return value + 1;
+}
+
+// Builds a chain of suspended tasks and measures how much native stack is used when the innermost task
+// completes and the completion propagates to the outermost one.
+template <template <typename> class Task>
+void run_chain(bench::result& result) {
+  constexpr std::size_t depth = 4096;
+  trigger trigger;
+  stack_range stack;
+  auto task = chain<Task>(depth, trigger, stack);
+  stack = {};
+  stack.update();
+  const auto start = bench::clock::now();
+  trigger.awaiter.resume();
+  const auto duration = bench::clock::now() - start;
+  if (!task.is_ready()) {
+    std::abort();
+  }
+  result.add("depth", static_cast<double>(depth));
+  result.add("stack", static_cast<double>(stack.highest - stack.lowest), "bytes");
+  result.add("time_per_level", static_cast<double>(bench::nanoseconds(duration)) / depth, "ns");
+}
+
+template <template <typename> class Task>
+Task<int> step(trigger& trigger) noexcept {
+  co_await trigger;
+  co_return 1;
+}
+
+template <template <typename> class Task>
+Task<int> steps(std::size_t count, trigger& trigger, stack_range& stack) noexcept {
+  int sum = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    sum += co_await step<Task>(trigger);
+    stack.update();
+  }
+  co_return sum;
+}
+
+// Awaits a million tasks in a loop where every task suspends once and is resumed from the outside.
+template <template <typename> class Task>
+void run_loop(bench::result& result) {
+  trigger trigger;
+  stack_range stack;
+  stack.update();
+  const auto start = bench::clock::now();
+  auto task = steps<Task>(tasks, trigger, stack);
+  while (!task.is_ready()) {
+    trigger.awaiter.resume();
+  }
+  const auto duration = bench::clock::now() - start;
+  result.add("tasks", static_cast<double>(tasks));
+  result.add("stack", static_cast<double>(stack.highest - stack.lowest), "bytes");
+  result.add("time_per_task", static_cast<double>(bench::nanoseconds(duration)) / tasks, "ns");
+}
+
+template <template <typename> class Task>
+Task<int> await_chain(std::size_t depth) noexcept {
+  if (depth == 0) {
+    co_return 0;
+  }
+  co_return co_await await_chain<Task>(depth - 1) + 1;
+}
+
+// Awaits a chain of tasks that complete without suspending, driven from the outside by sync_wait.
+// Eager tasks run every level to completion on the stack while they are created and pay for the atomic state
+// exchange on each await. Lazy tasks start each level with symmetric transfer when it is awaited.
+template <template <typename> class Task>
+void run_await_chain(bench::result& result) {
+  constexpr std::size_t depth = 1024;
+  constexpr std::size_t iterations = 1024;
+  ice::sync_wait(await_chain<Task>(depth));
+
+  const auto start = bench::clock::now();
+  for (std::size_t i = 0; i < iterations; i++) {
+    if (ice::sync_wait(await_chain<Task>(depth)) != static_cast<int>(depth)) {
+      std::abort();
+    }
+  }
+  const auto duration = bench::clock::now() - start;
+  result.add("depth", static_cast<double>(depth));
+  result.add("time_per_await", static_cast<double>(bench::nanoseconds(duration)) / (depth * iterations), "ns");
+}
+
+}  // namespace
+
+BENCHMARK(task_allocations) {
+  run_allocations<ice::task>(result);
+}
+
+BENCHMARK(task_allocations_heap_baseline) {
+  run_allocations<baseline::task>(result);
+}
+
+BENCHMARK(task_chain) {
+  run_chain<ice::task>(result);
+}
+
+BENCHMARK(task_chain_nested_resume_baseline) {
+  run_chain<baseline::task>(result);
+}
+
+BENCHMARK(task_loop) {
+  run_loop<ice::task>(result);
+}
+
+BENCHMARK(task_await_chain) {
+  run_await_chain<ice::task>(result);
+}
+
+BENCHMARK(lazy_task_await_chain) {
+  run_await_chain<ice::lazy_task>(result);
+}
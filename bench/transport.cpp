@@ -0,0 +1,70 @@
+#include "benchmark.hpp"
+#include <ice/context.hpp>
+#include <ice/io_service.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <installer/directory_transport.hpp>
+#include <installer/transport.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+
+constexpr std::size_t files = 64;
+constexpr std::size_t file_size = 1 << 20;
+constexpr auto latency = std::chrono::milliseconds(1);
+
+ice::task<std::error_code> run_push(ice::context& context, installer::transport& transport, const std::filesystem::path& source,
+  installer::push_options options) noexcept {
+  co_await ice::schedule(context, true);
+  co_return co_await installer::push(transport, source, options);
+}
+
+// Pushes 64 files of 1 MiB to a directory that acknowledges every operation after 1 ms.
+void run_transport(bench::result& result, std::size_t window) {
+  const auto root = std::filesystem::temp_directory_path() / "installer-bench-transport";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "source");
+  const std::string data(file_size, 'x');
+  for (std::size_t i = 0; i < files; i++) {
+    std::ofstream{ root / "source" / std::to_string(i), std::ios::binary }.write(data.data(), data.size());
+  }
+
+  ice::context context;
+  ice::io_service service{ context };
+  std::thread runner([&]() { context.run(); });
+
+  installer::directory_transport transport{ service, root / "target", context, latency };
+  installer::push_options options;
+  options.window = window;
+  const auto start = bench::clock::now();
+  const auto ec = ice::sync_wait(run_push(context, transport, root / "source", options));
+  const auto duration = bench::clock::now() - start;
+
+  context.stop();
+  runner.join();
+  std::filesystem::remove_all(root);
+  if (ec) {
+    std::abort();
+  }
+
+  const auto operations = files * (file_size / options.chunk_size + 2);
+  result.add("operations", static_cast<double>(operations));
+  result.add("window", static_cast<double>(window));
+  result.add("time", bench::seconds(duration) * 1e3, "ms");
+  result.add("throughput", static_cast<double>(files * file_size) / bench::seconds(duration) / 1e6, "MB/s");
+}
+
+}  // namespace
+
+BENCHMARK(transport_push) {
+  run_transport(result, installer::push_options{}.window);
+}
+
+BENCHMARK(transport_push_serial_baseline) {
+  run_transport(result, 1);
+}
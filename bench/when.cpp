@@ -0,0 +1,96 @@
+#include "benchmark.hpp"
+#include <ice/coroutine.hpp>
+#include <ice/task.hpp>
+#include <ice/when_all.hpp>
+#include <ice/when_any.hpp>
+#include <utility>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+
+constexpr std::size_t fan_out = 8;
+constexpr std::size_t iterations = 100'000;
+
+// Awaitable that suspends until the benchmark resumes it manually.
+struct trigger {
+  constexpr bool await_ready() const noexcept {
+    return false;
+  }
+
+  void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+    this->awaiter = awaiter;
+  }
+
+  constexpr void await_resume() const noexcept {
+  }
+
+  ice::coroutine_handle<> awaiter;
+};
+
+ice::task<int> child(trigger& trigger) noexcept {
+  co_await trigger;
+  co_return 1;
+}
+
+ice::task<void> all(std::vector<ice::task<int>>& tasks) noexcept {
+  co_await ice::when_all(tasks);
+}
+
+ice::task<void> any(std::vector<ice::task<int>> tasks) noexcept {
+  auto [index, task] = co_await ice::when_any(std::move(tasks));
+  co_await std::move(task);
+}
+
+// Fans out to tasks that suspend, resumes them in order and reports the global operator new calls per call
+// of the combinator. Task frames come from the frame pool and the vector of when_all is reused, so the
+// allocations of when_any are its shared state and the vector that it takes over.
+template <typename Call>
+void run(bench::result& result, Call call) {
+  trigger triggers[fan_out];
+  std::vector<ice::task<int>> tasks;
+  tasks.reserve(fan_out);
+  const auto iteration = [&]() {
+    tasks.clear();
+    for (auto& trigger : triggers) {
+      tasks.push_back(child(trigger));
+    }
+    auto task = call(tasks);
+    for (auto& trigger : triggers) {
+      trigger.awaiter.resume();
+    }
+    if (!task.is_ready()) {
+      std::abort();
+    }
+  };
+  for (std::size_t i = 0; i < 1024; i++) {
+    iteration();
+  }
+
+  const auto allocations = bench::allocations();
+  const auto start = bench::clock::now();
+  for (std::size_t i = 0; i < iterations; i++) {
+    iteration();
+  }
+  const auto duration = bench::clock::now() - start;
+  result.add("tasks", static_cast<double>(fan_out));
+  result.add("allocations_per_call", static_cast<double>(bench::allocations() - allocations) / iterations);
+  result.add("time_per_call", static_cast<double>(bench::nanoseconds(duration)) / iterations, "ns");
+}
+
+}  // namespace
+
+BENCHMARK(when_all_fan_out) {
+  run(result, [](std::vector<ice::task<int>>& tasks) { return all(tasks); });
+}
+
+BENCHMARK(when_any_fan_out) {
+  run(result, [](std::vector<ice::task<int>>& tasks) {
+    std::vector<ice::task<int>> taken;
+    taken.reserve(tasks.size());
+    for (auto& task : tasks) {
+      taken.push_back(std::move(task));
+    }
+    return any(std::move(taken));
+  });
+}
@@ -0,0 +1,424 @@
+#include <ice/context.hpp>
+#include <ice/io_service.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <ice/thread_pool.hpp>
+#include <ice/trace.hpp>
+#include <installer/deploy.hpp>
+#include <installer/directory_transport.hpp>
+#include <installer/extract.hpp>
+#include <installer/hash.hpp>
+#include <installer/package.hpp>
+#include <installer/package_writer.hpp>
+#include <installer/progress.hpp>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+constexpr const char* usage = R"(usage: installer-cli <command> [options] <arguments>
+
+commands:
+  pack [--chunk-size=<bytes>] [--store] [--base=<directory>] <source> <package>
+  install [--full] [--no-journal] [--no-verify] [--memory=<bytes>] [--progress] [--trace=<file>] <package> <target>
+  verify [--trace=<file>] <package>
+  deploy [--bandwidth=<bytes/s>] [--no-verify] [--trace=<file>] <package> <target>...
+
+--progress prints the progress of the install to stderr.
+--trace writes the spans of the run in the Chrome trace format and prints the time spent in every stage.
+)";
+
+using clock = std::chrono::steady_clock;
+
+// Command line arguments of a command, split into options and positional arguments. Options with a value are
+// given as --name=value.
+class arguments {
+public:
+  arguments(int argc, char* argv[]) noexcept {
+    for (int i = 0; i < argc; i++) {
+      const std::string_view argument = argv[i];
+      if (argument.starts_with("--")) {
+        options_.push_back(argument);
+      } else {
+        positional_.push_back(argument);
+      }
+    }
+  }
+
+  // Returns true and removes the option if it was given.
+  bool flag(std::string_view name) noexcept {
+    const auto it = std::find(options_.begin(), options_.end(), name);
+    if (it == options_.end()) {
+      return false;
+    }
+    options_.erase(it);
+    return true;
+  }
+
+  // Returns the value of the option and removes it, or the default value if the option was not given.
+  std::string_view value(std::string_view name, std::string_view value = {}) noexcept {
+    for (auto it = options_.begin(); it != options_.end(); ++it) {
+      if (it->size() > name.size() && it->starts_with(name) && (*it)[name.size()] == '=') {
+        value = it->substr(name.size() + 1);
+        options_.erase(it);
+        valid_ = valid_ && !value.empty();
+        return value;
+      }
+    }
+    return value;
+  }
+
+  std::uint64_t number(std::string_view name, std::uint64_t value) noexcept {
+    const auto text = this->value(name);
+    if (text.empty()) {
+      return value;
+    }
+    char* end = nullptr;
+    const std::string string{ text };
+    value = std::strtoull(string.c_str(), &end, 10);
+    valid_ = valid_ && end && !*end;
+    return value;
+  }
+
+  const std::vector<std::string_view>& positional() const noexcept {
+    return positional_;
+  }
+
+  // Returns true if all options were recognized and the number of positional arguments is in range.
+  bool valid(std::size_t min, std::size_t max) const noexcept {
+    return valid_ && options_.empty() && positional_.size() >= min && positional_.size() <= max;
+  }
+
+private:
+  std::vector<std::string_view> options_;
+  std::vector<std::string_view> positional_;
+  bool valid_ = true;
+};
+
+// Context, io_service and thread pool that commands run on.
+class runtime {
+public:
+  runtime() noexcept {
+    thread_ = std::thread([this]() { context.run(); });
+  }
+
+  runtime(runtime&& other) = delete;
+  runtime(const runtime& other) = delete;
+  runtime& operator=(runtime&& other) = delete;
+  runtime& operator=(const runtime& other) = delete;
+
+  ~runtime() {
+    context.stop();
+    thread_.join();
+  }
+
+  // Calls the factory on the context and blocks until the task it returns has completed.
+  // Tasks start eagerly, so they must be created on the context instead of being passed in.
+  template <typename Factory>
+  auto run(Factory factory) noexcept {
+    return ice::sync_wait(start(context, std::move(factory)));
+  }
+
+  ice::context context;
+  ice::io_service service{ context };
+  ice::thread_pool pool;
+
+private:
+  template <typename Factory>
+  static decltype(std::declval<Factory&>()()) start(ice::context& context, Factory factory) noexcept {
+    co_await ice::schedule(context, true);
+    co_return co_await factory();
+  }
+
+  std::thread thread_;
+};
+
+double milliseconds(clock::duration duration) noexcept {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+double megabytes_per_second(std::uint64_t bytes, clock::duration duration) noexcept {
+  const auto seconds = std::chrono::duration<double>(duration).count();
+  return seconds > 0.0 ? static_cast<double>(bytes) / seconds / 1e6 : 0.0;
+}
+
+int fail(std::string_view what, const std::error_code& ec) noexcept {
+  std::fprintf(stderr, "installer-cli: %.*s: %s\n", static_cast<int>(what.size()), what.data(), ec.message().c_str());
+  return EXIT_FAILURE;
+}
+
+// Starts tracing if a trace file was requested.
+std::string trace_path(arguments& arguments) {
+  std::string path{ arguments.value("--trace") };
+  ice::trace::enable(!path.empty());
+  return path;
+}
+
+// Stops tracing, writes the trace file and prints the statistics of every stage.
+void write_trace(const std::string& path) noexcept {
+  if (path.empty()) {
+    return;
+  }
+  ice::trace::enable(false);
+  if (const auto file = std::fopen(path.c_str(), "wb")) {
+    ice::trace::write_chrome_trace(file);
+    std::fclose(file);
+  } else {
+    std::perror(path.c_str());
+  }
+  std::printf("%-16s %10s %12s %12s %12s %12s\n", "stage", "count", "total ms", "p50 us", "p99 us", "MB/s");
+  for (const auto& stage : ice::trace::stats()) {
+    const auto seconds = static_cast<double>(stage.total) / 1e9;
+    std::printf("%-16s %10llu %12.1f %12.1f %12.1f %12.1f\n", stage.name, static_cast<unsigned long long>(stage.count), seconds * 1e3,
+      static_cast<double>(stage.percentile(0.5)) / 1e3, static_cast<double>(stage.percentile(0.99)) / 1e3,
+      stage.bytes && seconds > 0.0 ? static_cast<double>(stage.bytes) / seconds / 1e6 : 0.0);
+  }
+}
+
+// Prints progress updates to stderr on a single line.
+class progress_line : public installer::progress_sink {
+public:
+  void update(const installer::progress::state& state) noexcept override {
+    std::fprintf(stderr, "\r%5.1f%% %llu/%llu files", state.fraction() * 100.0, static_cast<unsigned long long>(state.files),
+      static_cast<unsigned long long>(state.total_files));
+    if (state.done) {
+      std::fputc('\n', stderr);
+    }
+  }
+};
+
+std::uint64_t package_size(const installer::package& package) noexcept {
+  std::uint64_t size = 0;
+  for (const auto& file : package.files()) {
+    size += file.size;
+  }
+  return size;
+}
+
+// Decompresses every chunk on the thread pool and checks it against its digest, and checks the chunk digests of
+// every file that is not a delta against the file digest.
+ice::task<std::error_code> verify(const installer::package& package, ice::thread_pool& pool) noexcept {
+  if (!package.verify()) {
+    co_return installer::package_errc::corrupt_index;
+  }
+  std::error_code ec;
+  std::deque<ice::task<installer::detail::chunk_data>> window;
+  const auto complete = [&window, &ec]() -> ice::task<void> {
+    const auto chunk = co_await std::move(window.front());
+    window.pop_front();
+    if (!chunk.valid && !ec) {
+      ec = installer::package_errc::corrupt_chunk;
+    }
+  };
+  for (const auto& chunk : package.chunks()) {
+    if (window.size() == pool.size() * 2) {
+      co_await complete();
+    }
+    if (const auto error = package.validate(chunk)) {
+      ec = error;
+      break;
+    }
+    if (chunk.compression == installer::format::compression::none) {
+      window.push_back(installer::detail::stored(pool, chunk, package.data(chunk), true));
+    } else {
+      auto buffer = std::make_unique<std::byte[]>(chunk.size);
+      const auto output = std::span{ buffer.get(), chunk.size };
+      window.push_back(installer::detail::decompress(pool, chunk, package.data(chunk), output, std::move(buffer), true));
+    }
+  }
+  while (!window.empty()) {
+    co_await complete();
+  }
+  for (const auto& file : package.files()) {
+    if (ec) {
+      break;
+    }
+    if (ec = package.validate(file); ec || package.delta(file)) {
+      continue;
+    }
+    installer::hasher digests;
+    for (const auto ref : package.refs(file)) {
+      digests.update(std::as_bytes(std::span{ package.chunk(ref).digest.bytes }));
+    }
+    if (digests.finalize() != file.digest) {
+      ec = installer::package_errc::corrupt_index;
+    }
+  }
+  co_return ec;
+}
+
+int pack(arguments& arguments) noexcept {
+  installer::package_options options;
+  options.chunk_size = static_cast<std::uint32_t>(arguments.number("--chunk-size", options.chunk_size));
+  options.base = arguments.value("--base");
+  if (arguments.flag("--store")) {
+    options.compression = installer::format::compression::none;
+  }
+  if (!arguments.valid(2, 2) || !options.chunk_size) {
+    std::fputs(usage, stderr);
+    return EXIT_FAILURE;
+  }
+  const std::filesystem::path source{ arguments.positional()[0] };
+  const std::filesystem::path target{ arguments.positional()[1] };
+  std::error_code ec;
+  const auto start = clock::now();
+  installer::write_package(source, target, ec, options);
+  if (ec) {
+    return fail("pack", ec);
+  }
+  const auto duration = clock::now() - start;
+  const auto package = installer::package::open(target, ec);
+  if (ec) {
+    return fail("pack", ec);
+  }
+  const auto size = package_size(package);
+  std::printf("packed %zu files, %llu bytes in %.1f ms (%.1f MB/s)\n", package.files().size(), static_cast<unsigned long long>(size),
+    milliseconds(duration), megabytes_per_second(size, duration));
+  return EXIT_SUCCESS;
+}
+
+int install(arguments& arguments) noexcept {
+  installer::extract_options options;
+  options.memory = static_cast<std::size_t>(arguments.number("--memory", options.memory));
+  options.incremental = !arguments.flag("--full");
+  options.journal = !arguments.flag("--no-journal");
+  options.verify = !arguments.flag("--no-verify");
+  const auto show_progress = arguments.flag("--progress");
+  const auto trace = trace_path(arguments);
+  if (!arguments.valid(2, 2)) {
+    std::fputs(usage, stderr);
+    return EXIT_FAILURE;
+  }
+  std::error_code ec;
+  const auto package = installer::package::open(std::filesystem::path{ arguments.positional()[0] }, ec);
+  if (ec) {
+    return fail("install", ec);
+  }
+  const std::filesystem::path target{ arguments.positional()[1] };
+  runtime runtime;
+  installer::progress progress;
+  progress_line line;
+  if (show_progress) {
+    options.progress = &progress;
+  }
+  const auto start = clock::now();
+  ec = runtime.run([&]() -> ice::task<std::error_code> {
+    if (!show_progress) {
+      co_return co_await installer::extract(package, target, runtime.pool, runtime.service, options);
+    }
+    progress.start(0, 0);
+    auto report = installer::report(runtime.context, progress, line);
+    const auto ec = co_await installer::extract(package, target, runtime.pool, runtime.service, options);
+    co_await std::move(report);
+    co_return ec;
+  });
+  const auto duration = clock::now() - start;
+  write_trace(trace);
+  if (ec) {
+    return fail("install", ec);
+  }
+  const auto size = package_size(package);
+  std::printf("installed %zu files, %llu bytes in %.1f ms (%.1f MB/s)\n", package.files().size(), static_cast<unsigned long long>(size),
+    milliseconds(duration), megabytes_per_second(size, duration));
+  return EXIT_SUCCESS;
+}
+
+int verify(arguments& arguments) noexcept {
+  const auto trace = trace_path(arguments);
+  if (!arguments.valid(1, 1)) {
+    std::fputs(usage, stderr);
+    return EXIT_FAILURE;
+  }
+  std::error_code ec;
+  const auto package = installer::package::open(std::filesystem::path{ arguments.positional()[0] }, ec);
+  if (ec) {
+    return fail("verify", ec);
+  }
+  runtime runtime;
+  const auto start = clock::now();
+  ec = runtime.run([&]() {
+    return verify(package, runtime.pool);
+  });
+  const auto duration = clock::now() - start;
+  write_trace(trace);
+  if (ec) {
+    return fail("verify", ec);
+  }
+  std::printf("verified %zu files, %zu chunks in %.1f ms\n", package.files().size(), package.chunks().size(), milliseconds(duration));
+  return EXIT_SUCCESS;
+}
+
+int deploy(arguments& arguments) noexcept {
+  installer::deploy_options options;
+  options.bandwidth = arguments.number("--bandwidth", options.bandwidth);
+  options.verify = !arguments.flag("--no-verify");
+  const auto trace = trace_path(arguments);
+  if (!arguments.valid(2, SIZE_MAX)) {
+    std::fputs(usage, stderr);
+    return EXIT_FAILURE;
+  }
+  std::error_code ec;
+  const auto package = installer::package::open(std::filesystem::path{ arguments.positional()[0] }, ec);
+  if (ec) {
+    return fail("deploy", ec);
+  }
+  runtime runtime;
+  std::vector<std::unique_ptr<installer::directory_transport>> transports;
+  std::vector<installer::transport*> targets;
+  for (std::size_t i = 1; i < arguments.positional().size(); i++) {
+    transports.push_back(std::make_unique<installer::directory_transport>(runtime.service, std::filesystem::path{ arguments.positional()[i] }));
+    targets.push_back(transports.back().get());
+  }
+  const auto start = clock::now();
+  const auto result = runtime.run([&]() {
+    return installer::deploy(package, targets, runtime.context, runtime.pool, options);
+  });
+  const auto duration = clock::now() - start;
+  write_trace(trace);
+  auto status = EXIT_SUCCESS;
+  for (std::size_t i = 0; i < result.errors.size(); i++) {
+    if (result.errors[i]) {
+      status = fail(transports[i]->root().string(), result.errors[i]);
+    }
+  }
+  std::printf("deployed %zu files to %zu targets, %llu bytes decoded, %llu bytes written in %.1f ms (%.1f MB/s)\n", package.files().size(),
+    targets.size(), static_cast<unsigned long long>(result.decoded), static_cast<unsigned long long>(result.written), milliseconds(duration),
+    megabytes_per_second(result.written, duration));
+  return status;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::fputs(usage, stderr);
+    return EXIT_FAILURE;
+  }
+  const std::string_view command = argv[1];
+  arguments arguments{ argc - 2, argv + 2 };
+  if (command == "pack") {
+    return pack(arguments);
+  }
+  if (command == "install") {
+    return install(arguments);
+  }
+  if (command == "verify") {
+    return verify(arguments);
+  }
+  if (command == "deploy") {
+    return deploy(arguments);
+  }
+  std::fputs(usage, stderr);
+  return EXIT_FAILURE;
+}
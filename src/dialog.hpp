@@ -1,4 +1,5 @@
 #pragma once
+#include <ice/coroutine.hpp>
 #include <ice/task.hpp>
 #include <windows.h>
 #include <commctrl.h>
@@ -37,7 +38,7 @@ public:
       return GetCurrentThreadId() == GetWindowThreadProcessId(hwnd_, nullptr);
     }
 
-    void await_suspend(std::experimental::coroutine_handle<> coroutine) noexcept {
+    void await_suspend(ice::coroutine_handle<> coroutine) noexcept {
       coroutine_ = coroutine;
       PostMessage(hwnd_, WM_DIALOG_CREATE, 0, reinterpret_cast<LPARAM>(this));
     }
@@ -51,7 +52,7 @@ public:
 
   private:
     const HWND hwnd_;
-    std::experimental::coroutine_handle<> coroutine_;
+    ice::coroutine_handle<> coroutine_;
   };
 
   Dialog(HINSTANCE hinstance, HWND parent, UINT id, UINT icon) : hinstance_(hinstance), id_(id), icon_(icon) {
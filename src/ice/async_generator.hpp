@@ -0,0 +1,235 @@
+#pragma once
+#include <ice/coroutine.hpp>
+#include <ice/frame_pool.hpp>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <cassert>
+
+namespace ice {
+
+template <typename T>
+class async_generator;
+
+namespace detail {
+
+class async_generator_promise_base {
+public:
+  constexpr async_generator_promise_base() noexcept = default;
+
+  static void* operator new(std::size_t size) {
+    return frame_pool::allocate(size);
+  }
+
+  static void operator delete(void* ptr, std::size_t size) noexcept {
+    frame_pool::deallocate(ptr, size);
+  }
+
+  constexpr auto initial_suspend() noexcept {
+    return ice::suspend_always{};
+  }
+
+  auto final_suspend() noexcept {
+    return yield_awaitable{ consumer_ };
+  }
+
+#ifndef _MSC_VER
+  void unhandled_exception() noexcept {
+    assert(false);
+  }
+#endif
+
+  constexpr void return_void() noexcept {
+  }
+
+  void set_consumer(ice::coroutine_handle<> consumer) noexcept {
+    consumer_ = consumer;
+  }
+
+protected:
+  // Suspends the producer and resumes the consumer with symmetric transfer.
+  struct yield_awaitable {
+    constexpr yield_awaitable(ice::coroutine_handle<> consumer) noexcept : consumer_(consumer) {
+    }
+
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    ice::coroutine_handle<> await_suspend(ice::coroutine_handle<>) noexcept {
+      return consumer_;
+    }
+
+    constexpr void await_resume() noexcept {
+    }
+
+    ice::coroutine_handle<> consumer_;
+  };
+
+  ice::coroutine_handle<> consumer_;
+};
+
+template <typename T>
+class async_generator_promise final : public async_generator_promise_base {
+public:
+  using value_type = std::remove_reference_t<T>;
+
+  constexpr async_generator_promise() noexcept = default;
+
+  async_generator<T> get_return_object() noexcept;
+
+  auto yield_value(value_type& value) noexcept {
+    value_ = std::addressof(value);
+    return yield_awaitable{ consumer_ };
+  }
+
+  auto yield_value(value_type&& value) noexcept {
+    value_ = std::addressof(value);
+    return yield_awaitable{ consumer_ };
+  }
+
+  value_type& value() const noexcept {
+    return *value_;
+  }
+
+private:
+  value_type* value_ = nullptr;
+};
+
+struct async_generator_sentinel {};
+
+template <typename T>
+class async_generator_iterator {
+public:
+  using promise_type = async_generator_promise<T>;
+  using iterator_category = std::input_iterator_tag;
+  using difference_type = std::ptrdiff_t;
+  using value_type = typename promise_type::value_type;
+  using reference = value_type&;
+  using pointer = value_type*;
+
+  explicit async_generator_iterator(ice::coroutine_handle<promise_type> coroutine) noexcept :
+    coroutine_(coroutine) {
+  }
+
+  // Resumes the producer until it yields the next value or returns.
+  auto operator++() noexcept {
+    struct awaitable {
+      bool await_ready() const noexcept {
+        return !iterator_.coroutine_ || iterator_.coroutine_.done();
+      }
+
+      ice::coroutine_handle<> await_suspend(ice::coroutine_handle<> consumer) noexcept {
+        iterator_.coroutine_.promise().set_consumer(consumer);
+        return iterator_.coroutine_;
+      }
+
+      async_generator_iterator& await_resume() noexcept {
+        return iterator_;
+      }
+
+      async_generator_iterator& iterator_;
+    };
+    return awaitable{ *this };
+  }
+
+  reference operator*() const noexcept {
+    return coroutine_.promise().value();
+  }
+
+  pointer operator->() const noexcept {
+    return std::addressof(operator*());
+  }
+
+  friend bool operator==(const async_generator_iterator& it, async_generator_sentinel) noexcept {
+    return !it.coroutine_ || it.coroutine_.done();
+  }
+
+  friend bool operator!=(const async_generator_iterator& it, async_generator_sentinel s) noexcept {
+    return !(it == s);
+  }
+
+private:
+  ice::coroutine_handle<promise_type> coroutine_;
+};
+
+}  // namespace detail
+
+// Coroutine that produces a sequence of values with co_yield and may co_await between them.
+// The producer does not start until begin() is awaited and runs only while the consumer waits for the next
+// value, so at most one value is in flight and a slow consumer throttles the producer. Yielded values are
+// referenced, not copied, and stay valid until the iterator is advanced. The consumer is resumed on the thread
+// the producer yielded on, e.g. the context thread after the producer awaited an ice::schedule.
+//
+//   for (auto it = co_await generator.begin(); it != generator.end(); co_await ++it) {
+//     process(*it);
+//   }
+template <typename T>
+class async_generator {
+public:
+  using promise_type = detail::async_generator_promise<T>;
+  using iterator = detail::async_generator_iterator<T>;
+
+  constexpr async_generator() noexcept = default;
+
+  explicit async_generator(ice::coroutine_handle<promise_type> coroutine) noexcept : coroutine_(coroutine) {
+  }
+
+  async_generator(async_generator&& other) noexcept : coroutine_(std::exchange(other.coroutine_, nullptr)) {
+  }
+
+  async_generator(const async_generator& other) = delete;
+  async_generator& operator=(const async_generator& other) = delete;
+
+  ~async_generator() {
+    if (coroutine_) {
+      coroutine_.destroy();
+    }
+  }
+
+  async_generator& operator=(async_generator&& other) noexcept {
+    if (std::addressof(other) != this) {
+      if (coroutine_) {
+        coroutine_.destroy();
+      }
+      coroutine_ = std::exchange(other.coroutine_, nullptr);
+    }
+    return *this;
+  }
+
+  // Starts the producer and returns an iterator to the first value once it is yielded.
+  auto begin() noexcept {
+    struct awaitable {
+      bool await_ready() const noexcept {
+        return !coroutine_ || coroutine_.done();
+      }
+
+      ice::coroutine_handle<> await_suspend(ice::coroutine_handle<> consumer) noexcept {
+        coroutine_.promise().set_consumer(consumer);
+        return coroutine_;
+      }
+
+      iterator await_resume() noexcept {
+        return iterator{ coroutine_ };
+      }
+
+      ice::coroutine_handle<promise_type> coroutine_;
+    };
+    return awaitable{ coroutine_ };
+  }
+
+  constexpr detail::async_generator_sentinel end() const noexcept {
+    return {};
+  }
+
+private:
+  ice::coroutine_handle<promise_type> coroutine_{ nullptr };
+};
+
+template <typename T>
+async_generator<T> detail::async_generator_promise<T>::get_return_object() noexcept {
+  return async_generator<T>{ ice::coroutine_handle<async_generator_promise<T>>::from_promise(*this) };
+}
+
+}  // namespace ice
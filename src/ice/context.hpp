@@ -1,116 +1,404 @@
-#pragma once
-#include <atomic>
-#include <condition_variable>
-#include <experimental/coroutine>
-#include <mutex>
-#include <thread>
-
-namespace ice {
-
-class context {
-public:
-  class event {
-  public:
-    event() noexcept = default;
-
-#ifdef __INTELLISENSE__
-    // clang-format off
-    event(const event& other) noexcept {}
-    event& operator=(const event& other) noexcept {}
-    // clang-format on
-#else
-    event(const event& other) = delete;
-    event& operator=(const event& other) = delete;
-#endif
-
-    virtual ~event() = default;
-
-    void resume() noexcept {
-      awaiter_.resume();
-    }
-
-  protected:
-    std::experimental::coroutine_handle<> awaiter_;
-
-  private:
-    friend class context;
-    std::atomic<event*> next_ = nullptr;
-  };
-
-  context() = default;
-
-  context(const context& other) = delete;
-  context& operator=(const context& other) = delete;
-
-  void run() noexcept {
-    thread_.store(std::this_thread::get_id(), std::memory_order_release);
-    std::unique_lock lock{ mutex_ };
-    lock.unlock();
-    while (true) {
-      lock.lock();
-      auto head = head_.exchange(nullptr, std::memory_order_acquire);
-      while (!head) {
-        if (stop_.load(std::memory_order_acquire)) {
-          lock.unlock();
-          return;
-        }
-        cv_.wait(lock, []() { return true; });
-        head = head_.exchange(nullptr, std::memory_order_acquire);
-      }
-      lock.unlock();
-      while (head) {
-        auto next = head->next_.load(std::memory_order_relaxed);
-        head->resume();
-        head = next;
-      }
-    }
-  }
-
-  bool is_current() const noexcept {
-    return thread_.load(std::memory_order_acquire) == std::this_thread::get_id();
-  }
-
-  void stop() noexcept {
-    stop_.store(true, std::memory_order_release);
-    cv_.notify_all();
-  }
-
-  void schedule(event* ev) noexcept {
-    auto head = head_.load(std::memory_order_acquire);
-    do {
-      ev->next_.store(head, std::memory_order_relaxed);
-    } while (!head_.compare_exchange_weak(head, ev, std::memory_order_release, std::memory_order_acquire));
-    cv_.notify_one();
-  }
-
-private:
-  std::atomic_bool stop_ = false;
-  std::atomic<event*> head_ = nullptr;
-  std::atomic<std::thread::id> thread_;
-  std::condition_variable cv_;
-  std::mutex mutex_;
-};
-
-class schedule final : public context::event {
-public:
-  schedule(context& context, bool post = false) noexcept : context_(context), ready_(!post && context.is_current()) {
-  }
-
-  constexpr bool await_ready() const noexcept {
-    return ready_;
-  }
-
-  void await_suspend(std::experimental::coroutine_handle<> awaiter) noexcept {
-    awaiter_ = awaiter;
-    context_.schedule(this);
-  }
-
-  constexpr void await_resume() const noexcept {
-  }
-
-private:
-  context& context_;
-  const bool ready_ = true;
-};
-
-}  // namespace ice
+#pragma once
+#include <ice/coroutine.hpp>
+#include <ice/trace.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ice {
+
+class thread_pool;
+
+// Lanes of a context. High priority events run before bulk events, but bulk events are never starved for more than
+// context::high_burst high priority events in a row.
+enum class priority {
+  high,
+  bulk,
+};
+
+class context {
+public:
+  using clock = std::chrono::steady_clock;
+
+  class event {
+  public:
+    event() noexcept = default;
+
+#ifdef __INTELLISENSE__
+    // clang-format off
+    event(const event& other) noexcept {}
+    event& operator=(const event& other) noexcept {}
+    // clang-format on
+#else
+    event(const event& other) = delete;
+    event& operator=(const event& other) = delete;
+#endif
+
+    virtual ~event() = default;
+
+    void resume() noexcept {
+      awaiter_.resume();
+    }
+
+  protected:
+    ice::coroutine_handle<> awaiter_;
+
+  private:
+    friend class context;
+    friend class thread_pool;
+
+#ifdef ICE_TRACE
+    // Remembers when the event was queued if tracing is enabled.
+    void queued() noexcept {
+      queued_ = trace::enabled() ? trace::now() : 0;
+    }
+
+    // Resumes the event and records how long it waited in the queue and how long the awaiter ran until it
+    // suspended again. The event may be destroyed by resume().
+    static void resume(event* ev, const trace::stage& queue, const trace::stage& run) noexcept {
+      const auto queued = ev->queued_;
+      if (!queued) {
+        ev->resume();
+        return;
+      }
+      const auto start = trace::now();
+      ev->resume();
+      trace::record(queue, queued, start);
+      trace::record(run, start, trace::now());
+    }
+#else
+    void queued() noexcept {
+    }
+
+    static void resume(event* ev, const trace::stage& /*queue*/, const trace::stage& /*run*/) noexcept {
+      ev->resume();
+    }
+#endif
+
+    std::atomic<event*> next_ = nullptr;
+#ifdef ICE_TRACE
+    std::int64_t queued_ = 0;
+#endif
+  };
+
+  class timer : public event {
+  public:
+    explicit timer(clock::time_point deadline) noexcept : deadline_(deadline) {
+    }
+
+    clock::time_point deadline() const noexcept {
+      return deadline_;
+    }
+
+    // Returns true if the timer was resumed because the context stopped before the deadline passed.
+    bool cancelled() const noexcept {
+      return cancelled_;
+    }
+
+  private:
+    friend class context;
+    const clock::time_point deadline_;
+    bool cancelled_ = false;
+  };
+
+  // High priority events that run in a row before a waiting bulk event runs.
+  static constexpr std::size_t high_burst = 16;
+
+  context() = default;
+
+  context(const context& other) = delete;
+  context& operator=(const context& other) = delete;
+
+  void run() noexcept {
+    thread_.store(std::this_thread::get_id(), std::memory_order_release);
+    while (true) {
+      if (!empty()) {
+        drain();
+      }
+      if (timers_.load(std::memory_order_relaxed) || !heap_.empty()) {
+        expire();
+      }
+      if (!empty()) {
+        continue;
+      }
+      if (stop_.load(std::memory_order_acquire)) {
+        if (cancel()) {
+          continue;
+        }
+        return;
+      }
+      park();
+    }
+  }
+
+  bool is_current() const noexcept {
+    return thread_.load(std::memory_order_acquire) == std::this_thread::get_id();
+  }
+
+  void stop() noexcept {
+    stop_.store(true, std::memory_order_seq_cst);
+    std::lock_guard lock{ mutex_ };
+    cv_.notify_all();
+  }
+
+  void schedule(event* ev, ice::priority priority = ice::priority::bulk) noexcept {
+    (priority == ice::priority::high ? high_ : bulk_).push(ev);
+    wake();
+  }
+
+  // Resumes the timer on the runner thread once its deadline has passed.
+  // Timers that are still pending when the context is stopped are cancelled and resumed before run() returns.
+  void schedule(timer* tm) noexcept {
+    if (is_current()) {
+      insert(tm);
+      return;
+    }
+    auto head = timers_.load(std::memory_order_relaxed);
+    do {
+      tm->next_.store(head, std::memory_order_relaxed);
+    } while (!timers_.compare_exchange_weak(head, tm, std::memory_order_seq_cst, std::memory_order_relaxed));
+    wake();
+  }
+
+private:
+  // Events are kept in an intrusive multi-producer single-consumer queue per lane.
+  // Producers exchange the back pointer and then link the previous node, the runner pops from the front.
+  // Producers count the events that they push and the runner those that it pops, which gives the runner the
+  // number of events that were scheduled and not resumed yet.
+  // https://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+  class queue {
+  public:
+    queue() noexcept = default;
+
+    queue(const queue& other) = delete;
+    queue& operator=(const queue& other) = delete;
+
+    void push(event* ev) noexcept {
+      ev->queued();
+      pushed_.fetch_add(1, std::memory_order_relaxed);
+      link(ev);
+    }
+
+    bool empty(std::memory_order order = std::memory_order_acquire) const noexcept {
+      return front_ == &stub_ && back_.load(order) == &stub_;
+    }
+
+    // Returns the number of events that were pushed and not popped yet. Must be called by the runner.
+    std::size_t size() const noexcept {
+      return pushed_.load(std::memory_order_acquire) - popped_;
+    }
+
+    event* pop() noexcept {
+      auto front = front_;
+      auto next = front->next_.load(std::memory_order_acquire);
+      if (front == &stub_) {
+        if (!next) {
+          return nullptr;
+        }
+        front_ = front = next;
+        next = next->next_.load(std::memory_order_acquire);
+      }
+      if (next) {
+        front_ = next;
+        popped_++;
+        return front;
+      }
+      if (front != back_.load(std::memory_order_acquire)) {
+        return nullptr;  // a producer did not link its node yet
+      }
+      link(&stub_);
+      next = front->next_.load(std::memory_order_acquire);
+      if (next) {
+        front_ = next;
+        popped_++;
+        return front;
+      }
+      return nullptr;
+    }
+
+  private:
+    void link(event* ev) noexcept {
+      ev->next_.store(nullptr, std::memory_order_relaxed);
+      const auto back = back_.exchange(ev, std::memory_order_seq_cst);
+      back->next_.store(ev, std::memory_order_release);
+    }
+
+    event stub_;
+    std::atomic<event*> back_ = &stub_;
+    event* front_ = &stub_;
+    std::atomic<std::size_t> pushed_ = 0;  // events pushed by the producers, excluding the stub
+    std::size_t popped_ = 0;               // events popped by the runner
+  };
+
+  bool empty() const noexcept {
+    return high_.empty() && bulk_.empty();
+  }
+
+  void wake() noexcept {
+    if (sleeping_.load(std::memory_order_seq_cst) && sleeping_.exchange(false, std::memory_order_acq_rel)) {
+      std::lock_guard lock{ mutex_ };
+      cv_.notify_one();
+    }
+  }
+
+  // Timers are kept in a binary min-heap that is only accessed by the runner.
+  // Timers from other threads are pushed onto a stack and moved to the heap by the runner.
+
+  static bool later(const timer* lhs, const timer* rhs) noexcept {
+    return lhs->deadline_ > rhs->deadline_;
+  }
+
+  void insert(timer* tm) noexcept {
+    heap_.push_back(tm);
+    std::push_heap(heap_.begin(), heap_.end(), later);
+  }
+
+  // Moves the timers that other threads scheduled to the heap.
+  void collect() noexcept {
+    auto head = timers_.exchange(nullptr, std::memory_order_acquire);
+    while (head) {
+      const auto next = head->next_.load(std::memory_order_relaxed);
+      insert(static_cast<timer*>(head));
+      head = next;
+    }
+  }
+
+  void expire() noexcept {
+    collect();
+    const auto now = clock::now();
+    while (!heap_.empty() && heap_.front()->deadline_ <= now) {
+      const auto tm = heap_.front();
+      std::pop_heap(heap_.begin(), heap_.end(), later);
+      heap_.pop_back();
+      tm->resume();
+    }
+  }
+
+  // Resumes all pending timers in deadline order and flags those whose deadline did not pass yet as cancelled.
+  // Timers and events that the resumed coroutines schedule are handled by the next iteration of run().
+  // Returns false if no timer was pending.
+  bool cancel() noexcept {
+    collect();
+    if (heap_.empty()) {
+      return false;
+    }
+    auto heap = std::move(heap_);
+    heap_.clear();
+    const auto now = clock::now();
+    while (!heap.empty()) {
+      const auto tm = heap.front();
+      std::pop_heap(heap.begin(), heap.end(), later);
+      heap.pop_back();
+      tm->cancelled_ = tm->deadline_ > now;
+      tm->resume();
+    }
+    return true;
+  }
+
+  // Blocks until an event is scheduled, the next timer expires or the context is stopped.
+  // The runner announces that it is about to sleep before it checks the queue for the last time, and producers
+  // check the announcement after they pushed an event. Both sides use sequentially consistent operations, so
+  // either the runner sees the event or the producer sees the runner and takes the mutex to wake it up.
+  // Producers only pay for an atomic load while the runner is busy.
+  void park() noexcept {
+    std::unique_lock lock{ mutex_ };
+    sleeping_.store(true, std::memory_order_seq_cst);
+    if (high_.empty(std::memory_order_seq_cst) && bulk_.empty(std::memory_order_seq_cst) && !timers_.load(std::memory_order_seq_cst) &&
+      !stop_.load(std::memory_order_seq_cst)) {
+      if (heap_.empty()) {
+        cv_.wait(lock);
+      } else {
+        cv_.wait_until(lock, heap_.front()->deadline_);
+      }
+    }
+    sleeping_.store(false, std::memory_order_relaxed);
+  }
+
+  // Resumes bulk events in the order they were scheduled until as many as were queued when this function was
+  // called have run. Bulk events scheduled in the meantime are left for the next batch, so that timers are
+  // checked between batches. Before every bulk event, up to high_burst high priority events run, including those
+  // scheduled while the batch runs.
+  void drain() noexcept {
+    auto batch = bulk_.size();
+    while (true) {
+      for (std::size_t i = 0; i < high_burst; i++) {
+        const auto ev = high_.pop();
+        if (!ev) {
+          break;
+        }
+        event::resume(ev, queue_stage, resume_stage);
+      }
+      if (!batch) {
+        return;
+      }
+      const auto ev = bulk_.pop();
+      if (!ev) {
+        return;
+      }
+      event::resume(ev, queue_stage, resume_stage);
+      if (!--batch) {
+        return;
+      }
+    }
+  }
+
+  static inline const trace::stage queue_stage{ "context.queue" };
+  static inline const trace::stage resume_stage{ "context.resume" };
+
+  std::atomic_bool stop_ = false;
+  std::atomic_bool sleeping_ = false;
+  queue high_;
+  queue bulk_;
+  std::atomic<event*> timers_ = nullptr;
+  std::vector<timer*> heap_;
+  std::atomic<std::thread::id> thread_;
+  std::condition_variable cv_;
+  std::mutex mutex_;
+};
+
+class schedule final : public context::event {
+public:
+  template <typename Scheduler>
+  schedule(Scheduler& scheduler, bool post = false) noexcept :
+    scheduler_(&scheduler), post_(&dispatch<Scheduler>), ready_(!post && scheduler.is_current()) {
+  }
+
+  // Schedules on a lane of the scheduler. Schedulers without lanes ignore the priority.
+  template <typename Scheduler>
+  schedule(Scheduler& scheduler, ice::priority priority, bool post = false) noexcept :
+    scheduler_(&scheduler), post_(&dispatch<Scheduler>), ready_(!post && scheduler.is_current()), priority_(priority) {
+  }
+
+  constexpr bool await_ready() const noexcept {
+    return ready_;
+  }
+
+  void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+    awaiter_ = awaiter;
+    post_(scheduler_, this, priority_);
+  }
+
+  constexpr void await_resume() const noexcept {
+  }
+
+private:
+  template <typename Scheduler>
+  static void dispatch(void* scheduler, context::event* ev, ice::priority priority) noexcept {
+    if constexpr (requires { static_cast<Scheduler*>(scheduler)->schedule(ev, priority); }) {
+      static_cast<Scheduler*>(scheduler)->schedule(ev, priority);
+    } else {
+      static_cast<Scheduler*>(scheduler)->schedule(ev);
+    }
+  }
+
+  void* const scheduler_;
+  void (*const post_)(void* scheduler, context::event* ev, ice::priority priority) noexcept;
+  const bool ready_ = true;
+  const ice::priority priority_ = ice::priority::bulk;
+};
+
+}  // namespace ice
@@ -0,0 +1,24 @@
+#pragma once
+
+// Coroutine support for both the coroutines TS and C++20 coroutines.
+// MSVC with /await and older clang with libc++ only provide std::experimental, GCC and newer compilers in C++20
+// mode only provide std. The library uses these names instead of either namespace.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define ICE_COROUTINE_NAMESPACE std
+#else
+#include <experimental/coroutine>
+#define ICE_COROUTINE_NAMESPACE std::experimental
+#endif
+
+namespace ice {
+
+using ICE_COROUTINE_NAMESPACE::coroutine_handle;
+using ICE_COROUTINE_NAMESPACE::noop_coroutine;
+using ICE_COROUTINE_NAMESPACE::noop_coroutine_handle;
+using ICE_COROUTINE_NAMESPACE::suspend_always;
+using ICE_COROUTINE_NAMESPACE::suspend_never;
+
+}  // namespace ice
+
+#undef ICE_COROUTINE_NAMESPACE
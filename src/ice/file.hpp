@@ -0,0 +1,252 @@
+#pragma once
+#include <ice/async_generator.hpp>
+#include <ice/coroutine.hpp>
+#include <ice/io_service.hpp>
+#include <filesystem>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace ice {
+
+enum class file_mode {
+  read,    // open an existing file for reading
+  write,   // create a new file or truncate an existing one for writing
+  update,  // open or create a file for reading and writing without truncating it
+};
+
+// File that reads and writes at explicit offsets through an ice::io_service.
+// Any number of operations can be in flight at the same time, each one resumes the awaiting coroutine on the
+// context thread of the io_service.
+class file {
+public:
+  using native_handle_type = io_service::native_handle_type;
+
+  class read_operation final : public io_service::operation {
+  public:
+    read_operation(io_service& service, native_handle_type handle, std::uint64_t offset, std::span<std::byte> buffer) noexcept :
+      operation(service), handle_(handle), offset_(offset), buffer_(buffer) {
+    }
+
+    void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+      awaiter_ = awaiter;
+      service_.read(this, handle_, offset_, buffer_.data(), buffer_.size());
+    }
+
+  private:
+    const native_handle_type handle_;
+    const std::uint64_t offset_;
+    const std::span<std::byte> buffer_;
+  };
+
+  class write_operation final : public io_service::operation {
+  public:
+    write_operation(io_service& service, native_handle_type handle, std::uint64_t offset, std::span<const std::byte> buffer,
+      bool defer = false) noexcept :
+      operation(service), handle_(handle), offset_(offset), buffer_(buffer), defer_(defer) {
+    }
+
+    void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+      awaiter_ = awaiter;
+      service_.write(this, handle_, offset_, buffer_.data(), buffer_.size(), defer_);
+    }
+
+  private:
+    const native_handle_type handle_;
+    const std::uint64_t offset_;
+    const std::span<const std::byte> buffer_;
+    const bool defer_;
+  };
+
+  class sync_operation final : public io_service::operation {
+  public:
+    sync_operation(io_service& service, native_handle_type handle) noexcept : operation(service), handle_(handle) {
+    }
+
+    void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+      awaiter_ = awaiter;
+      service_.sync(this, handle_);
+    }
+
+  private:
+    const native_handle_type handle_;
+  };
+
+  file() noexcept = default;
+
+  file(file&& other) noexcept : service_(other.service_), handle_(std::exchange(other.handle_, io_service::invalid_handle)) {
+  }
+
+  file(const file& other) = delete;
+
+  file& operator=(file&& other) noexcept {
+    if (this != &other) {
+      close();
+      service_ = other.service_;
+      handle_ = std::exchange(other.handle_, io_service::invalid_handle);
+    }
+    return *this;
+  }
+
+  file& operator=(const file& other) = delete;
+
+  ~file() {
+    close();
+  }
+
+  static file open(io_service& service, const std::filesystem::path& path, file_mode mode, std::error_code& ec) noexcept {
+    file file;
+#ifdef _WIN32
+    DWORD access = GENERIC_READ;
+    DWORD disposition = OPEN_EXISTING;
+    switch (mode) {
+    case file_mode::read:
+      break;
+    case file_mode::write:
+      access = GENERIC_WRITE;
+      disposition = CREATE_ALWAYS;
+      break;
+    case file_mode::update:
+      access = GENERIC_READ | GENERIC_WRITE;
+      disposition = OPEN_ALWAYS;
+      break;
+    }
+    constexpr DWORD share = FILE_SHARE_READ | FILE_SHARE_DELETE;
+    constexpr DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED;
+    const auto handle = CreateFileW(path.c_str(), access, share, nullptr, disposition, flags, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+      ec = { static_cast<int>(GetLastError()), std::system_category() };
+      return file;
+    }
+#else
+    auto flags = O_RDONLY;
+    switch (mode) {
+    case file_mode::read:
+      break;
+    case file_mode::write:
+      flags = O_WRONLY | O_CREAT | O_TRUNC;
+      break;
+    case file_mode::update:
+      flags = O_RDWR | O_CREAT;
+      break;
+    }
+    const auto handle = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (handle == -1) {
+      ec = { errno, std::system_category() };
+      return file;
+    }
+#endif
+    return attach(service, handle, ec);
+  }
+
+  // Takes ownership of a handle that was opened for asynchronous I/O.
+  static file attach(io_service& service, native_handle_type handle, std::error_code& ec) noexcept {
+    file file;
+    file.service_ = &service;
+    file.handle_ = handle;
+    ec = service.attach(handle);
+    if (ec) {
+      file.close();
+    }
+    return file;
+  }
+
+  bool is_open() const noexcept {
+    return handle_ != io_service::invalid_handle;
+  }
+
+  native_handle_type native_handle() const noexcept {
+    return handle_;
+  }
+
+  std::uint64_t size(std::error_code& ec) const noexcept {
+#ifdef _WIN32
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(handle_, &size)) {
+      ec = { static_cast<int>(GetLastError()), std::system_category() };
+      return 0;
+    }
+    return static_cast<std::uint64_t>(size.QuadPart);
+#else
+    struct stat st = {};
+    if (fstat(handle_, &st)) {
+      ec = { errno, std::system_category() };
+      return 0;
+    }
+    return static_cast<std::uint64_t>(st.st_size);
+#endif
+  }
+
+  // Reserves space for a file of the given size without changing its size. File systems that cannot reserve space
+  // are not an error.
+  void allocate(std::uint64_t size, std::error_code& ec) const noexcept {
+#ifdef _WIN32
+    FILE_ALLOCATION_INFO info = {};
+    info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFileInformationByHandle(handle_, FileAllocationInfo, &info, sizeof(info))) {
+      ec = { static_cast<int>(GetLastError()), std::system_category() };
+    }
+#else
+    if (fallocate(handle_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) && errno != EOPNOTSUPP && errno != ENOSYS) {
+      ec = { errno, std::system_category() };
+    }
+#endif
+  }
+
+  // Reads up to buffer.size() bytes at the given offset. A result size of 0 indicates the end of the file.
+  read_operation read(std::uint64_t offset, std::span<std::byte> buffer) const noexcept {
+    return { *service_, handle_, offset, buffer };
+  }
+
+  // Writes up to buffer.size() bytes at the given offset.
+  write_operation write(std::uint64_t offset, std::span<const std::byte> buffer) const noexcept {
+    return { *service_, handle_, offset, buffer };
+  }
+
+  // Flushes the written data to the device. Any number of files can be flushed at the same time.
+  sync_operation sync() const noexcept {
+    return { *service_, handle_ };
+  }
+
+  // Reads the file sequentially from the given offset in chunks of up to buffer.size() bytes.
+  // Each chunk is a view into the buffer that stays valid until the iterator is advanced. Stops at the end of the
+  // file or on the first error, which is stored in ec.
+  async_generator<std::span<const std::byte>> read_chunks(std::uint64_t offset, std::span<std::byte> buffer, std::error_code& ec) const noexcept {
+    while (true) {
+      const auto result = co_await read(offset, buffer);
+      if (!result) {
+        ec = result.error;
+        co_return;
+      }
+      if (!result.size) {
+        co_return;
+      }
+      co_yield std::span<const std::byte>{ buffer.data(), result.size };
+      offset += result.size;
+    }
+  }
+
+  void close() noexcept {
+    if (handle_ != io_service::invalid_handle) {
+#ifdef _WIN32
+      CloseHandle(handle_);
+#else
+      ::close(handle_);
+#endif
+      handle_ = io_service::invalid_handle;
+    }
+  }
+
+private:
+  io_service* service_ = nullptr;
+  native_handle_type handle_ = io_service::invalid_handle;
+};
+
+}  // namespace ice
@@ -0,0 +1,104 @@
+#pragma once
+#include <new>
+#include <cstddef>
+
+namespace ice {
+
+// Thread-local cache for coroutine frames.
+// Frames are rounded up to 64 byte size classes. Freed frames are kept on a per-thread free list for their
+// class and handed out again by the next allocation of the same class on that thread. A frame that is freed on
+// a different thread than it was allocated on moves to the cache of that thread. Frames larger than the biggest
+// class and frames that do not fit into a full cache go to the global heap.
+class frame_pool {
+public:
+  static constexpr std::size_t granularity = 64;
+  static constexpr std::size_t classes = 64;
+  static constexpr std::size_t class_limit = 16 * 1024;
+
+  static void* allocate(std::size_t size) {
+    if (const auto index = class_index(size); index < classes) {
+      if (const auto cache = get()) {
+        if (auto& list = cache->lists[index]; list.head) {
+          const auto block = list.head;
+          list.head = block->next;
+          list.size--;
+          return block;
+        }
+      }
+      return ::operator new(class_size(index));
+    }
+    return ::operator new(size);
+  }
+
+  static void deallocate(void* ptr, std::size_t size) noexcept {
+    if (const auto index = class_index(size); index < classes) {
+      if (const auto cache = get()) {
+        if (auto& list = cache->lists[index]; list.size * class_size(index) < class_limit) {
+          const auto block = static_cast<node*>(ptr);
+          block->next = list.head;
+          list.head = block;
+          list.size++;
+          return;
+        }
+      }
+    }
+    ::operator delete(ptr);
+  }
+
+private:
+  struct node {
+    node* next;
+  };
+
+  struct list {
+    node* head = nullptr;
+    std::size_t size = 0;
+  };
+
+  struct cache {
+    list lists[classes];
+
+    ~cache() {
+      for (auto& list : lists) {
+        while (list.head) {
+          const auto next = list.head->next;
+          ::operator delete(list.head);
+          list.head = next;
+        }
+      }
+    }
+  };
+
+  // Deletes the thread cache on thread exit. Frames that are freed after that go directly to the global heap.
+  struct owner {
+    ~owner() {
+      delete instance();
+      instance() = nullptr;
+    }
+  };
+
+  static constexpr std::size_t class_index(std::size_t size) noexcept {
+    return (size - 1) / granularity;
+  }
+
+  static constexpr std::size_t class_size(std::size_t index) noexcept {
+    return (index + 1) * granularity;
+  }
+
+  static cache*& instance() noexcept {
+    thread_local cache* instance = nullptr;
+    return instance;
+  }
+
+  static cache* get() {
+    thread_local bool initialized = false;
+    if (!initialized) {
+      thread_local owner guard;
+      instance() = new cache();
+      initialized = true;
+    }
+    return instance();
+  }
+};
+
+}  // namespace ice
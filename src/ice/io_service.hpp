@@ -0,0 +1,459 @@
+#pragma once
+#include <ice/context.hpp>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace ice {
+
+struct io_result {
+  std::size_t size = 0;
+  std::error_code error;
+
+  explicit operator bool() const noexcept {
+    return !error;
+  }
+};
+
+// Submits asynchronous I/O operations and resumes the awaiting coroutines through an ice::context.
+// Linux uses io_uring and falls back to blocking calls when io_uring is not available, Windows uses an I/O
+// completion port. Completions are reaped by a single service thread, not a thread per file or operation.
+// On Linux, starting an operation blocks while the submission queue is full or as many operations are in flight
+// as the completion queue holds, so that the completion queue never overflows.
+class io_service {
+public:
+#ifdef _WIN32
+  using native_handle_type = HANDLE;
+  static inline const native_handle_type invalid_handle = INVALID_HANDLE_VALUE;
+#else
+  using native_handle_type = int;
+  static constexpr native_handle_type invalid_handle = -1;
+#endif
+
+  class operation : public context::event {
+  public:
+    explicit operation(io_service& service) noexcept : service_(service) {
+#ifdef _WIN32
+      overlapped_.op = this;
+#endif
+    }
+
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    io_result await_resume() const noexcept {
+      return result_;
+    }
+
+  protected:
+    io_service& service_;
+
+  private:
+    friend class io_service;
+#ifdef _WIN32
+    struct overlapped : OVERLAPPED {
+      operation* op = nullptr;
+    };
+    overlapped overlapped_ = {};
+#endif
+    io_result result_;
+  };
+
+  explicit io_service(context& context, unsigned entries = 256) noexcept : context_(context) {
+#ifdef _WIN32
+    port_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+    thread_ = std::thread([this]() { reap(); });
+#else
+    if (setup(entries)) {
+      thread_ = std::thread([this]() { reap(); });
+    }
+#endif
+  }
+
+  io_service(const io_service& other) = delete;
+  io_service& operator=(const io_service& other) = delete;
+
+  ~io_service() {
+#ifdef _WIN32
+    PostQueuedCompletionStatus(port_, 0, 0, nullptr);
+    thread_.join();
+    CloseHandle(port_);
+#else
+    if (fd_ != -1) {
+      std::unique_lock lock{ mutex_ };
+      if (const auto sqe = acquire(lock)) {
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+        submit(lock);
+      }
+      lock.unlock();
+      thread_.join();
+      munmap(sqes_, sqes_size_);
+      if (cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+      }
+      munmap(sq_ring_, sq_ring_size_);
+      close(fd_);
+    }
+#endif
+  }
+
+#ifdef _WIN32
+  // Associates a handle that was opened with FILE_FLAG_OVERLAPPED with the completion port.
+  std::error_code attach(native_handle_type handle) noexcept {
+    if (!CreateIoCompletionPort(handle, port_, 0, 0)) {
+      return { static_cast<int>(GetLastError()), std::system_category() };
+    }
+    return {};
+  }
+
+  void read(operation* op, native_handle_type handle, std::uint64_t offset, void* data, std::size_t size) noexcept {
+    prepare(op, offset);
+    const auto bytes = static_cast<DWORD>(std::min<std::size_t>(size, MAXDWORD));
+    if (!ReadFile(handle, data, bytes, nullptr, &op->overlapped_)) {
+      fail(op, GetLastError());
+    }
+  }
+
+  void write(operation* op, native_handle_type handle, std::uint64_t offset, const void* data, std::size_t size, bool = false) noexcept {
+    prepare(op, offset);
+    const auto bytes = static_cast<DWORD>(std::min<std::size_t>(size, MAXDWORD));
+    if (!WriteFile(handle, data, bytes, nullptr, &op->overlapped_)) {
+      fail(op, GetLastError());
+    }
+  }
+
+  // Flushes the file data to the device. FlushFileBuffers has no overlapped form, so this completes before it
+  // returns and only the resumption goes through the context.
+  void sync(operation* op, native_handle_type handle) noexcept {
+    op->result_ = {};
+    if (!FlushFileBuffers(handle)) {
+      op->result_.error = { static_cast<int>(GetLastError()), std::system_category() };
+    }
+    context_.schedule(op);
+  }
+
+  // Operations are started right away on Windows.
+  void submit() noexcept {
+  }
+#else
+  std::error_code attach(native_handle_type) noexcept {
+    return {};
+  }
+
+  void read(operation* op, native_handle_type handle, std::uint64_t offset, void* data, std::size_t size) noexcept {
+    if (fd_ == -1) {
+      complete(op, pread(handle, data, size, static_cast<off_t>(offset)));
+      return;
+    }
+    std::unique_lock lock{ mutex_ };
+    const auto sqe = acquire(lock);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = handle;
+    sqe->off = offset;
+    sqe->addr = reinterpret_cast<std::uintptr_t>(data);
+    sqe->len = static_cast<std::uint32_t>(std::min<std::size_t>(size, UINT32_MAX));
+    sqe->user_data = reinterpret_cast<std::uintptr_t>(op);
+    submit(lock);
+  }
+
+  // Starts a write. A deferred write is only queued and started together with the next operation that is not
+  // deferred or by submit(), which saves a system call per write when many small writes are started at once.
+  void write(operation* op, native_handle_type handle, std::uint64_t offset, const void* data, std::size_t size, bool defer = false) noexcept {
+    if (fd_ == -1) {
+      complete(op, pwrite(handle, data, size, static_cast<off_t>(offset)));
+      return;
+    }
+    std::unique_lock lock{ mutex_ };
+    const auto sqe = acquire(lock);
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = handle;
+    sqe->off = offset;
+    sqe->addr = reinterpret_cast<std::uintptr_t>(data);
+    sqe->len = static_cast<std::uint32_t>(std::min<std::size_t>(size, UINT32_MAX));
+    sqe->user_data = reinterpret_cast<std::uintptr_t>(op);
+    if (defer) {
+      publish();
+    } else {
+      submit(lock);
+    }
+  }
+
+  // Starts all deferred operations.
+  void submit() noexcept {
+    if (fd_ != -1) {
+      std::unique_lock lock{ mutex_ };
+      flush(lock);
+    }
+  }
+
+  // Flushes the file data and the metadata that is needed to read it to the device.
+  void sync(operation* op, native_handle_type handle) noexcept {
+    if (fd_ == -1) {
+      complete(op, fdatasync(handle));
+      return;
+    }
+    std::unique_lock lock{ mutex_ };
+    const auto sqe = acquire(lock);
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = handle;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = reinterpret_cast<std::uintptr_t>(op);
+    submit(lock);
+  }
+#endif
+
+private:
+#ifdef _WIN32
+  void prepare(operation* op, std::uint64_t offset) noexcept {
+    static_cast<OVERLAPPED&>(op->overlapped_) = {};
+    op->overlapped_.Offset = static_cast<DWORD>(offset);
+    op->overlapped_.OffsetHigh = static_cast<DWORD>(offset >> 32);
+  }
+
+  void fail(operation* op, DWORD error) noexcept {
+    if (error == ERROR_IO_PENDING) {
+      return;
+    }
+    op->result_ = {};
+    if (error != ERROR_HANDLE_EOF) {
+      op->result_.error = { static_cast<int>(error), std::system_category() };
+    }
+    context_.schedule(op);
+  }
+
+  void reap() noexcept {
+    while (true) {
+      DWORD bytes = 0;
+      ULONG_PTR key = 0;
+      LPOVERLAPPED overlapped = nullptr;
+      const auto ok = GetQueuedCompletionStatus(port_, &bytes, &key, &overlapped, INFINITE);
+      if (!overlapped) {
+        break;
+      }
+      const auto op = static_cast<operation::overlapped*>(overlapped)->op;
+      op->result_ = { bytes, {} };
+      if (!ok) {
+        if (const auto error = GetLastError(); error != ERROR_HANDLE_EOF) {
+          op->result_.error = { static_cast<int>(error), std::system_category() };
+        }
+      }
+      context_.schedule(op);
+    }
+  }
+
+  HANDLE port_ = nullptr;
+#else
+  static int enter(int fd, unsigned submit, unsigned complete, unsigned flags) noexcept {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, complete, flags, nullptr, 0));
+  }
+
+  static unsigned load(unsigned* value) noexcept {
+    return std::atomic_ref<unsigned>(*value).load(std::memory_order_acquire);
+  }
+
+  static void store(unsigned* value, unsigned data) noexcept {
+    std::atomic_ref<unsigned>(*value).store(data, std::memory_order_release);
+  }
+
+  bool setup(unsigned entries) noexcept {
+    io_uring_params params = {};
+    const auto fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+      return false;
+    }
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    constexpr auto protection = PROT_READ | PROT_WRITE;
+    constexpr auto flags = MAP_SHARED | MAP_POPULATE;
+    sq_ring_ = mmap(nullptr, sq_ring_size_, protection, flags, fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    cq_ring_ = sq_ring_;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+      cq_ring_ = mmap(nullptr, cq_ring_size_, protection, flags, fd, IORING_OFF_CQ_RING);
+      if (cq_ring_ == MAP_FAILED) {
+        munmap(sq_ring_, sq_ring_size_);
+        close(fd);
+        return false;
+      }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    const auto sqes = mmap(nullptr, sqes_size_, protection, flags, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      if (cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+      }
+      munmap(sq_ring_, sq_ring_size_);
+      close(fd);
+      return false;
+    }
+    const auto sq = static_cast<char*>(sq_ring_);
+    const auto cq = static_cast<char*>(cq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    cq_entries_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_entries);
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+    fd_ = fd;
+    return true;
+  }
+
+  // Returns a cleared submission queue entry. Must be called with the mutex locked.
+  // Every entry produces exactly one completion, so limiting the entries in flight to the size of the completion
+  // queue keeps the kernel from overflowing it, which older kernels handle by dropping completions.
+  io_uring_sqe* acquire(std::unique_lock<std::mutex>& lock) noexcept {
+    while (true) {
+      const auto in_flight = in_flight_.load(std::memory_order_acquire);
+      const auto sq_full = *sq_tail_ - load(sq_head_) >= sq_entries_;
+      if (!sq_full && in_flight < cq_entries_) {
+        break;
+      }
+      if (unsubmitted_) {
+        flush(lock);
+        continue;
+      }
+      lock.unlock();
+      if (sq_full) {
+        std::this_thread::yield();
+      } else {
+        in_flight_.wait(in_flight, std::memory_order_acquire);
+      }
+      lock.lock();
+    }
+    const auto tail = *sq_tail_;
+    const auto sqe = &sqes_[tail & sq_mask_];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    return sqe;
+  }
+
+  // Publishes the entry returned by acquire() without submitting it. Must be called with the mutex locked.
+  void publish() noexcept {
+    const auto tail = *sq_tail_;
+    sq_array_[tail & sq_mask_] = tail & sq_mask_;
+    store(sq_tail_, tail + 1);
+    unsubmitted_++;
+    in_flight_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Submits all published entries to the kernel. Must be called with the mutex locked.
+  void flush(std::unique_lock<std::mutex>& lock) noexcept {
+    while (unsubmitted_) {
+      const auto result = enter(fd_, unsubmitted_, 0, 0);
+      if (result > 0) {
+        unsubmitted_ -= std::min(static_cast<unsigned>(result), unsubmitted_);
+      } else if (result < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY)) {
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+      } else {
+        break;
+      }
+    }
+  }
+
+  // Publishes the entry returned by acquire() and submits it to the kernel together with deferred entries.
+  void submit(std::unique_lock<std::mutex>& lock) noexcept {
+    publish();
+    flush(lock);
+  }
+
+  void complete(operation* op, ssize_t result) noexcept {
+    op->result_ = {};
+    if (result < 0) {
+      op->result_.error = { errno, std::system_category() };
+    } else {
+      op->result_.size = static_cast<std::size_t>(result);
+    }
+    context_.schedule(op);
+  }
+
+  // Resumes the operations that completed. The destructor submits an entry without an operation, after which
+  // the reaper keeps going until every operation that was submitted before it has completed.
+  void reap() noexcept {
+    auto stopping = false;
+    while (true) {
+      auto head = *cq_head_;
+      const auto tail = load(cq_tail_);
+      if (head == tail) {
+        if (stopping && !in_flight_.load(std::memory_order_acquire)) {
+          return;
+        }
+        enter(fd_, 0, 1, IORING_ENTER_GETEVENTS);
+        continue;
+      }
+      for (; head != tail; head++) {
+        const auto& cqe = cqes_[head & cq_mask_];
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        if (!cqe.user_data) {
+          stopping = true;
+          continue;
+        }
+        const auto op = reinterpret_cast<operation*>(static_cast<std::uintptr_t>(cqe.user_data));
+        op->result_ = {};
+        if (cqe.res < 0) {
+          op->result_.error = { -cqe.res, std::system_category() };
+        } else {
+          op->result_.size = static_cast<std::size_t>(cqe.res);
+        }
+        context_.schedule(op);
+      }
+      store(cq_head_, head);
+      in_flight_.notify_all();
+    }
+  }
+
+  int fd_ = -1;
+  void* sq_ring_ = nullptr;
+  void* cq_ring_ = nullptr;
+  std::size_t sq_ring_size_ = 0;
+  std::size_t cq_ring_size_ = 0;
+  std::size_t sqes_size_ = 0;
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned sq_entries_ = 0;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  unsigned cq_entries_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  io_uring_sqe* sqes_ = nullptr;
+  unsigned unsubmitted_ = 0;
+  std::atomic<std::size_t> in_flight_ = 0;  // published entries that have not been reaped
+  std::mutex mutex_;
+#endif
+
+  ice::context& context_;
+  std::thread thread_;
+};
+
+}  // namespace ice
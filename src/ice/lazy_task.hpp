@@ -0,0 +1,241 @@
+#pragma once
+#include <ice/coroutine.hpp>
+#include <ice/frame_pool.hpp>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <cassert>
+
+namespace ice {
+
+template <typename T>
+class lazy_task;
+
+namespace detail {
+
+class lazy_task_promise_base {
+public:
+  constexpr lazy_task_promise_base() noexcept = default;
+
+  static void* operator new(std::size_t size) {
+    return frame_pool::allocate(size);
+  }
+
+  static void operator delete(void* ptr, std::size_t size) noexcept {
+    frame_pool::deallocate(ptr, size);
+  }
+
+  constexpr auto initial_suspend() noexcept {
+    return ice::suspend_always{};
+  }
+
+  auto final_suspend() noexcept {
+    struct awaitable {
+      constexpr awaitable(ice::coroutine_handle<> continuation) noexcept : continuation_(continuation) {
+      }
+
+      constexpr bool await_ready() const noexcept {
+        return false;
+      }
+
+      ice::coroutine_handle<> await_suspend(ice::coroutine_handle<>) noexcept {
+        return continuation_;
+      }
+
+      constexpr void await_resume() noexcept {
+      }
+
+      ice::coroutine_handle<> continuation_;
+    };
+    return awaitable{ continuation_ };
+  }
+
+#ifndef _MSC_VER
+  void unhandled_exception() noexcept {
+    assert(false);
+  }
+#endif
+
+  void set_continuation(ice::coroutine_handle<> continuation) noexcept {
+    continuation_ = continuation;
+  }
+
+private:
+  ice::coroutine_handle<> continuation_;
+};
+
+template <typename T>
+class lazy_task_promise : public lazy_task_promise_base {
+public:
+  constexpr lazy_task_promise() noexcept = default;
+
+  ~lazy_task_promise() {
+    if (ready_) {
+      reinterpret_cast<T*>(&value_)->~T();
+    }
+  }
+
+  lazy_task<T> get_return_object() noexcept;
+
+  template <typename... Args>
+  void return_value(Args&&... args) noexcept {
+    new (&value_) T(std::forward<Args>(args)...);
+    ready_ = true;
+  }
+
+  constexpr T& result() & noexcept {
+    return *reinterpret_cast<T*>(&value_);
+  }
+
+  constexpr T&& result() && noexcept {
+    return std::move(*reinterpret_cast<T*>(&value_));
+  }
+
+private:
+  alignas(T) char value_[sizeof(T)];
+  bool ready_ = false;
+};
+
+template <>
+class lazy_task_promise<void> : public lazy_task_promise_base {
+public:
+  constexpr lazy_task_promise() noexcept = default;
+
+  lazy_task<void> get_return_object() noexcept;
+
+  constexpr void return_void() noexcept {
+  }
+
+  constexpr void result() noexcept {
+  }
+};
+
+template <typename T>
+class lazy_task_promise<T&> : public lazy_task_promise_base {
+public:
+  constexpr lazy_task_promise() noexcept = default;
+
+  lazy_task<T&> get_return_object() noexcept;
+
+  void return_value(T& value) noexcept {
+    value_ = std::addressof(value);
+  }
+
+  constexpr T& result() noexcept {
+    return *value_;
+  }
+
+private:
+  T* value_ = nullptr;
+};
+
+}  // namespace detail
+
+// Task that does not start until it is awaited.
+// Only one coroutine can await the task. It starts the task with symmetric transfer and is resumed the same way
+// when the task completes, so awaiting needs no atomic operations and does not grow the stack.
+template <typename T = void>
+class lazy_task {
+public:
+  using promise_type = detail::lazy_task_promise<T>;
+  using value_type = T;
+
+private:
+  struct awaitable_base {
+    awaitable_base(ice::coroutine_handle<promise_type> coroutine) noexcept : coroutine_(coroutine) {
+    }
+
+    bool await_ready() const noexcept {
+      return !coroutine_ || coroutine_.done();
+    }
+
+    ice::coroutine_handle<> await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+      coroutine_.promise().set_continuation(awaiter);
+      return coroutine_;
+    }
+
+    ice::coroutine_handle<promise_type> coroutine_;
+  };
+
+public:
+  constexpr lazy_task() noexcept = default;
+
+  explicit constexpr lazy_task(ice::coroutine_handle<promise_type> coroutine) : coroutine_(coroutine) {
+  }
+
+  constexpr lazy_task(lazy_task&& other) noexcept : coroutine_(std::exchange(other.coroutine_, nullptr)) {
+  }
+
+  lazy_task(const lazy_task&) = delete;
+  lazy_task& operator=(const lazy_task&) = delete;
+
+  ~lazy_task() {
+    if (coroutine_) {
+      coroutine_.destroy();
+    }
+  }
+
+  lazy_task& operator=(lazy_task&& other) noexcept {
+    if (std::addressof(other) != this) {
+      if (coroutine_) {
+        coroutine_.destroy();
+      }
+      coroutine_ = std::exchange(other.coroutine_, nullptr);
+    }
+    return *this;
+  }
+
+  bool is_ready() const noexcept {
+    return !coroutine_ || coroutine_.done();
+  }
+
+  auto operator co_await() const& noexcept {
+    struct awaitable : awaitable_base {
+      using awaitable_base::awaitable_base;
+      decltype(auto) await_resume() noexcept {
+        assert(this->coroutine_);
+        return this->coroutine_.promise().result();
+      }
+    };
+    return awaitable{ coroutine_ };
+  }
+
+  auto operator co_await() const&& noexcept {
+    struct awaitable : awaitable_base {
+      using awaitable_base::awaitable_base;
+      decltype(auto) await_resume() noexcept {
+        assert(this->coroutine_);
+        return std::move(this->coroutine_.promise()).result();
+      }
+    };
+    return awaitable{ coroutine_ };
+  }
+
+  auto when_ready() const noexcept {
+    struct awaitable : awaitable_base {
+      using awaitable_base::awaitable_base;
+      constexpr void await_resume() const noexcept {
+      }
+    };
+    return awaitable{ coroutine_ };
+  }
+
+private:
+  ice::coroutine_handle<promise_type> coroutine_{ nullptr };
+};
+
+template <typename T>
+lazy_task<T> detail::lazy_task_promise<T>::get_return_object() noexcept {
+  return lazy_task<T>{ ice::coroutine_handle<lazy_task_promise<T>>::from_promise(*this) };
+}
+
+template <typename T>
+lazy_task<T&> detail::lazy_task_promise<T&>::get_return_object() noexcept {
+  return lazy_task<T&>{ ice::coroutine_handle<lazy_task_promise<T&>>::from_promise(*this) };
+}
+
+inline lazy_task<void> detail::lazy_task_promise<void>::get_return_object() noexcept {
+  return lazy_task<void>{ ice::coroutine_handle<lazy_task_promise<void>>::from_promise(*this) };
+}
+
+}  // namespace ice
@@ -0,0 +1,197 @@
+#pragma once
+#include <ice/coroutine.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <cassert>
+
+namespace ice {
+namespace detail {
+
+class sync_wait_event {
+public:
+  void set() noexcept {
+    // The waiter owns this object and can only return once the mutex is released.
+    std::lock_guard lock{ mutex_ };
+    set_ = true;
+    cv_.notify_one();
+  }
+
+  void wait() noexcept {
+    std::unique_lock lock{ mutex_ };
+    cv_.wait(lock, [this]() { return set_; });
+  }
+
+private:
+  bool set_ = false;
+  std::condition_variable cv_;
+  std::mutex mutex_;
+};
+
+template <typename T>
+class sync_wait_task;
+
+class sync_wait_promise_base {
+public:
+  constexpr auto initial_suspend() noexcept {
+    return ice::suspend_always{};
+  }
+
+  auto final_suspend() noexcept {
+    struct awaitable {
+      constexpr awaitable(sync_wait_event* event) noexcept : event_(event) {
+      }
+
+      constexpr bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(ice::coroutine_handle<>) noexcept {
+        event_->set();
+      }
+
+      constexpr void await_resume() noexcept {
+      }
+
+      sync_wait_event* event_;
+    };
+    return awaitable{ event_ };
+  }
+
+#ifndef _MSC_VER
+  void unhandled_exception() noexcept {
+    assert(false);
+  }
+#endif
+
+  void start(sync_wait_event& event) noexcept {
+    event_ = &event;
+  }
+
+private:
+  sync_wait_event* event_ = nullptr;
+};
+
+template <typename T>
+class sync_wait_promise : public sync_wait_promise_base {
+public:
+  sync_wait_task<T> get_return_object() noexcept;
+
+  void return_value(T value) noexcept {
+    value_.emplace(std::move(value));
+  }
+
+  T result() noexcept {
+    return std::move(*value_);
+  }
+
+private:
+  std::optional<T> value_;
+};
+
+template <typename T>
+class sync_wait_promise<T&> : public sync_wait_promise_base {
+public:
+  sync_wait_task<T&> get_return_object() noexcept;
+
+  void return_value(T& value) noexcept {
+    value_ = std::addressof(value);
+  }
+
+  T& result() noexcept {
+    return *value_;
+  }
+
+private:
+  T* value_ = nullptr;
+};
+
+template <>
+class sync_wait_promise<void> : public sync_wait_promise_base {
+public:
+  sync_wait_task<void> get_return_object() noexcept;
+
+  constexpr void return_void() noexcept {
+  }
+
+  constexpr void result() noexcept {
+  }
+};
+
+template <typename T>
+class sync_wait_task {
+public:
+  using promise_type = sync_wait_promise<T>;
+
+  explicit sync_wait_task(ice::coroutine_handle<promise_type> coroutine) noexcept : coroutine_(coroutine) {
+  }
+
+  sync_wait_task(const sync_wait_task& other) = delete;
+  sync_wait_task& operator=(const sync_wait_task& other) = delete;
+
+  ~sync_wait_task() {
+    coroutine_.destroy();
+  }
+
+  decltype(auto) run() noexcept {
+    sync_wait_event event;
+    coroutine_.promise().start(event);
+    coroutine_.resume();
+    event.wait();
+    return coroutine_.promise().result();
+  }
+
+private:
+  ice::coroutine_handle<promise_type> coroutine_;
+};
+
+template <typename T>
+sync_wait_task<T> sync_wait_promise<T>::get_return_object() noexcept {
+  return sync_wait_task<T>{ ice::coroutine_handle<sync_wait_promise<T>>::from_promise(*this) };
+}
+
+template <typename T>
+sync_wait_task<T&> sync_wait_promise<T&>::get_return_object() noexcept {
+  return sync_wait_task<T&>{ ice::coroutine_handle<sync_wait_promise<T&>>::from_promise(*this) };
+}
+
+inline sync_wait_task<void> sync_wait_promise<void>::get_return_object() noexcept {
+  return sync_wait_task<void>{ ice::coroutine_handle<sync_wait_promise<void>>::from_promise(*this) };
+}
+
+template <typename Awaitable>
+decltype(auto) get_awaiter(Awaitable&& awaitable) noexcept {
+  if constexpr (requires { std::forward<Awaitable>(awaitable).operator co_await(); }) {
+    return std::forward<Awaitable>(awaitable).operator co_await();
+  } else {
+    return std::forward<Awaitable>(awaitable);
+  }
+}
+
+template <typename Awaitable>
+using await_result_t = decltype(get_awaiter(std::declval<Awaitable>()).await_resume());
+
+template <typename T, typename Awaitable>
+sync_wait_task<T> make_sync_wait_task(Awaitable&& awaitable) {
+  if constexpr (std::is_void_v<T>) {
+    co_await std::forward<Awaitable>(awaitable);
+  } else {
+    co_return co_await std::forward<Awaitable>(awaitable);
+  }
+}
+
+}  // namespace detail
+
+// Blocks the calling thread until the awaitable completes and returns its result.
+// The awaitable is started on the calling thread and may complete on any other thread. Must not be called on
+// the thread that has to complete the awaitable, e.g. the runner of a context it schedules on.
+template <typename Awaitable>
+decltype(auto) sync_wait(Awaitable&& awaitable) noexcept {
+  using result_type = detail::await_result_t<Awaitable&&>;
+  using value_type = std::conditional_t<std::is_lvalue_reference_v<result_type>, result_type, std::remove_cvref_t<result_type>>;
+  return detail::make_sync_wait_task<value_type>(std::forward<Awaitable>(awaitable)).run();
+}
+
+}  // namespace ice
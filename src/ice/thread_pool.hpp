@@ -0,0 +1,259 @@
+#pragma once
+#include <ice/context.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ice {
+namespace detail {
+
+// Chase-Lev work-stealing deque.
+// The owner pushes and pops at the bottom, other threads steal from the top.
+// https://www.di.ens.fr/~zappa/readings/ppopp13.pdf
+class work_deque {
+public:
+  using value_type = context::event*;
+
+  work_deque() : array_(new array(256)) {
+  }
+
+  work_deque(const work_deque& other) = delete;
+  work_deque& operator=(const work_deque& other) = delete;
+
+  ~work_deque() {
+    delete array_.load(std::memory_order_relaxed);
+  }
+
+  void push(value_type value) noexcept {
+    const auto b = bottom_.load(std::memory_order_relaxed);
+    const auto t = top_.load(std::memory_order_acquire);
+    auto a = array_.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1) {
+      a = grow(a, b, t);
+    }
+    a->put(b, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  value_type pop() noexcept {
+    const auto b = bottom_.load(std::memory_order_relaxed) - 1;
+    const auto a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    auto value = a->get(b);
+    if (t == b) {
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        value = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return value;
+  }
+
+  value_type steal() noexcept {
+    auto t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const auto b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return nullptr;
+    }
+    const auto value = array_.load(std::memory_order_acquire)->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return value;
+  }
+
+private:
+  struct array {
+    explicit array(std::int64_t capacity) : capacity(capacity), mask(capacity - 1), data(new std::atomic<value_type>[capacity]) {
+    }
+
+    value_type get(std::int64_t index) const noexcept {
+      return data[index & mask].load(std::memory_order_relaxed);
+    }
+
+    void put(std::int64_t index, value_type value) noexcept {
+      data[index & mask].store(value, std::memory_order_relaxed);
+    }
+
+    const std::int64_t capacity;
+    const std::int64_t mask;
+    std::unique_ptr<std::atomic<value_type>[]> data;
+  };
+
+  array* grow(array* a, std::int64_t b, std::int64_t t) {
+    auto next = new array(a->capacity * 2);
+    for (auto i = t; i < b; i++) {
+      next->put(i, a->get(i));
+    }
+    // Thieves may still read from the old array, so it is kept alive until the deque is destroyed.
+    garbage_.emplace_back(a);
+    array_.store(next, std::memory_order_release);
+    return next;
+  }
+
+  alignas(64) std::atomic<std::int64_t> top_ = 0;
+  alignas(64) std::atomic<std::int64_t> bottom_ = 0;
+  alignas(64) std::atomic<array*> array_;
+  std::vector<std::unique_ptr<array>> garbage_;
+};
+
+}  // namespace detail
+
+// Work-stealing thread pool.
+// Events scheduled from a worker thread are pushed to that worker's local deque, events scheduled from any
+// other thread are pushed to a shared injection stack. Idle workers drain the injection stack and steal from
+// each other before they go to sleep.
+class thread_pool {
+public:
+  explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency()) :
+    size_(std::max<std::size_t>(threads, 1)), workers_(new worker[size_]) {
+    threads_.reserve(size_);
+    for (std::size_t i = 0; i < size_; i++) {
+      threads_.emplace_back([this, i]() { run(i); });
+    }
+  }
+
+  thread_pool(const thread_pool& other) = delete;
+  thread_pool& operator=(const thread_pool& other) = delete;
+
+  ~thread_pool() {
+    stop();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  std::size_t size() const noexcept {
+    return size_;
+  }
+
+  bool is_current() const noexcept {
+    return current().pool == this;
+  }
+
+  void stop() noexcept {
+    stop_.store(true, std::memory_order_release);
+    std::lock_guard lock{ mutex_ };
+    cv_.notify_all();
+  }
+
+  void schedule(context::event* ev) noexcept {
+    ev->queued();
+    if (const auto& current = thread_pool::current(); current.pool == this) {
+      workers_[current.index].deque.push(ev);
+    } else {
+      auto head = head_.load(std::memory_order_acquire);
+      do {
+        ev->next_.store(head, std::memory_order_relaxed);
+      } while (!head_.compare_exchange_weak(head, ev, std::memory_order_release, std::memory_order_acquire));
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+      std::lock_guard lock{ mutex_ };
+      cv_.notify_one();
+    }
+  }
+
+private:
+  struct alignas(64) worker {
+    detail::work_deque deque;
+  };
+
+  struct state {
+    thread_pool* pool = nullptr;
+    std::size_t index = 0;
+  };
+
+  static state& current() noexcept {
+    thread_local state state;
+    return state;
+  }
+
+  void run(std::size_t index) noexcept {
+    current() = { this, index };
+    auto& deque = workers_[index].deque;
+    auto seed = static_cast<std::uint32_t>(index * 2654435761u + 1);
+    while (true) {
+      if (const auto ev = find(deque, index, seed)) {
+        context::event::resume(ev, queue_stage, resume_stage);
+        continue;
+      }
+      std::unique_lock lock{ mutex_ };
+      sleeping_.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (const auto ev = find(deque, index, seed)) {
+        sleeping_.fetch_sub(1, std::memory_order_relaxed);
+        lock.unlock();
+        context::event::resume(ev, queue_stage, resume_stage);
+        continue;
+      }
+      if (stop_.load(std::memory_order_acquire)) {
+        sleeping_.fetch_sub(1, std::memory_order_relaxed);
+        break;
+      }
+      cv_.wait(lock);
+      sleeping_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    current() = {};
+  }
+
+  context::event* find(detail::work_deque& deque, std::size_t index, std::uint32_t& seed) noexcept {
+    if (const auto ev = deque.pop()) {
+      return ev;
+    }
+
+    // Move the whole injection stack to the local deque so that other workers can steal from it.
+    // The stack is walked newest first, which leaves the oldest event at the bottom where it is popped next.
+    if (head_.load(std::memory_order_relaxed)) {
+      auto head = head_.exchange(nullptr, std::memory_order_acquire);
+      while (head) {
+        const auto next = head->next_.load(std::memory_order_relaxed);
+        deque.push(head);
+        head = next;
+      }
+      if (const auto ev = deque.pop()) {
+        return ev;
+      }
+    }
+
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    for (std::size_t i = 0, offset = seed % size_; i < size_; i++) {
+      if (const auto victim = (offset + i) % size_; victim != index) {
+        if (const auto ev = workers_[victim].deque.steal()) {
+          return ev;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  static inline const trace::stage queue_stage{ "pool.queue" };
+  static inline const trace::stage resume_stage{ "pool.resume" };
+
+  const std::size_t size_;
+  std::unique_ptr<worker[]> workers_;
+  std::vector<std::thread> threads_;
+  std::atomic_bool stop_ = false;
+  std::atomic<context::event*> head_ = nullptr;
+  std::atomic<std::size_t> sleeping_ = 0;
+  std::condition_variable cv_;
+  std::mutex mutex_;
+};
+
+}  // namespace ice
@@ -0,0 +1,144 @@
+#pragma once
+#include <ice/context.hpp>
+#include <ice/coroutine.hpp>
+#include <ice/task.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace ice {
+
+// Suspends the awaiting coroutine until the deadline has passed and resumes it on the context thread.
+// Returns false if the context was stopped before the deadline passed.
+class sleep_until : public context::timer {
+public:
+  sleep_until(context& context, context::clock::time_point deadline) noexcept : timer(deadline), context_(context) {
+  }
+
+  bool await_ready() const noexcept {
+    return deadline() <= context::clock::now();
+  }
+
+  void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+    awaiter_ = awaiter;
+    context_.schedule(this);
+  }
+
+  bool await_resume() const noexcept {
+    return !cancelled();
+  }
+
+private:
+  context& context_;
+};
+
+// Suspends the awaiting coroutine for the given duration and resumes it on the context thread.
+class sleep_for final : public sleep_until {
+public:
+  template <typename Rep, typename Period>
+  sleep_for(context& context, std::chrono::duration<Rep, Period> duration) noexcept :
+    sleep_until(context, context::clock::now() + std::chrono::ceil<context::clock::duration>(duration)) {
+  }
+};
+
+namespace detail {
+
+template <typename T>
+class timeout_state {
+public:
+  using value_type = std::conditional_t<std::is_void_v<T>, bool, std::optional<T>>;
+
+  // Returns true for the first caller, which is then responsible for calling set().
+  bool try_acquire() noexcept {
+    return !acquired_.exchange(true, std::memory_order_acq_rel);
+  }
+
+  void set() noexcept {
+    if (ready_.exchange(true, std::memory_order_acq_rel)) {
+      awaiter_.resume();
+    }
+  }
+
+  auto operator co_await() noexcept {
+    struct awaitable {
+      constexpr bool await_ready() const noexcept {
+        return false;
+      }
+
+      bool await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+        state_.awaiter_ = awaiter;
+        return !state_.ready_.exchange(true, std::memory_order_acq_rel);
+      }
+
+      constexpr void await_resume() const noexcept {
+      }
+
+      timeout_state& state_;
+    };
+    return awaitable{ *this };
+  }
+
+  value_type value{};
+
+private:
+  std::atomic_bool acquired_ = false;
+  std::atomic_bool ready_ = false;
+  ice::coroutine_handle<> awaiter_;
+};
+
+template <typename T>
+task<void> watch(task<T> task, std::shared_ptr<timeout_state<T>> state) noexcept {
+  if constexpr (std::is_void_v<T>) {
+    co_await task;
+    if (state->try_acquire()) {
+      state->value = true;
+      state->set();
+    }
+  } else {
+    auto value = co_await std::move(task);
+    if (state->try_acquire()) {
+      state->value.emplace(std::move(value));
+      state->set();
+    }
+  }
+}
+
+template <typename T>
+task<void> expire(context& context, context::clock::time_point deadline, std::shared_ptr<timeout_state<T>> state) noexcept {
+  co_await sleep_until(context, deadline);
+  if (state->try_acquire()) {
+    state->set();
+  }
+}
+
+}  // namespace detail
+
+// Waits for the task to complete, but no longer than the given duration.
+// Returns the task result or std::nullopt (false for void tasks) if the deadline passed first. In that case the
+// task keeps running in the background and destroys itself when it completes. The awaiting coroutine is resumed
+// on the thread that completed the task or on the context thread if the deadline passed first.
+// A timer that lost the race stays in the context until its deadline and then resumes without side effects.
+// Stopping the context expires the timeouts that are still pending.
+template <typename T, typename Rep, typename Period>
+task<typename detail::timeout_state<T>::value_type> with_timeout(
+  context& context, task<T> task, std::chrono::duration<Rep, Period> timeout) noexcept {
+  static_assert(!std::is_reference_v<T>, "with_timeout does not support reference results");
+  if (task.is_ready()) {
+    if constexpr (std::is_void_v<T>) {
+      co_return true;
+    } else {
+      co_return co_await std::move(task);
+    }
+  }
+  const auto deadline = context::clock::now() + std::chrono::ceil<context::clock::duration>(timeout);
+  auto state = std::make_shared<detail::timeout_state<T>>();
+  detail::watch(std::move(task), state).detach();
+  detail::expire(context, deadline, state).detach();
+  co_await *state;
+  co_return std::move(state->value);
+}
+
+}  // namespace ice
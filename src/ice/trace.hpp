@@ -0,0 +1,313 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Lightweight tracing of named stages of work.
+// Every thread that records while tracing is enabled gets a buffer of its own with per-stage statistics and a ring
+// of the most recent spans. Only the owning thread writes to a buffer, so recording takes no locks and no atomic
+// read-modify-write operations; readers sum the statistics of all buffers. While tracing is disabled, recording
+// costs one relaxed load.
+// The queue and resume times of context and thread_pool events are only recorded when ICE_TRACE is defined,
+// because they need a timestamp in every event, which makes coroutine frames larger.
+namespace ice::trace {
+
+using clock = std::chrono::steady_clock;
+
+constexpr std::size_t max_stages = 64;
+constexpr std::size_t buckets = 48;         // powers of two of nanoseconds
+constexpr std::size_t ring_size = 1 << 14;  // spans kept per thread
+
+// Returns the current time in nanoseconds.
+inline std::int64_t now() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+}
+
+namespace detail {
+
+inline std::atomic_bool enabled = false;
+
+struct span {
+  std::int64_t start = 0;
+  std::int64_t duration = 0;
+  std::uint64_t bytes = 0;
+  std::uint32_t stage = 0;
+};
+
+struct counters {
+  std::atomic<std::uint64_t> count = 0;
+  std::atomic<std::uint64_t> total = 0;
+  std::atomic<std::uint64_t> bytes = 0;
+  std::array<std::atomic<std::uint64_t>, buckets> histogram = {};
+};
+
+// Adds to a value that only the calling thread writes.
+inline void add(std::atomic<std::uint64_t>& value, std::uint64_t n) noexcept {
+  value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+class buffer {
+public:
+  explicit buffer(std::uint32_t id) : id_(id), spans_(new span[ring_size]) {
+  }
+
+  void record(std::uint32_t stage, std::int64_t start, std::int64_t end, std::uint64_t bytes) noexcept {
+    const auto duration = static_cast<std::uint64_t>(std::max<std::int64_t>(end - start, 0));
+    auto& counters = counters_[stage];
+    add(counters.count, 1);
+    add(counters.total, duration);
+    add(counters.bytes, bytes);
+    add(counters.histogram[bucket(duration)], 1);
+    const auto head = head_.load(std::memory_order_relaxed);
+    spans_[head % ring_size] = { start, static_cast<std::int64_t>(duration), bytes, stage };
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  static std::size_t bucket(std::uint64_t duration) noexcept {
+    return std::min<std::size_t>(std::max<std::size_t>(std::bit_width(duration), 1), buckets) - 1;
+  }
+
+  std::uint32_t id() const noexcept {
+    return id_;
+  }
+
+  const counters& stage(std::uint32_t index) const noexcept {
+    return counters_[index];
+  }
+
+  // Returns the spans that are still in the ring, oldest first.
+  std::vector<span> spans() const {
+    const auto head = head_.load(std::memory_order_acquire);
+    const auto size = std::min<std::uint64_t>(head, ring_size);
+    std::vector<span> spans;
+    spans.reserve(static_cast<std::size_t>(size));
+    for (auto i = head - size; i < head; i++) {
+      spans.push_back(spans_[i % ring_size]);
+    }
+    return spans;
+  }
+
+  void reset() noexcept {
+    for (auto& counters : counters_) {
+      counters.count.store(0, std::memory_order_relaxed);
+      counters.total.store(0, std::memory_order_relaxed);
+      counters.bytes.store(0, std::memory_order_relaxed);
+      for (auto& bucket : counters.histogram) {
+        bucket.store(0, std::memory_order_relaxed);
+      }
+    }
+    head_.store(0, std::memory_order_release);
+  }
+
+private:
+  const std::uint32_t id_;
+  std::array<counters, max_stages> counters_;
+  std::unique_ptr<span[]> spans_;
+  std::atomic<std::uint64_t> head_ = 0;
+};
+
+// Stage names and the buffers of all threads that ever recorded. Buffers live until the process exits, so the
+// spans of threads that have finished can still be written out.
+struct registry {
+  std::mutex mutex;
+  std::array<const char*, max_stages> names = {};
+  std::uint32_t stages = 0;
+  std::vector<std::unique_ptr<buffer>> buffers;
+};
+
+inline registry& instance() noexcept {
+  static registry registry;
+  return registry;
+}
+
+inline buffer& local() noexcept {
+  thread_local buffer* local = nullptr;
+  if (!local) {
+    auto& registry = instance();
+    std::lock_guard lock{ registry.mutex };
+    registry.buffers.push_back(std::make_unique<buffer>(static_cast<std::uint32_t>(registry.buffers.size() + 1)));
+    local = registry.buffers.back().get();
+  }
+  return *local;
+}
+
+// Writes a JSON string with quotes, backslashes and control characters escaped.
+inline void write_string(std::FILE* file, const char* text) {
+  std::fputc('"', file);
+  for (; *text; text++) {
+    const auto c = static_cast<unsigned char>(*text);
+    if (c == '"' || c == '\\') {
+      std::fputc('\\', file);
+      std::fputc(c, file);
+    } else if (c < 0x20) {
+      std::fprintf(file, "\\u%04x", c);
+    } else {
+      std::fputc(c, file);
+    }
+  }
+  std::fputc('"', file);
+}
+
+}  // namespace detail
+
+inline bool enabled() noexcept {
+  return detail::enabled.load(std::memory_order_relaxed);
+}
+
+inline void enable(bool enabled = true) noexcept {
+  detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+// A named stage of work. Stages are meant to be defined once as inline variables next to the code they measure.
+class stage {
+public:
+  explicit stage(const char* name) noexcept {
+    auto& registry = detail::instance();
+    std::lock_guard lock{ registry.mutex };
+    assert(registry.stages < max_stages);
+    index_ = std::min<std::uint32_t>(registry.stages, max_stages - 1);
+    registry.names[index_] = name;
+    registry.stages = std::max(registry.stages, index_ + 1);
+  }
+
+  stage(const stage& other) = delete;
+  stage& operator=(const stage& other) = delete;
+
+  std::uint32_t index() const noexcept {
+    return index_;
+  }
+
+  const char* name() const noexcept {
+    return detail::instance().names[index_];
+  }
+
+private:
+  std::uint32_t index_ = 0;
+};
+
+// Records a span of a stage on the calling thread. Times are in nanoseconds as returned by now().
+inline void record(const stage& stage, std::int64_t start, std::int64_t end, std::uint64_t bytes = 0) noexcept {
+  if (enabled()) {
+    detail::local().record(stage.index(), start, end, bytes);
+  }
+}
+
+// Records the time from its construction to its destruction as a span of a stage.
+class span {
+public:
+  explicit span(const stage& stage, std::uint64_t bytes = 0) noexcept :
+    stage_(enabled() ? &stage : nullptr), start_(stage_ ? now() : 0), bytes_(bytes) {
+  }
+
+  span(const span& other) = delete;
+  span& operator=(const span& other) = delete;
+
+  ~span() {
+    if (stage_) {
+      record(*stage_, start_, now(), bytes_);
+    }
+  }
+
+  void bytes(std::uint64_t bytes) noexcept {
+    bytes_ = bytes;
+  }
+
+private:
+  const stage* const stage_;
+  const std::int64_t start_;
+  std::uint64_t bytes_;
+};
+
+struct statistics {
+  const char* name = nullptr;
+  std::uint64_t count = 0;
+  std::uint64_t total = 0;  // nanoseconds
+  std::uint64_t bytes = 0;
+  std::array<std::uint64_t, buckets> histogram = {};
+
+  // Returns the upper bound in nanoseconds of the histogram bucket that contains the percentile (0.0 - 1.0).
+  std::uint64_t percentile(double p) const noexcept {
+    const auto rank = static_cast<std::uint64_t>(p * static_cast<double>(count) + 0.5);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets; i++) {
+      seen += histogram[i];
+      if (seen && seen >= rank) {
+        return std::uint64_t(2) << i;
+      }
+    }
+    return 0;
+  }
+};
+
+// Returns the statistics of every stage that recorded a span, summed over all threads.
+inline std::vector<statistics> stats() {
+  auto& registry = detail::instance();
+  std::lock_guard lock{ registry.mutex };
+  std::vector<statistics> stats;
+  for (std::uint32_t index = 0; index < registry.stages; index++) {
+    statistics stage;
+    stage.name = registry.names[index];
+    for (const auto& buffer : registry.buffers) {
+      const auto& counters = buffer->stage(index);
+      stage.count += counters.count.load(std::memory_order_relaxed);
+      stage.total += counters.total.load(std::memory_order_relaxed);
+      stage.bytes += counters.bytes.load(std::memory_order_relaxed);
+      for (std::size_t i = 0; i < buckets; i++) {
+        stage.histogram[i] += counters.histogram[i].load(std::memory_order_relaxed);
+      }
+    }
+    if (stage.count) {
+      stats.push_back(stage);
+    }
+  }
+  return stats;
+}
+
+// Clears all statistics and spans. Must not be called while a thread records.
+inline void reset() noexcept {
+  auto& registry = detail::instance();
+  std::lock_guard lock{ registry.mutex };
+  for (auto& buffer : registry.buffers) {
+    buffer->reset();
+  }
+}
+
+// Writes the spans of all threads in the Chrome trace event format, which chrome://tracing and Perfetto load.
+// Spans that are recorded while this function runs may be torn, so tracing should be disabled first.
+inline void write_chrome_trace(std::FILE* file) {
+  auto& registry = detail::instance();
+  std::lock_guard lock{ registry.mutex };
+  std::vector<std::pair<std::uint32_t, std::vector<detail::span>>> threads;
+  auto origin = INT64_MAX;
+  for (const auto& buffer : registry.buffers) {
+    auto spans = buffer->spans();
+    for (const auto& span : spans) {
+      origin = std::min(origin, span.start);
+    }
+    threads.emplace_back(buffer->id(), std::move(spans));
+  }
+  std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  auto first = true;
+  for (const auto& [id, spans] : threads) {
+    std::fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}", first ? "" : ",", id, id);
+    first = false;
+    for (const auto& span : spans) {
+      std::fprintf(file, ",\n{\"name\":");
+      detail::write_string(file, registry.names[span.stage]);
+      std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%llu}}", id,
+        static_cast<double>(span.start - origin) / 1e3, static_cast<double>(span.duration) / 1e3, static_cast<unsigned long long>(span.bytes));
+    }
+  }
+  std::fprintf(file, "\n]}\n");
+}
+
+}  // namespace ice::trace
@@ -0,0 +1,116 @@
+#pragma once
+#include <ice/coroutine.hpp>
+#include <ice/task.hpp>
+#include <atomic>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <cstddef>
+
+namespace ice {
+namespace detail {
+
+// Counts down task completions and resumes the awaiting coroutine after the last one.
+// The counter starts at the number of tasks plus one for the awaiting coroutine, so that tasks which complete
+// while the others are still being started cannot resume it early.
+class when_all_counter {
+public:
+  explicit when_all_counter(std::size_t count) noexcept : count_(count + 1) {
+  }
+
+  when_all_counter(const when_all_counter& other) = delete;
+  when_all_counter& operator=(const when_all_counter& other) = delete;
+
+  continuation get_continuation() noexcept {
+    return continuation{ &on_ready, this };
+  }
+
+  bool try_await(ice::coroutine_handle<> awaiter) noexcept {
+    awaiter_ = awaiter;
+    return count_.fetch_sub(1, std::memory_order_acq_rel) > 1;
+  }
+
+private:
+  static void on_ready(void* state) noexcept {
+    const auto counter = static_cast<when_all_counter*>(state);
+    if (counter->count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      counter->awaiter_.resume();
+    }
+  }
+
+  std::atomic<std::size_t> count_;
+  ice::coroutine_handle<> awaiter_;
+};
+
+template <typename T>
+struct is_task : std::false_type {};
+
+template <typename T>
+struct is_task<task<T>> : std::true_type {};
+
+}  // namespace detail
+
+// Waits until all tasks are ready. The results can then be retrieved with co_await on each task
+// without suspending. The state lives in the awaitable, so waiting does not allocate.
+template <typename... T>
+auto when_all(task<T>&... tasks) noexcept {
+  class awaitable {
+  public:
+    explicit awaitable(task<T>&... tasks) noexcept : tasks_(tasks...), counter_(sizeof...(T)) {
+    }
+
+    bool await_ready() const noexcept {
+      return std::apply([](auto&... tasks) { return (tasks.is_ready() && ...); }, tasks_);
+    }
+
+    bool await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+      std::apply([this](auto&... tasks) { (tasks.get_starter().start(counter_.get_continuation()), ...); }, tasks_);
+      return counter_.try_await(awaiter);
+    }
+
+    constexpr void await_resume() const noexcept {
+    }
+
+  private:
+    std::tuple<task<T>&...> tasks_;
+    detail::when_all_counter counter_;
+  };
+  return awaitable{ tasks... };
+}
+
+// Waits until all tasks in the range are ready. The results can then be retrieved with co_await on each task
+// without suspending. The state lives in the awaitable, so waiting does not allocate.
+template <typename Range, typename = std::enable_if_t<!detail::is_task<std::decay_t<Range>>::value>>
+auto when_all(Range& tasks) noexcept {
+  class awaitable {
+  public:
+    explicit awaitable(Range& tasks) noexcept : tasks_(tasks), counter_(std::size(tasks)) {
+    }
+
+    bool await_ready() const noexcept {
+      for (auto& task : tasks_) {
+        if (!task.is_ready()) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+      for (auto& task : tasks_) {
+        task.get_starter().start(counter_.get_continuation());
+      }
+      return counter_.try_await(awaiter);
+    }
+
+    constexpr void await_resume() const noexcept {
+    }
+
+  private:
+    Range& tasks_;
+    detail::when_all_counter counter_;
+  };
+  return awaitable{ tasks };
+}
+
+}  // namespace ice
@@ -0,0 +1,123 @@
+#pragma once
+#include <ice/coroutine.hpp>
+#include <ice/task.hpp>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <vector>
+#include <cassert>
+#include <cstddef>
+
+namespace ice {
+namespace detail {
+
+// Shared state of a when_any operation.
+// Tasks cannot be cancelled, so the state takes ownership of all tasks and stays alive until every one of them
+// has completed. It holds one reference per task and one for the awaiting coroutine. Every task completes into a
+// slot of its own, so that the task that wins can record its index. The slots are stored behind the state in the
+// same allocation.
+template <typename T>
+class when_any_state {
+public:
+  static when_any_state* create(std::vector<task<T>>&& tasks) noexcept {
+    static_assert(sizeof(when_any_state) % alignof(slot) == 0);
+    const auto memory = ::operator new(sizeof(when_any_state) + tasks.size() * sizeof(slot));
+    return new (memory) when_any_state(std::move(tasks));
+  }
+
+  when_any_state(const when_any_state& other) = delete;
+  when_any_state& operator=(const when_any_state& other) = delete;
+
+  bool start(ice::coroutine_handle<> awaiter) noexcept {
+    awaiter_ = awaiter;
+    for (std::size_t index = 0; index < tasks_.size(); index++) {
+      tasks_[index].get_starter().start(continuation{ &on_ready, slots() + index });
+    }
+    return !ready_.exchange(true, std::memory_order_acq_rel);
+  }
+
+  // Returns the task that completed first. Other tasks may have completed since, but did not win.
+  std::pair<std::size_t, task<T>> result() noexcept {
+    auto result = std::make_pair(winner_, std::move(tasks_[winner_]));
+    release();
+    return result;
+  }
+
+private:
+  struct slot {
+    when_any_state* state = nullptr;
+    std::size_t index = 0;
+  };
+
+  explicit when_any_state(std::vector<task<T>>&& tasks) noexcept : tasks_(std::move(tasks)), references_(tasks_.size() + 1) {
+    for (std::size_t index = 0; index < tasks_.size(); index++) {
+      new (slots() + index) slot{ this, index };
+    }
+  }
+
+  slot* slots() noexcept {
+    return reinterpret_cast<slot*>(this + 1);
+  }
+
+  // The winner records its index before it publishes the result with the exchange of ready_.
+  static void on_ready(void* data) noexcept {
+    const auto [state, index] = *static_cast<slot*>(data);
+    if (!state->won_.exchange(true, std::memory_order_acq_rel)) {
+      state->winner_ = index;
+      if (state->ready_.exchange(true, std::memory_order_acq_rel)) {
+        state->awaiter_.resume();
+      }
+    }
+    state->release();
+  }
+
+  void release() noexcept {
+    if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      this->~when_any_state();
+      ::operator delete(this);
+    }
+  }
+
+  std::vector<task<T>> tasks_;
+  std::atomic<std::size_t> references_;
+  std::size_t winner_ = 0;
+  std::atomic_bool won_ = false;
+  std::atomic_bool ready_ = false;
+  ice::coroutine_handle<> awaiter_;
+};
+
+}  // namespace detail
+
+// Waits until the first task is ready and returns its index together with the task.
+// The remaining tasks keep running and are destroyed after they complete. Unlike when_all, the state cannot live
+// in the awaitable: the awaiting coroutine resumes, and may finish, while the other tasks still complete into
+// their slots. The state and its slots therefore take one allocation per call, see the when_any benchmark.
+template <typename T>
+auto when_any(std::vector<task<T>> tasks) noexcept {
+  class awaitable {
+  public:
+    explicit awaitable(std::vector<task<T>>&& tasks) noexcept : tasks_(std::move(tasks)) {
+      assert(!tasks_.empty());
+    }
+
+    constexpr bool await_ready() const noexcept {
+      return false;
+    }
+
+    bool await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+      state_ = detail::when_any_state<T>::create(std::move(tasks_));
+      return state_->start(awaiter);
+    }
+
+    std::pair<std::size_t, task<T>> await_resume() noexcept {
+      return state_->result();
+    }
+
+  private:
+    std::vector<task<T>> tasks_;
+    detail::when_any_state<T>* state_ = nullptr;
+  };
+  return awaitable{ std::move(tasks) };
+}
+
+}  // namespace ice
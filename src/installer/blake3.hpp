@@ -0,0 +1,406 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define INSTALLER_BLAKE3_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define INSTALLER_TARGET_AVX2
+#else
+#define INSTALLER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define INSTALLER_BLAKE3_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace installer::blake3 {
+
+// BLAKE3 compression function and chunk kernels.
+// https://github.com/BLAKE3-team/BLAKE3/blob/master/reference_impl/reference_impl.rs
+
+constexpr std::size_t block_size = 64;
+constexpr std::size_t chunk_size = 1024;
+
+constexpr std::uint32_t chunk_start = 1 << 0;
+constexpr std::uint32_t chunk_end = 1 << 1;
+constexpr std::uint32_t parent_node = 1 << 2;
+constexpr std::uint32_t root_node = 1 << 3;
+
+using words = std::array<std::uint32_t, 8>;
+
+constexpr words iv = {
+  0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+// Message word order of each round.
+constexpr std::uint8_t schedule[7][16] = {
+  { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+  { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+  { 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+  { 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+  { 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+  { 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+  { 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 },
+};
+
+constexpr std::uint32_t rotr(std::uint32_t value, int count) noexcept {
+  return (value >> count) | (value << (32 - count));
+}
+
+constexpr void g(std::uint32_t* s, int a, int b, int c, int d, std::uint32_t x, std::uint32_t y) noexcept {
+  s[a] = s[a] + s[b] + x;
+  s[d] = rotr(s[d] ^ s[a], 16);
+  s[c] = s[c] + s[d];
+  s[b] = rotr(s[b] ^ s[c], 12);
+  s[a] = s[a] + s[b] + y;
+  s[d] = rotr(s[d] ^ s[a], 8);
+  s[c] = s[c] + s[d];
+  s[b] = rotr(s[b] ^ s[c], 7);
+}
+
+constexpr std::array<std::uint32_t, 16> compress(
+  const words& cv, const std::uint32_t* block, std::uint64_t counter, std::uint32_t size, std::uint32_t flags) noexcept {
+  std::array<std::uint32_t, 16> s = {
+    cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+    iv[0], iv[1], iv[2], iv[3],
+    static_cast<std::uint32_t>(counter), static_cast<std::uint32_t>(counter >> 32), size, flags,
+  };
+  for (const auto& m : schedule) {
+    g(s.data(), 0, 4, 8, 12, block[m[0]], block[m[1]]);
+    g(s.data(), 1, 5, 9, 13, block[m[2]], block[m[3]]);
+    g(s.data(), 2, 6, 10, 14, block[m[4]], block[m[5]]);
+    g(s.data(), 3, 7, 11, 15, block[m[6]], block[m[7]]);
+    g(s.data(), 0, 5, 10, 15, block[m[8]], block[m[9]]);
+    g(s.data(), 1, 6, 11, 12, block[m[10]], block[m[11]]);
+    g(s.data(), 2, 7, 8, 13, block[m[12]], block[m[13]]);
+    g(s.data(), 3, 4, 9, 14, block[m[14]], block[m[15]]);
+  }
+  for (std::size_t i = 0; i < 8; i++) {
+    s[i] ^= s[i + 8];
+    s[i + 8] ^= cv[i];
+  }
+  return s;
+}
+
+// Loads up to one block of little-endian message words and pads it with zeros.
+inline void load(std::uint32_t* block, const std::uint8_t* data, std::size_t size) noexcept {
+  std::uint8_t bytes[block_size] = {};
+  std::memcpy(bytes, data, size);
+  if constexpr (std::endian::native == std::endian::little) {
+    std::memcpy(block, bytes, block_size);
+    return;
+  }
+  for (std::size_t i = 0; i < 16; i++) {
+    block[i] = static_cast<std::uint32_t>(bytes[i * 4]) | static_cast<std::uint32_t>(bytes[i * 4 + 1]) << 8 |
+      static_cast<std::uint32_t>(bytes[i * 4 + 2]) << 16 | static_cast<std::uint32_t>(bytes[i * 4 + 3]) << 24;
+  }
+}
+
+// Computes the chaining value of a whole chunk that is not the root.
+inline words hash_chunk(const std::uint8_t* input, std::uint64_t counter) noexcept {
+  words cv = iv;
+  for (std::size_t i = 0; i < chunk_size / block_size; i++) {
+    std::uint32_t block[16];
+    load(block, input + i * block_size, block_size);
+    const auto flags = (i == 0 ? chunk_start : 0) | (i == chunk_size / block_size - 1 ? chunk_end : 0);
+    const auto s = compress(cv, block, counter, block_size, flags);
+    std::memcpy(cv.data(), s.data(), sizeof(cv));
+  }
+  return cv;
+}
+
+#ifdef INSTALLER_BLAKE3_AVX2
+
+// Hashes eight consecutive chunks at once with one chunk per 32-bit lane.
+namespace avx2 {
+
+constexpr std::size_t lanes = 8;
+
+INSTALLER_TARGET_AVX2 inline __m256i rotr16(__m256i x) noexcept {
+  return _mm256_shuffle_epi8(x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2, 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+
+INSTALLER_TARGET_AVX2 inline __m256i rotr8(__m256i x) noexcept {
+  return _mm256_shuffle_epi8(x, _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1, 12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+}
+
+INSTALLER_TARGET_AVX2 inline __m256i rotr12(__m256i x) noexcept {
+  return _mm256_or_si256(_mm256_srli_epi32(x, 12), _mm256_slli_epi32(x, 20));
+}
+
+INSTALLER_TARGET_AVX2 inline __m256i rotr7(__m256i x) noexcept {
+  return _mm256_or_si256(_mm256_srli_epi32(x, 7), _mm256_slli_epi32(x, 25));
+}
+
+INSTALLER_TARGET_AVX2 inline void g(__m256i* s, int a, int b, int c, int d, __m256i x, __m256i y) noexcept {
+  s[a] = _mm256_add_epi32(_mm256_add_epi32(s[a], s[b]), x);
+  s[d] = rotr16(_mm256_xor_si256(s[d], s[a]));
+  s[c] = _mm256_add_epi32(s[c], s[d]);
+  s[b] = rotr12(_mm256_xor_si256(s[b], s[c]));
+  s[a] = _mm256_add_epi32(_mm256_add_epi32(s[a], s[b]), y);
+  s[d] = rotr8(_mm256_xor_si256(s[d], s[a]));
+  s[c] = _mm256_add_epi32(s[c], s[d]);
+  s[b] = rotr7(_mm256_xor_si256(s[b], s[c]));
+}
+
+// Transposes an 8x8 matrix of 32-bit words.
+INSTALLER_TARGET_AVX2 inline void transpose(__m256i* v) noexcept {
+  const auto t0 = _mm256_unpacklo_epi32(v[0], v[1]);
+  const auto t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+  const auto t2 = _mm256_unpacklo_epi32(v[2], v[3]);
+  const auto t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+  const auto t4 = _mm256_unpacklo_epi32(v[4], v[5]);
+  const auto t5 = _mm256_unpackhi_epi32(v[4], v[5]);
+  const auto t6 = _mm256_unpacklo_epi32(v[6], v[7]);
+  const auto t7 = _mm256_unpackhi_epi32(v[6], v[7]);
+  const auto u0 = _mm256_unpacklo_epi64(t0, t2);
+  const auto u1 = _mm256_unpackhi_epi64(t0, t2);
+  const auto u2 = _mm256_unpacklo_epi64(t1, t3);
+  const auto u3 = _mm256_unpackhi_epi64(t1, t3);
+  const auto u4 = _mm256_unpacklo_epi64(t4, t6);
+  const auto u5 = _mm256_unpackhi_epi64(t4, t6);
+  const auto u6 = _mm256_unpacklo_epi64(t5, t7);
+  const auto u7 = _mm256_unpackhi_epi64(t5, t7);
+  v[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  v[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  v[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  v[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  v[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  v[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  v[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  v[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+INSTALLER_TARGET_AVX2 inline void hash_chunks(const std::uint8_t* input, std::uint64_t counter, words* out) noexcept {
+  __m256i cv[8];
+  for (std::size_t i = 0; i < 8; i++) {
+    cv[i] = _mm256_set1_epi32(static_cast<int>(iv[i]));
+  }
+  alignas(32) std::uint32_t low[lanes];
+  alignas(32) std::uint32_t high[lanes];
+  for (std::size_t lane = 0; lane < lanes; lane++) {
+    low[lane] = static_cast<std::uint32_t>(counter + lane);
+    high[lane] = static_cast<std::uint32_t>((counter + lane) >> 32);
+  }
+  const auto counter_low = _mm256_load_si256(reinterpret_cast<const __m256i*>(low));
+  const auto counter_high = _mm256_load_si256(reinterpret_cast<const __m256i*>(high));
+  const auto size = _mm256_set1_epi32(static_cast<int>(block_size));
+  for (std::size_t block = 0; block < chunk_size / block_size; block++) {
+    __m256i m[16];
+    for (std::size_t half = 0; half < 2; half++) {
+      for (std::size_t lane = 0; lane < lanes; lane++) {
+        const auto data = input + lane * chunk_size + block * block_size + half * 32;
+        m[half * 8 + lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+      }
+      transpose(m + half * 8);
+    }
+    const auto flags = (block == 0 ? chunk_start : 0) | (block == chunk_size / block_size - 1 ? chunk_end : 0);
+    __m256i s[16] = {
+      cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+      _mm256_set1_epi32(static_cast<int>(iv[0])), _mm256_set1_epi32(static_cast<int>(iv[1])),
+      _mm256_set1_epi32(static_cast<int>(iv[2])), _mm256_set1_epi32(static_cast<int>(iv[3])),
+      counter_low, counter_high, size, _mm256_set1_epi32(static_cast<int>(flags)),
+    };
+    for (const auto& r : schedule) {
+      g(s, 0, 4, 8, 12, m[r[0]], m[r[1]]);
+      g(s, 1, 5, 9, 13, m[r[2]], m[r[3]]);
+      g(s, 2, 6, 10, 14, m[r[4]], m[r[5]]);
+      g(s, 3, 7, 11, 15, m[r[6]], m[r[7]]);
+      g(s, 0, 5, 10, 15, m[r[8]], m[r[9]]);
+      g(s, 1, 6, 11, 12, m[r[10]], m[r[11]]);
+      g(s, 2, 7, 8, 13, m[r[12]], m[r[13]]);
+      g(s, 3, 4, 9, 14, m[r[14]], m[r[15]]);
+    }
+    for (std::size_t i = 0; i < 8; i++) {
+      cv[i] = _mm256_xor_si256(s[i], s[i + 8]);
+    }
+  }
+  transpose(cv);
+  for (std::size_t lane = 0; lane < lanes; lane++) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[lane].data()), cv[lane]);
+  }
+}
+
+inline bool supported() noexcept {
+#ifdef _MSC_VER
+  int info[4] = {};
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  constexpr int osxsave = 1 << 27;
+  constexpr int avx = 1 << 28;
+  if ((info[2] & (osxsave | avx)) != (osxsave | avx) || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+}  // namespace avx2
+
+#endif
+
+#ifdef INSTALLER_BLAKE3_NEON
+
+// Hashes four consecutive chunks at once with one chunk per 32-bit lane.
+namespace neon {
+
+constexpr std::size_t lanes = 4;
+
+template <int Count>
+inline uint32x4_t rotr(uint32x4_t x) noexcept {
+  return vorrq_u32(vshrq_n_u32(x, Count), vshlq_n_u32(x, 32 - Count));
+}
+
+template <>
+inline uint32x4_t rotr<16>(uint32x4_t x) noexcept {
+  return vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(x)));
+}
+
+inline void g(uint32x4_t* s, int a, int b, int c, int d, uint32x4_t x, uint32x4_t y) noexcept {
+  s[a] = vaddq_u32(vaddq_u32(s[a], s[b]), x);
+  s[d] = rotr<16>(veorq_u32(s[d], s[a]));
+  s[c] = vaddq_u32(s[c], s[d]);
+  s[b] = rotr<12>(veorq_u32(s[b], s[c]));
+  s[a] = vaddq_u32(vaddq_u32(s[a], s[b]), y);
+  s[d] = rotr<8>(veorq_u32(s[d], s[a]));
+  s[c] = vaddq_u32(s[c], s[d]);
+  s[b] = rotr<7>(veorq_u32(s[b], s[c]));
+}
+
+// Transposes a 4x4 matrix of 32-bit words.
+inline void transpose(uint32x4_t* v) noexcept {
+  const auto t01 = vtrnq_u32(v[0], v[1]);
+  const auto t23 = vtrnq_u32(v[2], v[3]);
+  v[0] = vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0]));
+  v[1] = vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1]));
+  v[2] = vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0]));
+  v[3] = vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1]));
+}
+
+inline void hash_chunks(const std::uint8_t* input, std::uint64_t counter, words* out) noexcept {
+  uint32x4_t cv[8];
+  for (std::size_t i = 0; i < 8; i++) {
+    cv[i] = vdupq_n_u32(iv[i]);
+  }
+  std::uint32_t low[lanes];
+  std::uint32_t high[lanes];
+  for (std::size_t lane = 0; lane < lanes; lane++) {
+    low[lane] = static_cast<std::uint32_t>(counter + lane);
+    high[lane] = static_cast<std::uint32_t>((counter + lane) >> 32);
+  }
+  const auto counter_low = vld1q_u32(low);
+  const auto counter_high = vld1q_u32(high);
+  const auto size = vdupq_n_u32(static_cast<std::uint32_t>(block_size));
+  for (std::size_t block = 0; block < chunk_size / block_size; block++) {
+    uint32x4_t m[16];
+    for (std::size_t quarter = 0; quarter < 4; quarter++) {
+      for (std::size_t lane = 0; lane < lanes; lane++) {
+        const auto data = input + lane * chunk_size + block * block_size + quarter * 16;
+        m[quarter * 4 + lane] = vreinterpretq_u32_u8(vld1q_u8(data));
+      }
+      transpose(m + quarter * 4);
+    }
+    const auto flags = (block == 0 ? chunk_start : 0) | (block == chunk_size / block_size - 1 ? chunk_end : 0);
+    uint32x4_t s[16] = {
+      cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+      vdupq_n_u32(iv[0]), vdupq_n_u32(iv[1]), vdupq_n_u32(iv[2]), vdupq_n_u32(iv[3]),
+      counter_low, counter_high, size, vdupq_n_u32(flags),
+    };
+    for (const auto& r : schedule) {
+      g(s, 0, 4, 8, 12, m[r[0]], m[r[1]]);
+      g(s, 1, 5, 9, 13, m[r[2]], m[r[3]]);
+      g(s, 2, 6, 10, 14, m[r[4]], m[r[5]]);
+      g(s, 3, 7, 11, 15, m[r[6]], m[r[7]]);
+      g(s, 0, 5, 10, 15, m[r[8]], m[r[9]]);
+      g(s, 1, 6, 11, 12, m[r[10]], m[r[11]]);
+      g(s, 2, 7, 8, 13, m[r[12]], m[r[13]]);
+      g(s, 3, 4, 9, 14, m[r[14]], m[r[15]]);
+    }
+    for (std::size_t i = 0; i < 8; i++) {
+      cv[i] = veorq_u32(s[i], s[i + 8]);
+    }
+  }
+  transpose(cv);
+  transpose(cv + 4);
+  for (std::size_t lane = 0; lane < lanes; lane++) {
+    vst1q_u32(out[lane].data(), cv[lane]);
+    vst1q_u32(out[lane].data() + 4, cv[lane + 4]);
+  }
+}
+
+}  // namespace neon
+
+#endif
+
+// Implementation used for whole chunks.
+enum class kernel {
+  portable,
+  avx2,
+  neon,
+};
+
+inline kernel detect() noexcept {
+#if defined(INSTALLER_BLAKE3_AVX2)
+  if (avx2::supported()) {
+    return kernel::avx2;
+  }
+#elif defined(INSTALLER_BLAKE3_NEON)
+  return kernel::neon;
+#endif
+  return kernel::portable;
+}
+
+// Returns the best kernel for this CPU. The CPU is only inspected once.
+inline kernel best() noexcept {
+  static const auto kernel = detect();
+  return kernel;
+}
+
+// Returns the number of chunks that a kernel hashes at once.
+constexpr std::size_t lanes(kernel type) noexcept {
+  switch (type) {
+#ifdef INSTALLER_BLAKE3_AVX2
+  case kernel::avx2:
+    return avx2::lanes;
+#endif
+#ifdef INSTALLER_BLAKE3_NEON
+  case kernel::neon:
+    return neon::lanes;
+#endif
+  default:
+    return 1;
+  }
+}
+
+// Computes the chaining values of lanes(type) consecutive whole chunks, none of which is the root.
+inline void hash_chunks(kernel type, const std::uint8_t* input, std::uint64_t counter, words* out) noexcept {
+  switch (type) {
+#ifdef INSTALLER_BLAKE3_AVX2
+  case kernel::avx2:
+    avx2::hash_chunks(input, counter, out);
+    return;
+#endif
+#ifdef INSTALLER_BLAKE3_NEON
+  case kernel::neon:
+    neon::hash_chunks(input, counter, out);
+    return;
+#endif
+  default:
+    out[0] = hash_chunk(input, counter);
+    return;
+  }
+}
+
+}  // namespace installer::blake3
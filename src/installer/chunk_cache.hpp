@@ -0,0 +1,167 @@
+#pragma once
+#include <installer/hash.hpp>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace installer {
+
+// Cache of decompressed and verified chunks keyed by their digest.
+// Entries are spread over shards by digest, each with its own lock and an equal part of the byte budget. When a
+// shard is full, entries are evicted in CLOCK order: an entry that was found since the hand last passed it gets
+// a second chance. Cached data is shared, so an entry that is evicted while a writer still uses it stays valid
+// until the writer releases it; the budget only covers the entries in the cache.
+class chunk_cache {
+public:
+  using buffer = std::shared_ptr<const std::byte[]>;
+
+  static constexpr std::size_t shards = 16;
+
+  struct statistics {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t insertions = 0;
+    std::uint64_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t size = 0;  // bytes
+  };
+
+  explicit chunk_cache(std::size_t budget) noexcept : budget_(budget) {
+  }
+
+  chunk_cache(chunk_cache&& other) = delete;
+  chunk_cache(const chunk_cache& other) = delete;
+  chunk_cache& operator=(chunk_cache&& other) = delete;
+  chunk_cache& operator=(const chunk_cache& other) = delete;
+
+  std::size_t budget() const noexcept {
+    return budget_;
+  }
+
+  // Returns the data of the chunk or nullptr when it is not cached.
+  buffer find(const digest& key) noexcept {
+    auto& shard = shard_for(key);
+    std::lock_guard lock{ shard.mutex };
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+      shard.stats.misses++;
+      return nullptr;
+    }
+    auto& slot = shard.slots[it->second];
+    slot.referenced = true;
+    shard.stats.hits++;
+    return slot.data;
+  }
+
+  // Adds the data of a verified chunk. Chunks larger than the budget of a shard are not cached.
+  void insert(const digest& key, buffer data, std::size_t size) noexcept {
+    auto& shard = shard_for(key);
+    const auto budget = budget_ / shards;
+    if (!data || size > budget) {
+      return;
+    }
+    std::lock_guard lock{ shard.mutex };
+    if (shard.index.contains(key)) {
+      return;
+    }
+    while (shard.stats.size + size > budget) {
+      shard.evict();
+    }
+    auto index = shard.slots.size();
+    if (shard.free.empty()) {
+      shard.slots.emplace_back();
+    } else {
+      index = shard.free.back();
+      shard.free.pop_back();
+    }
+    shard.slots[index] = { key, std::move(data), size, false };
+    shard.index.emplace(key, index);
+    shard.stats.insertions++;
+    shard.stats.entries++;
+    shard.stats.size += size;
+  }
+
+  // Returns the sum of the counters of all shards.
+  statistics stats() const noexcept {
+    statistics stats;
+    for (auto& shard : shards_) {
+      std::lock_guard lock{ shard.mutex };
+      stats.hits += shard.stats.hits;
+      stats.misses += shard.stats.misses;
+      stats.insertions += shard.stats.insertions;
+      stats.evictions += shard.stats.evictions;
+      stats.entries += shard.stats.entries;
+      stats.size += shard.stats.size;
+    }
+    return stats;
+  }
+
+  // Removes all entries and keeps the counters.
+  void clear() noexcept {
+    for (auto& shard : shards_) {
+      std::lock_guard lock{ shard.mutex };
+      shard.index.clear();
+      shard.slots.clear();
+      shard.free.clear();
+      shard.hand = 0;
+      shard.stats.entries = 0;
+      shard.stats.size = 0;
+    }
+  }
+
+private:
+  struct slot {
+    digest key;
+    buffer data;
+    std::size_t size = 0;
+    bool referenced = false;
+  };
+
+  struct alignas(64) shard {
+    mutable std::mutex mutex;
+    std::unordered_map<digest, std::size_t, digest_hash> index;
+    std::vector<slot> slots;
+    std::vector<std::size_t> free;
+    std::size_t hand = 0;
+    statistics stats;
+
+    // Moves the hand to the next entry that was not referenced since the last pass and removes it.
+    void evict() noexcept {
+      while (true) {
+        const auto index = hand;
+        auto& slot = slots[index];
+        hand = (hand + 1) % slots.size();
+        if (!slot.data) {
+          continue;
+        }
+        if (slot.referenced) {
+          slot.referenced = false;
+          continue;
+        }
+        this->index.erase(slot.key);
+        stats.evictions++;
+        stats.entries--;
+        stats.size -= slot.size;
+        slot = {};
+        free.push_back(index);
+        return;
+      }
+    }
+  };
+
+  // Digests are uniformly distributed; the index of a shard uses other bytes than digest_hash.
+  shard& shard_for(const digest& key) noexcept {
+    return shards_[key.bytes[digest::size - 1] % shards];
+  }
+
+  const std::size_t budget_;
+  std::array<shard, shards> shards_;
+};
+
+}  // namespace installer
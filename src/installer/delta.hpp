@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace installer {
+
+struct delta_range {
+  std::uint64_t offset;  // offset in the base, or in the target for literal data
+  std::uint64_t size;
+  bool base;
+};
+
+namespace detail {
+
+// rsync weak checksum that can be rolled over the input one byte at a time.
+// https://rsync.samba.org/tech_report/node3.html
+class rolling_checksum {
+public:
+  rolling_checksum(const std::uint8_t* data, std::size_t size) noexcept : size_(static_cast<std::uint32_t>(size)) {
+    for (std::size_t i = 0; i < size; i++) {
+      a_ += data[i];
+      b_ += static_cast<std::uint32_t>(size - i) * data[i];
+    }
+  }
+
+  std::uint32_t value() const noexcept {
+    return (a_ & 0xFFFF) | (b_ << 16);
+  }
+
+  void roll(std::uint8_t out, std::uint8_t in) noexcept {
+    a_ += in - out;
+    b_ += a_ - size_ * out;
+  }
+
+private:
+  std::uint32_t a_ = 0;
+  std::uint32_t b_ = 0;
+  std::uint32_t size_;
+};
+
+}  // namespace detail
+
+// Describes the target as ranges copied from the base and literal ranges of the target.
+// The base is split into blocks whose checksums are looked up at every offset of the target, so blocks that moved
+// are found as well. Candidates are compared byte by byte, which is possible because both versions are available
+// when the package is written. Adjacent copies are merged.
+inline std::vector<delta_range> diff(std::span<const std::byte> base, std::span<const std::byte> target, std::size_t block_size) {
+  const auto old = reinterpret_cast<const std::uint8_t*>(base.data());
+  const auto data = reinterpret_cast<const std::uint8_t*>(target.data());
+  const auto size = target.size();
+  std::vector<delta_range> ranges;
+
+  std::unordered_multimap<std::uint32_t, std::uint64_t> blocks;
+  blocks.reserve(base.size() / block_size);
+  for (std::uint64_t offset = 0; offset + block_size <= base.size(); offset += block_size) {
+    blocks.emplace(detail::rolling_checksum{ old + offset, block_size }.value(), offset);
+  }
+
+  const auto add = [&](std::uint64_t offset, std::uint64_t size, bool base) {
+    if (!ranges.empty() && ranges.back().base == base && ranges.back().offset + ranges.back().size == offset) {
+      ranges.back().size += size;
+    } else {
+      ranges.push_back({ offset, size, base });
+    }
+  };
+
+  std::size_t literal = 0;
+  std::size_t position = 0;
+  if (!blocks.empty() && size >= block_size) {
+    detail::rolling_checksum checksum{ data, block_size };
+    while (true) {
+      auto match = false;
+      const auto [first, last] = blocks.equal_range(checksum.value());
+      for (auto it = first; it != last; ++it) {
+        if (std::memcmp(old + it->second, data + position, block_size) == 0) {
+          if (literal < position) {
+            add(literal, position - literal, false);
+          }
+          add(it->second, block_size, true);
+          match = true;
+          break;
+        }
+      }
+      if (match) {
+        position += block_size;
+        literal = position;
+        if (position + block_size > size) {
+          break;
+        }
+        checksum = detail::rolling_checksum{ data + position, block_size };
+        continue;
+      }
+      if (position + block_size >= size) {
+        break;
+      }
+      checksum.roll(data[position], data[position + block_size]);
+      position++;
+    }
+  }
+  if (literal < size) {
+    add(literal, size - literal, false);
+  }
+  return ranges;
+}
+
+}  // namespace installer
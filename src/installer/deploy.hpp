@@ -0,0 +1,236 @@
+#pragma once
+#include <ice/context.hpp>
+#include <ice/task.hpp>
+#include <ice/thread_pool.hpp>
+#include <ice/timer.hpp>
+#include <installer/chunk_cache.hpp>
+#include <installer/extract.hpp>
+#include <installer/hash.hpp>
+#include <installer/package.hpp>
+#include <installer/transport.hpp>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace installer {
+
+struct deploy_options {
+  std::size_t memory = 64 << 20;  // decompressed bytes that may be decoding or waiting to be written by the targets
+  std::size_t decoders = 0;       // chunks that may be decoded on the thread pool at the same time, 0 for the pool size
+  std::uint64_t bandwidth = 0;    // bytes per second written across all targets, 0 for no limit
+  std::size_t window = 8;         // operations in flight per target
+  bool verify = true;             // check chunk and file digests before anything is written
+  chunk_cache* cache = nullptr;   // decompressed chunks shared with other deployments
+};
+
+struct deploy_result {
+  std::vector<std::error_code> errors;  // one per target
+  std::uint64_t decoded = 0;            // decompressed bytes of all chunks that were not found in the cache
+  std::uint64_t written = 0;            // bytes written to all targets
+};
+
+namespace detail {
+
+// Token bucket that limits the rate of bytes sent.
+// Allows bursts of up to a tenth of a second and lets a single request overdraw the bucket, which is paid back
+// by waiting on the context before the request is granted.
+class rate_limiter {
+public:
+  rate_limiter(ice::context& context, std::uint64_t rate) noexcept : context_(context), rate_(static_cast<double>(rate)) {
+  }
+
+  // Waits until the given number of bytes may be sent.
+  ice::task<void> acquire(std::size_t size) noexcept {
+    if (!rate_) {
+      co_return;
+    }
+    const auto now = ice::context::clock::now();
+    tokens_ = std::min(rate_ / 10, tokens_ + std::chrono::duration<double>(now - last_).count() * rate_);
+    tokens_ -= static_cast<double>(size);
+    last_ = now;
+    if (tokens_ < 0) {
+      co_await ice::sleep_for(context_, std::chrono::duration<double>(-tokens_ / rate_));
+    }
+  }
+
+private:
+  ice::context& context_;
+  const double rate_;
+  double tokens_ = 0;
+  ice::context::clock::time_point last_ = ice::context::clock::now();
+};
+
+}  // namespace detail
+
+// Deploys all files of the package to every target at the same time.
+// Each chunk is decompressed and verified once on the thread pool and then written to all targets from the same
+// buffer, which is recycled when the last target has written it. A chunk counts against options.memory from the
+// start of its decoding until the last target has written it, and at most options.decoders chunks are decoded at
+// the same time. The targets write in lockstep, so the slowest target sets the pace. A target that fails is left
+// behind while the others continue; its error is reported in the result.
+// Must be called on the context thread that the transports complete on, and returns to it after every chunk that
+// was decoded on the thread pool, so that all transport operations are issued from that thread. Packages with
+// deltas are rejected, since the previous version on the targets is not known.
+inline ice::task<deploy_result> deploy(const package& package, std::span<transport* const> targets, ice::context& context,
+  ice::thread_pool& pool, deploy_options options = {}) noexcept {
+  struct pending {
+    ice::task<detail::chunk_data> task;
+    std::size_t size = 0;
+  };
+  deploy_result result;
+  result.errors.resize(targets.size());
+  if (!package.deltas().empty()) {
+    std::fill(result.errors.begin(), result.errors.end(), make_error_code(package_errc::base_mismatch));
+    co_return result;
+  }
+  for (const auto& file : package.files()) {
+    if (const auto ec = package.validate(file)) {
+      std::fill(result.errors.begin(), result.errors.end(), ec);
+      co_return result;
+    }
+  }
+  std::vector<detail::transport_window> windows;
+  windows.reserve(targets.size());
+  for (const auto target : targets) {
+    windows.emplace_back(*target, options.window);
+  }
+  const auto files = package.files();
+  const auto chunk_size = package.header().chunk_size;
+  const auto decoders = options.decoders ? options.decoders : pool.size();
+  detail::rate_limiter limiter{ context, options.bandwidth };
+  std::deque<pending> queue;
+  detail::buffer_pool buffers{ chunk_size };
+  std::size_t in_flight = 0;
+  std::size_t next_file = 0;
+  std::size_t next_ref = 0;
+
+  // Starts decoding the next chunk in package order unless that would exceed the budget. A chunk that is larger
+  // than the budget is started once nothing else is held.
+  const auto start = [&]() {
+    while (next_file < files.size() && next_ref == files[next_file].ref_count) {
+      next_file++;
+      next_ref = 0;
+    }
+    if (next_file == files.size() || queue.size() >= decoders) {
+      return false;
+    }
+    const auto& chunk = package.chunk(package.refs(files[next_file])[next_ref]);
+    if (in_flight && in_flight + chunk.size > options.memory) {
+      return false;
+    }
+    next_ref++;
+    in_flight += chunk.size;
+    if (chunk.compression == format::compression::none) {
+      queue.push_back({ detail::stored(pool, chunk, package.data(chunk), options.verify), chunk.size });
+      return true;
+    }
+    // With a cache, chunks are decompressed into buffers that are shared with the cache instead.
+    auto buffer = std::unique_ptr<std::byte[]>{};
+    if (!options.cache || !options.verify) {
+      buffer = buffers.acquire(chunk.size);
+    }
+    const auto output = std::span{ buffer.get(), buffer ? chunk.size : 0 };
+    queue.push_back({ detail::decompress(pool, chunk, package.data(chunk), output, std::move(buffer), options.verify, options.cache), chunk.size });
+    return true;
+  };
+
+  std::error_code ec;
+  std::vector<char> opened(windows.size());  // targets that have the current file open until its last write
+  for (std::size_t index = 0; index < files.size() && !ec; index++) {
+    const auto& entry = files[index];
+    const auto file = static_cast<transport::handle>(index);
+    for (std::size_t i = 0; i < windows.size(); i++) {
+      if (!windows[i].error()) {
+        co_await windows[i].reserve();
+      }
+      if (!windows[i].error()) {
+        windows[i].open(file, package.path(entry), entry.size);
+        opened[i] = entry.size != 0;
+      }
+    }
+    std::uint64_t offset = 0;
+    hasher digests;
+    const auto refs = package.refs(entry);
+    for (std::size_t ref = 0; ref < refs.size(); ref++) {
+      while (start()) {
+      }
+      // With nothing left to decode, the budget is held by chunks that the targets are still writing.
+      while (queue.empty()) {
+        for (auto& window : windows) {
+          co_await window.wait();
+        }
+        while (start()) {
+        }
+      }
+      auto chunk = co_await std::move(queue.front().task);
+      co_await ice::schedule(context);
+      const auto size = queue.front().size;
+      queue.pop_front();
+      if (!chunk.valid) {
+        ec = package_errc::corrupt_chunk;
+        break;
+      }
+      if (!chunk.hit) {
+        result.decoded += chunk.data.size();
+      }
+      digests.update(std::as_bytes(std::span{ package.chunk(refs[ref]).digest.bytes }));
+      if (ref + 1 == refs.size() && options.verify && digests.finalize() != entry.digest) {
+        ec = package_errc::corrupt_index;
+        break;
+      }
+      // The buffer of a chunk is returned and its size is released from the budget once all targets have written it.
+      std::shared_ptr<const void> owner = std::move(chunk.cached);
+      if (chunk.buffer && !owner) {
+        owner = std::shared_ptr<std::byte>(chunk.buffer.release(), [&buffers, size = chunk.data.size()](std::byte* buffer) {
+          buffers.release(std::unique_ptr<std::byte[]>{ buffer }, size);
+        });
+      } else {
+        buffers.release(std::move(chunk.buffer), chunk.data.size());
+      }
+      owner = std::shared_ptr<const void>(chunk.data.data(), [&in_flight, size, owner](const void*) {
+        in_flight -= size;
+      });
+      for (std::size_t i = 0; i < windows.size(); i++) {
+        if (!windows[i].error()) {
+          co_await limiter.acquire(chunk.data.size());
+          co_await windows[i].reserve();
+        }
+        if (!windows[i].error()) {
+          windows[i].write(file, offset, chunk.data, owner, ref + 1 == refs.size());
+          result.written += chunk.data.size();
+          opened[i] = opened[i] && ref + 1 != refs.size();
+        }
+      }
+      offset += chunk.data.size();
+    }
+    // Targets that failed or a chunk that did not verify leave the file open without its last write. Closes are
+    // issued after all writes of the file have completed.
+    for (std::size_t i = 0; i < windows.size(); i++) {
+      if (opened[i]) {
+        co_await windows[i].drain();
+        windows[i].close(file);
+        opened[i] = false;
+      }
+    }
+  }
+
+  // Tasks must not be destroyed while they are running.
+  for (auto& pending : queue) {
+    co_await pending.task.when_ready();
+  }
+  co_await ice::schedule(context);
+  for (std::size_t i = 0; i < windows.size(); i++) {
+    co_await windows[i].drain();
+    result.errors[i] = ec ? ec : windows[i].error();
+  }
+  co_return result;
+}
+
+}  // namespace installer
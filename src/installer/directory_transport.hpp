@@ -0,0 +1,105 @@
+#pragma once
+#include <ice/context.hpp>
+#include <ice/file.hpp>
+#include <ice/io_service.hpp>
+#include <ice/task.hpp>
+#include <ice/timer.hpp>
+#include <installer/path.hpp>
+#include <installer/transport.hpp>
+#include <chrono>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+namespace installer {
+
+// Transport that writes files below a local directory through an ice::io_service.
+// With a latency, every operation completes no earlier than that long after it was issued, like an operation
+// that has to be acknowledged by a device. This makes the directory a stand-in for a device connection.
+class directory_transport final : public transport {
+public:
+  directory_transport(ice::io_service& service, std::filesystem::path root) noexcept :
+    service_(service), root_(std::move(root)) {
+  }
+
+  directory_transport(ice::io_service& service, std::filesystem::path root, ice::context& context, std::chrono::microseconds latency) noexcept :
+    service_(service), root_(std::move(root)), context_(&context), latency_(latency) {
+  }
+
+  ice::task<std::error_code> open(handle file, std::string_view path, std::uint64_t /*size*/) noexcept override {
+    const auto deadline = this->deadline();
+    std::error_code ec;
+    const auto target = detail::target_path(root_, path);
+    if (target.empty()) {
+      ec = std::make_error_code(std::errc::invalid_argument);
+    }
+    if (!ec) {
+      std::filesystem::create_directories(target.parent_path(), ec);
+    }
+    if (!ec) {
+      auto handle = ice::file::open(service_, target, ice::file_mode::write, ec);
+      if (!ec) {
+        files_.insert_or_assign(file, std::move(handle));
+      }
+    }
+    co_await acknowledge(deadline);
+    co_return ec;
+  }
+
+  ice::task<std::error_code> write(handle file, std::uint64_t offset, std::span<const std::byte> data) noexcept override {
+    const auto deadline = this->deadline();
+    std::error_code ec;
+    if (const auto it = files_.find(file); it != files_.end()) {
+      // An open() while the write is suspended may rehash the map, which keeps references but not iterators valid.
+      const auto& handle = it->second;
+      while (!data.empty()) {
+        const auto result = co_await handle.write(offset, data);
+        if (!result) {
+          ec = result.error;
+          break;
+        }
+        data = data.subspan(result.size);
+        offset += result.size;
+      }
+    } else {
+      ec = std::make_error_code(std::errc::bad_file_descriptor);
+    }
+    co_await acknowledge(deadline);
+    co_return ec;
+  }
+
+  ice::task<std::error_code> close(handle file) noexcept override {
+    const auto deadline = this->deadline();
+    const auto erased = files_.erase(file);
+    co_await acknowledge(deadline);
+    co_return erased ? std::error_code{} : std::make_error_code(std::errc::bad_file_descriptor);
+  }
+
+  const std::filesystem::path& root() const noexcept {
+    return root_;
+  }
+
+private:
+  ice::context::clock::time_point deadline() const noexcept {
+    return context_ ? ice::context::clock::now() + std::chrono::ceil<ice::context::clock::duration>(latency_) : ice::context::clock::time_point{};
+  }
+
+  ice::task<void> acknowledge(ice::context::clock::time_point deadline) noexcept {
+    if (context_) {
+      co_await ice::sleep_until(*context_, deadline);
+    }
+  }
+
+  ice::io_service& service_;
+  const std::filesystem::path root_;
+  ice::context* const context_ = nullptr;
+  const std::chrono::microseconds latency_{};
+  std::unordered_map<handle, ice::file> files_;
+};
+
+}  // namespace installer
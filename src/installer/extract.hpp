@@ -0,0 +1,509 @@
+#pragma once
+#include <ice/file.hpp>
+#include <ice/io_service.hpp>
+#include <ice/task.hpp>
+#include <ice/thread_pool.hpp>
+#include <ice/trace.hpp>
+#include <installer/chunk_cache.hpp>
+#include <installer/file_writer.hpp>
+#include <installer/hash.hpp>
+#include <installer/install_state.hpp>
+#include <installer/journal.hpp>
+#include <installer/lz4.hpp>
+#include <installer/package.hpp>
+#include <installer/path.hpp>
+#include <installer/progress.hpp>
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace installer {
+
+struct extract_options {
+  std::size_t memory = 64 << 20;  // decompressed bytes that may be in flight ahead of the writer
+  bool verify = true;             // check chunk and file digests before anything is written
+  bool incremental = true;        // skip files that are unchanged since the last install
+  chunk_cache* cache = nullptr;   // decompressed chunks shared with other installs
+  bool journal = true;            // stage files and replace them all at once, see install_journal
+  installer::progress* progress = nullptr;  // counts written bytes and files, see report()
+};
+
+namespace detail {
+
+struct chunk_data {
+  std::span<const std::byte> data;
+  std::unique_ptr<std::byte[]> buffer;  // decompression buffer that can be reused
+  chunk_cache::buffer cached;           // owner of data that is shared with the cache
+  bool valid = true;
+  bool hit = false;                     // taken from the cache
+};
+
+inline const ice::trace::stage read_stage{ "read" };
+inline const ice::trace::stage decompress_stage{ "decompress" };
+inline const ice::trace::stage hash_stage{ "hash" };
+inline const ice::trace::stage commit_stage{ "commit" };
+
+// Chunks smaller than this are processed on the writer, where they are cheaper than a trip through the pool.
+constexpr std::size_t inline_size = 64 << 10;
+
+// Decompression buffers. Buffers of the package chunk size are reused, smaller ones for the last chunk of a file
+// are allocated with the size of the chunk so that many small files do not hold on to full-size buffers.
+class buffer_pool {
+public:
+  explicit buffer_pool(std::size_t size) noexcept : size_(size) {
+  }
+
+  std::unique_ptr<std::byte[]> acquire(std::size_t size) {
+    if (size < size_ || buffers_.empty()) {
+      return std::make_unique<std::byte[]>(size);
+    }
+    auto buffer = std::move(buffers_.back());
+    buffers_.pop_back();
+    return buffer;
+  }
+
+  void release(std::unique_ptr<std::byte[]> buffer, std::size_t size) {
+    if (buffer && size == size_) {
+      buffers_.push_back(std::move(buffer));
+    }
+  }
+
+private:
+  const std::size_t size_;
+  std::vector<std::unique_ptr<std::byte[]>> buffers_;
+};
+
+// Decompresses a chunk and hashes the result while it is still in the CPU cache.
+// With a chunk cache, a cached chunk is returned without touching the package. Otherwise the chunk is decompressed
+// into a buffer of its own instead of the output, which is added to the cache once it has been verified.
+inline ice::task<chunk_data> decompress(ice::thread_pool& pool, const format::chunk& chunk, std::span<const std::byte> stored,
+  std::span<std::byte> output, std::unique_ptr<std::byte[]> buffer, bool verify, chunk_cache* cache = nullptr) noexcept {
+  if (cache) {
+    if (auto cached = cache->find(chunk.digest)) {
+      co_return chunk_data{ { cached.get(), chunk.size }, std::move(buffer), std::move(cached), true, true };
+    }
+  }
+  auto owned = cache && verify ? std::make_unique<std::byte[]>(chunk.size) : nullptr;
+  if (owned) {
+    output = { owned.get(), chunk.size };
+  }
+  if (chunk.size >= inline_size) {
+    co_await ice::schedule(pool, true);
+  }
+  auto valid = false;
+  {
+    const ice::trace::span span{ decompress_stage, output.size() };
+    valid = lz4::decompress(stored, output);
+  }
+  if (valid && verify) {
+    const ice::trace::span span{ hash_stage, output.size() };
+    valid = hash(output) == chunk.digest;
+  }
+  if (!owned || !valid) {
+    co_return chunk_data{ output, std::move(buffer), nullptr, valid, false };
+  }
+  chunk_cache::buffer cached = std::move(owned);
+  cache->insert(chunk.digest, cached, chunk.size);
+  co_return chunk_data{ output, std::move(buffer), std::move(cached), true, false };
+}
+
+inline ice::task<chunk_data> stored(ice::thread_pool& pool, const format::chunk& chunk, std::span<const std::byte> data, bool verify) noexcept {
+  auto valid = true;
+  if (verify) {
+    if (chunk.size >= inline_size) {
+      co_await ice::schedule(pool, true);
+    }
+    const ice::trace::span span{ hash_stage, data.size() };
+    valid = hash(data) == chunk.digest;
+  }
+  co_return chunk_data{ data, nullptr, nullptr, valid, false };
+}
+
+// Computes a file digest from contents that arrive in pieces of any size.
+class file_digest {
+public:
+  explicit file_digest(std::size_t chunk_size) noexcept : chunk_size_(chunk_size) {
+  }
+
+  void update(std::span<const std::byte> data) noexcept {
+    while (!data.empty()) {
+      const auto size = std::min(chunk_size_ - size_, data.size());
+      chunk_.update(data.first(size));
+      data = data.subspan(size);
+      size_ += size;
+      if (size_ == chunk_size_) {
+        flush();
+      }
+    }
+  }
+
+  digest finalize() noexcept {
+    if (size_) {
+      flush();
+    }
+    return digests_.finalize();
+  }
+
+private:
+  void flush() noexcept {
+    const auto digest = chunk_.finalize();
+    digests_.update(std::as_bytes(std::span{ digest.bytes }));
+    chunk_ = hasher{};
+    size_ = 0;
+  }
+
+  const std::size_t chunk_size_;
+  std::size_t size_ = 0;
+  hasher chunk_;
+  hasher digests_;
+};
+
+// Applies a delta to the installed previous version of a file and writes the result to another file.
+// Ranges of the previous version are read as they are needed, so the previous version stays in place until the
+// caller replaces it with the result.
+inline ice::task<std::error_code> patch(const package& package, const format::file& entry, const format::delta& delta,
+  const std::filesystem::path& path, const ice::file& file, ice::thread_pool& pool, ice::io_service& service, bool verify) noexcept {
+  std::error_code ec;
+  auto base = ice::file::open(service, path, ice::file_mode::read, ec);
+  if (ec == std::errc::no_such_file_or_directory) {
+    co_return package_errc::base_mismatch;
+  }
+  if (ec) {
+    co_return ec;
+  }
+  if (base.size(ec) != delta.base_size) {
+    co_return ec ? ec : package_errc::base_mismatch;
+  }
+  const auto chunk_size = package.header().chunk_size;
+  const auto buffer = std::make_unique<std::byte[]>(chunk_size);
+  file_digest digest{ chunk_size };
+  std::uint64_t offset = 0;
+  for (const auto& op : package.ops(delta)) {
+    std::span<const std::byte> data;
+    if (op.chunk == format::base) {
+      const auto start = ice::trace::enabled() ? ice::trace::now() : 0;
+      for (std::size_t size = 0; size < op.size;) {
+        const auto result = co_await base.read(op.offset + size, { buffer.get() + size, op.size - size });
+        if (!result || !result.size) {
+          ec = result ? package_errc::base_mismatch : result.error;
+          break;
+        }
+        size += result.size;
+      }
+      data = { buffer.get(), op.size };
+      if (start) {
+        ice::trace::record(read_stage, start, ice::trace::now(), op.size);
+      }
+    } else if (const auto& chunk = package.chunk(op.chunk); chunk.compression == format::compression::none) {
+      auto result = co_await stored(pool, chunk, package.data(chunk), verify);
+      ec = result.valid ? std::error_code{} : package_errc::corrupt_chunk;
+      data = result.data;
+    } else {
+      auto result = co_await decompress(pool, chunk, package.data(chunk), { buffer.get(), chunk.size }, nullptr, verify);
+      ec = result.valid ? std::error_code{} : package_errc::corrupt_chunk;
+      data = result.data;
+    }
+    if (ec) {
+      break;
+    }
+    digest.update(data);
+    while (!data.empty()) {
+      const auto result = co_await file.write(offset, data);
+      if (!result) {
+        ec = result.error;
+        break;
+      }
+      data = data.subspan(result.size);
+      offset += result.size;
+    }
+    if (ec) {
+      break;
+    }
+  }
+  if (!ec && verify && digest.finalize() != entry.digest) {
+    ec = package_errc::base_mismatch;
+  }
+  co_return ec;
+}
+
+}  // namespace detail
+
+// Extracts all files of the package into the target directory.
+// Chunks are decompressed in parallel on the thread pool and written in package order through the io_service.
+// Decompressed chunks count against options.memory until they have been written, which bounds the memory used by
+// the whole pipeline. Writes of many files are in flight at the same time, see detail::file_writer. Stored chunks
+// are written directly from the package mapping. Every chunk is checked against its digest on the thread pool
+// before it is written, and the chunk digests of every file against the file digest. Files with a delta are patched from the installed previous version.
+// With options.journal, files are staged under temporary names and flushed in batches, and replace the installed
+// files only after the install_journal has been committed. An install that was interrupted is recovered first.
+// Otherwise files are written in place, and only patched files are replaced once they are complete.
+// The install state in the target directory is replaced after a successful install. Incremental installs skip
+// files that the state records with the same digest and that were not modified since, including their chunks.
+// Files that the state records but the package does not contain are removed, with options.journal after the
+// commit together with the renames.
+// With options.cache, verified chunks are taken from and added to the cache instead of being decompressed again.
+// With options.progress, the bytes of every chunk are added once they have been written, and every file once it has
+// been finished. The progress is started with the totals of the files that are not skipped and always finished.
+inline ice::task<std::error_code> extract(const package& package, std::filesystem::path target, ice::thread_pool& pool,
+  ice::io_service& service, extract_options options = {}) noexcept {
+  struct pending {
+    ice::task<detail::chunk_data> task;
+    std::size_t size = 0;
+  };
+  const std::unique_ptr<progress, void (*)(progress*)> finish{ options.progress, [](progress* progress) {
+    progress->finish();
+  } };
+  // Removing a file walks up its empty parents until it reaches the target, which must compare equal to them.
+  target = detail::normal_target(target);
+  std::error_code ec;
+  if (options.journal) {
+    install_journal::recover(target, ec);
+    if (ec) {
+      co_return ec;
+    }
+  }
+  const auto files = package.files();
+  const auto chunk_size = package.header().chunk_size;
+  std::vector<char> skip(files.size());
+  install_state state;
+  {
+    std::error_code ignored;
+    state = install_state::load(target, ignored);
+  }
+  if (options.incremental && !state.entries().empty()) {
+    for (std::size_t i = 0; i < files.size(); i++) {
+      const auto name = package.path(files[i]);
+      skip[i] = state.unchanged(name, detail::target_path(target, name), files[i].digest);
+    }
+  }
+
+  // Files of the previous install that are not in the package.
+  std::vector<std::string> removed;
+  if (!state.entries().empty()) {
+    std::vector<std::string_view> names;
+    names.reserve(files.size());
+    for (const auto& file : files) {
+      names.push_back(package.path(file));
+    }
+    std::sort(names.begin(), names.end());
+    for (const auto& entry : state.entries()) {
+      if (!std::binary_search(names.begin(), names.end(), std::string_view{ entry.path })) {
+        removed.push_back(entry.path);
+      }
+    }
+  }
+  // The entries of files that are skipped are never used, so only the others are validated.
+  for (std::size_t i = 0; i < files.size(); i++) {
+    if (!skip[i]) {
+      if (ec = package.validate(files[i]); ec) {
+        co_return ec;
+      }
+    }
+  }
+  if (options.progress) {
+    std::uint64_t total_files = 0;
+    std::uint64_t total_bytes = 0;
+    for (std::size_t i = 0; i < files.size(); i++) {
+      if (!skip[i]) {
+        total_files++;
+        total_bytes += files[i].size;
+      }
+    }
+    options.progress->start(total_files, total_bytes);
+  }
+  std::deque<pending> window;
+  detail::buffer_pool buffers{ chunk_size };
+  std::size_t in_flight = 0;
+  std::size_t next_file = 0;
+  std::size_t next_ref = 0;
+
+  // Starts decompressing the next chunk in package order unless that would exceed the memory budget.
+  const auto start = [&]() {
+    while (next_file < files.size() && (skip[next_file] || next_ref == files[next_file].ref_count)) {
+      next_file++;
+      next_ref = 0;
+    }
+    if (next_file == files.size()) {
+      return false;
+    }
+    const auto& chunk = package.chunk(package.refs(files[next_file])[next_ref]);
+    if (!window.empty() && in_flight + chunk.size > options.memory) {
+      return false;
+    }
+    next_ref++;
+    in_flight += chunk.size;
+    if (chunk.compression == format::compression::none) {
+      window.push_back({ detail::stored(pool, chunk, package.data(chunk), options.verify), chunk.size });
+      return true;
+    }
+    // With a cache, chunks are decompressed into buffers that are shared with the cache instead.
+    auto buffer = std::unique_ptr<std::byte[]>{};
+    if (!options.cache || !options.verify) {
+      buffer = buffers.acquire(chunk.size);
+    }
+    const auto output = std::span{ buffer.get(), buffer ? chunk.size : 0 };
+    window.push_back({ detail::decompress(pool, chunk, package.data(chunk), output, std::move(buffer), options.verify, options.cache), chunk.size });
+    return true;
+  };
+
+  install_journal journal;
+  if (options.journal) {
+    std::vector<std::string> names;
+    for (std::size_t index = 0; index < files.size(); index++) {
+      if (!skip[index]) {
+        names.emplace_back(package.path(files[index]));
+      }
+    }
+    journal = install_journal::begin(target, std::move(names), removed, ec);
+    if (ec) {
+      co_return ec;
+    }
+  }
+
+  // Staged files are flushed in batches before the journal is committed.
+  detail::file_writer writer{ service, pool, target, static_cast<bool>(journal) };
+
+  for (std::size_t index = 0; index < files.size(); index++) {
+    if (skip[index]) {
+      continue;
+    }
+    const auto& entry = files[index];
+    const auto name = package.path(entry);
+    const auto path = detail::target_path(target, name);
+    if (path.empty()) {
+      ec = package_errc::corrupt_index;
+      break;
+    }
+    const auto delta = package.delta(entry);
+    std::string output{ name };
+    if (journal) {
+      output += install_journal::suffix;
+    } else if (delta) {
+      output += ".update";
+    }
+    auto file = writer.create(output, entry.size, ec);
+    if (ec) {
+      break;
+    }
+    if (delta) {
+      writer.submit();
+      ec = co_await detail::patch(package, entry, *delta, path, file, pool, service, options.verify);
+      if (!journal) {
+        file.close();
+        auto update = path;
+        update += ".update";
+        if (ec) {
+          std::error_code ignored;
+          std::filesystem::remove(update, ignored);
+        } else {
+          std::filesystem::rename(update, path, ec);
+        }
+      }
+    } else {
+      std::uint64_t offset = 0;
+      hasher digests;
+      const auto refs = package.refs(entry);
+      for (std::size_t i = 0; i < refs.size(); i++) {
+        while (start()) {
+        }
+        if (!window.front().task.is_ready()) {
+          writer.submit();
+        }
+        auto chunk = co_await std::move(window.front().task);
+        const auto size = window.front().size;
+        window.pop_front();
+        // The buffer returns to the pool and the chunk leaves the memory budget once the write has completed.
+        const std::shared_ptr<const void> owner{ chunk.buffer.release(),
+          [&buffers, &in_flight, progress = options.progress, size, length = chunk.data.size(), cached = std::move(chunk.cached)](std::byte* buffer) {
+            buffers.release(std::unique_ptr<std::byte[]>{ buffer }, length);
+            in_flight -= size;
+            if (progress) {
+              progress->add(length);
+            }
+          } };
+        if (!chunk.valid) {
+          ec = package_errc::corrupt_chunk;
+          break;
+        }
+        digests.update(std::as_bytes(std::span{ package.chunk(refs[i]).digest.bytes }));
+        co_await writer.write(file, offset, chunk.data, owner, i + 1 == refs.size());
+        offset += chunk.data.size();
+      }
+      if (!ec && options.verify && digests.finalize() != entry.digest) {
+        ec = package_errc::corrupt_index;
+      }
+    }
+    if (!ec) {
+      co_await writer.finish(std::move(file));
+      ec = writer.error();
+    }
+    if (!ec && options.progress) {
+      options.progress->add(delta ? entry.size : 0, 1);
+    }
+    if (ec) {
+      // Writes to the file may still be in flight.
+      co_await writer.drain();
+      break;
+    }
+  }
+
+  // Tasks must not be destroyed while they are running.
+  for (auto& pending : window) {
+    co_await pending.task.when_ready();
+  }
+  co_await writer.drain();
+  if (!ec) {
+    ec = writer.error();
+  }
+  if (journal) {
+    const ice::trace::span span{ detail::commit_stage };
+    if (!ec) {
+      journal.commit(ec);
+    }
+    if (!ec) {
+      journal.finish(ec);
+    }
+    if (ec && !journal.committed()) {
+      std::error_code ignored;
+      journal.rollback(ignored);
+    }
+  }
+  if (!ec && !journal) {
+    std::set<std::filesystem::path> changed;
+    for (const auto& name : removed) {
+      if (const auto path = detail::target_path(target, name); !path.empty()) {
+        detail::remove_file(target, path, changed, ec);
+      }
+      if (ec) {
+        break;
+      }
+    }
+  }
+  if (!ec) {
+    install_state installed;
+    for (std::size_t index = 0; index < files.size() && !ec; index++) {
+      const auto name = package.path(files[index]);
+      if (skip[index]) {
+        installed.add(*state.find(name));
+      } else {
+        installed.add(name, detail::target_path(target, name), files[index].digest, ec);
+      }
+    }
+    if (!ec) {
+      installed.save(target, ec);
+    }
+  }
+  co_return ec;
+}
+
+}  // namespace installer
@@ -0,0 +1,339 @@
+#pragma once
+#include <ice/file.hpp>
+#include <ice/io_service.hpp>
+#include <ice/task.hpp>
+#include <ice/thread_pool.hpp>
+#include <ice/trace.hpp>
+#include <installer/path.hpp>
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <unordered_set>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <set>
+#include <unordered_map>
+#include <cerrno>
+#endif
+
+namespace installer::detail {
+
+// Files that are flushed together.
+constexpr std::size_t sync_batch = 128;
+
+// Deferred writes that are started together.
+constexpr std::size_t submit_batch = 32;
+
+// Files of at least this size get their space reserved before they are written.
+constexpr std::uint64_t preallocate_size = 1 << 20;
+
+inline const ice::trace::stage write_stage{ "write" };
+inline const ice::trace::stage sync_stage{ "sync" };
+
+#ifdef _WIN32
+inline ice::task<std::error_code> sync(const ice::file& file) noexcept {
+  const auto start = ice::trace::enabled() ? ice::trace::now() : 0;
+  const auto result = co_await file.sync();
+  if (start) {
+    ice::trace::record(sync_stage, start, ice::trace::now());
+  }
+  co_return result.error;
+}
+#else
+// Flushes all files on the file systems of the given files with one syncfs call per file system.
+// The calls block, so they are made on the thread pool.
+inline ice::task<std::error_code> sync(ice::thread_pool& pool, std::span<const ice::file> files) noexcept {
+  std::set<dev_t> devices;
+  std::vector<int> handles;
+  for (const auto& file : files) {
+    struct stat info = {};
+    if (fstat(file.native_handle(), &info)) {
+      co_return std::error_code{ errno, std::system_category() };
+    }
+    if (devices.insert(info.st_dev).second) {
+      handles.push_back(file.native_handle());
+    }
+  }
+  if (handles.empty()) {
+    co_return std::error_code{};
+  }
+  co_await ice::schedule(pool, true);
+  const ice::trace::span span{ sync_stage };
+  for (const auto handle : handles) {
+    if (syncfs(handle)) {
+      co_return std::error_code{ errno, std::system_category() };
+    }
+  }
+  co_return std::error_code{};
+}
+#endif
+
+// Writes all of the data. The first write is deferred until the io_service submits it.
+inline ice::task<std::error_code> write(ice::io_service& service, ice::io_service::native_handle_type handle, std::uint64_t offset,
+  std::span<const std::byte> data) noexcept {
+  const auto start = ice::trace::enabled() ? ice::trace::now() : 0;
+  const auto size = data.size();
+  for (auto defer = true; !data.empty(); defer = false) {
+    const auto result = co_await ice::file::write_operation{ service, handle, offset, data, defer };
+    if (!result) {
+      co_return result.error;
+    }
+    data = data.subspan(result.size);
+    offset += result.size;
+  }
+  if (start) {
+    ice::trace::record(write_stage, start, ice::trace::now(), size);
+  }
+  co_return std::error_code{};
+}
+
+// Open handles of the directories below a root directory.
+// Files are created relative to the handle of their directory instead of resolving the whole path every time,
+// and missing directories are created when they are first used instead of checking every parent for every file.
+// Packages list files in path order, so a few handles cover runs of files; all handles are closed once there
+// are too many. Windows has no relative create, so there only the created directories are remembered.
+class directory_cache {
+public:
+  static constexpr std::size_t limit = 64;
+
+  explicit directory_cache(std::filesystem::path root) noexcept : root_(std::move(root)) {
+  }
+
+  directory_cache(const directory_cache& other) = delete;
+  directory_cache& operator=(const directory_cache& other) = delete;
+
+  ~directory_cache() {
+    clear();
+#ifndef _WIN32
+    if (root_handle_ != -1) {
+      ::close(root_handle_);
+    }
+#endif
+  }
+
+  // Creates or truncates a file at a relative path with forward slashes.
+  ice::file create(ice::io_service& service, std::string_view path, std::error_code& ec) noexcept {
+    const auto separator = path.rfind('/');
+    const auto directory = separator == std::string_view::npos ? std::string_view{} : path.substr(0, separator);
+#ifdef _WIN32
+    if (!directories_.contains(std::string{ directory })) {
+      std::filesystem::create_directories(root_ / utf8_path(directory), ec);
+      if (ec) {
+        return {};
+      }
+      directories_.emplace(directory);
+    }
+    return ice::file::open(service, root_ / utf8_path(path), ice::file_mode::write, ec);
+#else
+    const auto parent = open(directory, ec);
+    if (ec) {
+      return {};
+    }
+    const std::string name{ separator == std::string_view::npos ? path : path.substr(separator + 1) };
+    const auto handle = ::openat(parent, name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (handle == -1) {
+      ec = { errno, std::system_category() };
+      return {};
+    }
+    return ice::file::attach(service, handle, ec);
+#endif
+  }
+
+  void clear() noexcept {
+#ifdef _WIN32
+    directories_.clear();
+#else
+    for (const auto& [path, handle] : directories_) {
+      ::close(handle);
+    }
+    directories_.clear();
+#endif
+  }
+
+private:
+#ifndef _WIN32
+  // Returns the handle of a directory below the root and creates it if it does not exist.
+  int open(std::string_view directory, std::error_code& ec) noexcept {
+    if (directory.empty()) {
+      if (root_handle_ == -1) {
+        std::filesystem::create_directories(root_, ec);
+        if (ec) {
+          return -1;
+        }
+        root_handle_ = ::open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (root_handle_ == -1) {
+          ec = { errno, std::system_category() };
+        }
+      }
+      return root_handle_;
+    }
+    std::string key{ directory };
+    if (const auto it = directories_.find(key); it != directories_.end()) {
+      return it->second;
+    }
+    const auto separator = directory.rfind('/');
+    const auto parent = open(separator == std::string_view::npos ? std::string_view{} : directory.substr(0, separator), ec);
+    if (ec) {
+      return -1;
+    }
+    const auto name = separator == std::string_view::npos ? key : key.substr(separator + 1);
+    auto handle = ::openat(parent, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (handle == -1 && errno == ENOENT) {
+      if (::mkdirat(parent, name.c_str(), 0755) && errno != EEXIST) {
+        ec = { errno, std::system_category() };
+        return -1;
+      }
+      handle = ::openat(parent, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (handle == -1) {
+      ec = { errno, std::system_category() };
+      return -1;
+    }
+    if (directories_.size() == limit) {
+      clear();
+    }
+    directories_.emplace(std::move(key), handle);
+    return handle;
+  }
+#endif
+
+  const std::filesystem::path root_;
+#ifdef _WIN32
+  std::unordered_set<std::string> directories_;
+#else
+  std::unordered_map<std::string, int> directories_;
+  int root_handle_ = -1;
+#endif
+};
+
+// Writes files below a root directory through an io_service.
+// Writes of many files are in flight at the same time, up to the window size. Small writes are deferred and
+// started together, which takes one system call for a batch of writes instead of one per write. A file is
+// closed as soon as its last write has completed, or, when syncing, kept open until it is flushed together with
+// the next batch of files. On Linux a batch is flushed with one syncfs per file system instead of one fdatasync
+// per file, which also flushes unrelated data on the same file system but costs one device flush per batch.
+// Windows has no such call without administrator rights, so there the files of a batch are flushed concurrently.
+class file_writer {
+public:
+  file_writer(ice::io_service& service, ice::thread_pool& pool, std::filesystem::path root, bool sync, std::size_t window = 64) noexcept :
+    service_(service), pool_(pool), directories_(std::move(root)), sync_(sync), window_(std::max<std::size_t>(window, 1)) {
+  }
+
+  // Returns the first error of any write or flush.
+  const std::error_code& error() const noexcept {
+    return ec_;
+  }
+
+  // Creates a file at a relative path with forward slashes and reserves space for large files.
+  ice::file create(std::string_view path, std::uint64_t size, std::error_code& ec) noexcept {
+    auto file = directories_.create(service_, path, ec);
+    if (!ec && size >= preallocate_size) {
+      file.allocate(size, ec);
+    }
+    return file;
+  }
+
+  // Starts a write and waits only while the window is full. The owner is kept alive until the write has
+  // completed. The last write of a file takes over the file.
+  ice::task<void> write(ice::file& file, std::uint64_t offset, std::span<const std::byte> data, std::shared_ptr<const void> owner, bool last) noexcept {
+    while (queue_.size() >= window_) {
+      co_await complete();
+    }
+    queue_.push_back({ detail::write(service_, file.native_handle(), offset, data), std::move(owner), last ? std::move(file) : ice::file{} });
+    if (++deferred_ == submit_batch) {
+      submit();
+    }
+  }
+
+  // Takes over a file that was written without the writer and closes or flushes it like the others.
+  ice::task<void> finish(ice::file file) noexcept {
+    if (sync_ && file.is_open()) {
+      unsynced_.push_back(std::move(file));
+      if (unsynced_.size() == sync_batch) {
+        co_await flush();
+      }
+    }
+  }
+
+  // Starts all deferred writes. Must be called before waiting for anything that the writes may depend on.
+  void submit() noexcept {
+    if (deferred_) {
+      service_.submit();
+      deferred_ = 0;
+    }
+  }
+
+  // Waits for all writes and flushes the files that were not flushed yet.
+  ice::task<void> drain() noexcept {
+    while (!queue_.empty()) {
+      co_await complete();
+    }
+    co_await flush();
+  }
+
+private:
+  struct pending {
+    ice::task<std::error_code> task;
+    std::shared_ptr<const void> owner;
+    ice::file file;
+  };
+
+  ice::task<void> complete() noexcept {
+    submit();
+    auto front = std::move(queue_.front());
+    queue_.pop_front();
+    if (const auto ec = co_await std::move(front.task); ec && !ec_) {
+      ec_ = ec;
+    }
+    if (front.file.is_open()) {
+      co_await finish(std::move(front.file));
+    }
+  }
+
+  // Flushes all files that are kept open.
+  ice::task<void> flush() noexcept {
+    submit();
+#ifdef _WIN32
+    std::vector<ice::task<std::error_code>> syncs;
+    syncs.reserve(unsynced_.size());
+    for (const auto& file : unsynced_) {
+      syncs.push_back(detail::sync(file));
+    }
+    for (auto& sync : syncs) {
+      if (const auto ec = co_await std::move(sync); ec && !ec_) {
+        ec_ = ec;
+      }
+    }
+#else
+    if (const auto ec = co_await detail::sync(pool_, unsynced_); ec && !ec_) {
+      ec_ = ec;
+    }
+#endif
+    unsynced_.clear();
+  }
+
+  ice::io_service& service_;
+  ice::thread_pool& pool_;
+  directory_cache directories_;
+  const bool sync_;
+  const std::size_t window_;
+  std::deque<pending> queue_;
+  std::vector<ice::file> unsynced_;
+  std::size_t deferred_ = 0;
+  std::error_code ec_;
+};
+
+}  // namespace installer::detail
@@ -0,0 +1,193 @@
+#pragma once
+#include <installer/blake3.hpp>
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <span>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace installer {
+
+// BLAKE3 digest.
+struct digest {
+  static constexpr std::size_t size = 32;
+
+  std::array<std::uint8_t, size> bytes = {};
+
+  friend auto operator<=>(const digest& lhs, const digest& rhs) noexcept = default;
+
+  std::string to_string() const {
+    constexpr std::string_view hex = "0123456789abcdef";
+    std::string str;
+    str.reserve(size * 2);
+    for (const auto byte : bytes) {
+      str.push_back(hex[byte >> 4]);
+      str.push_back(hex[byte & 0xF]);
+    }
+    return str;
+  }
+};
+
+struct digest_hash {
+  std::size_t operator()(const digest& value) const noexcept {
+    std::size_t hash = 0;
+    std::memcpy(&hash, value.bytes.data(), sizeof(hash));
+    return hash;
+  }
+};
+
+// Incremental BLAKE3 hasher.
+// Whole chunks that are followed by more input are hashed several at a time with the SIMD kernel of the CPU.
+class hasher {
+public:
+  using kernel = blake3::kernel;
+
+  explicit hasher(kernel kernel = blake3::best()) noexcept : kernel_(kernel), lanes_(blake3::lanes(kernel)) {
+  }
+
+  void update(std::span<const std::byte> data) noexcept {
+    auto input = reinterpret_cast<const std::uint8_t*>(data.data());
+    auto size = data.size();
+    while (size) {
+      if (chunk_.size() == blake3::chunk_size) {
+        const auto cv = chunk_.finish().chaining_value();
+        const auto chunks = chunk_.counter + 1;
+        push(cv, chunks);
+        chunk_ = chunk_state{ chunks };
+      }
+      // The last chunk may be the root, so a batch must leave some input behind.
+      if (lanes_ > 1 && !chunk_.size()) {
+        while (size > lanes_ * blake3::chunk_size) {
+          blake3::words cvs[8];
+          blake3::hash_chunks(kernel_, input, chunk_.counter, cvs);
+          for (std::size_t i = 0; i < lanes_; i++) {
+            push(cvs[i], chunk_.counter + i + 1);
+          }
+          chunk_ = chunk_state{ chunk_.counter + lanes_ };
+          input += lanes_ * blake3::chunk_size;
+          size -= lanes_ * blake3::chunk_size;
+        }
+      }
+      const auto count = std::min(blake3::chunk_size - chunk_.size(), size);
+      chunk_.update(input, count);
+      input += count;
+      size -= count;
+    }
+  }
+
+  digest finalize() const noexcept {
+    auto out = chunk_.finish();
+    for (auto i = stack_size_; i > 0; i--) {
+      out = parent(stack_[i - 1], out.chaining_value());
+    }
+    return out.root();
+  }
+
+private:
+  using words = blake3::words;
+
+  struct output {
+    words cv;
+    std::uint32_t block[16];
+    std::uint64_t counter;
+    std::uint32_t size;
+    std::uint32_t flags;
+
+    words chaining_value() const noexcept {
+      const auto s = blake3::compress(cv, block, counter, size, flags);
+      words value;
+      std::copy_n(s.begin(), 8, value.begin());
+      return value;
+    }
+
+    digest root() const noexcept {
+      const auto s = blake3::compress(cv, block, 0, size, flags | blake3::root_node);
+      digest value;
+      for (std::size_t i = 0; i < 8; i++) {
+        value.bytes[i * 4 + 0] = static_cast<std::uint8_t>(s[i]);
+        value.bytes[i * 4 + 1] = static_cast<std::uint8_t>(s[i] >> 8);
+        value.bytes[i * 4 + 2] = static_cast<std::uint8_t>(s[i] >> 16);
+        value.bytes[i * 4 + 3] = static_cast<std::uint8_t>(s[i] >> 24);
+      }
+      return value;
+    }
+  };
+
+  struct chunk_state {
+    explicit chunk_state(std::uint64_t counter = 0) noexcept : counter(counter) {
+    }
+
+    std::size_t size() const noexcept {
+      return blake3::block_size * blocks + buffer_size;
+    }
+
+    std::uint32_t start() const noexcept {
+      return blocks ? 0 : blake3::chunk_start;
+    }
+
+    void update(const std::uint8_t* data, std::size_t size) noexcept {
+      while (size) {
+        if (buffer_size == blake3::block_size) {
+          std::uint32_t block[16];
+          blake3::load(block, buffer, blake3::block_size);
+          const auto s = blake3::compress(cv, block, counter, blake3::block_size, start());
+          std::copy_n(s.begin(), 8, cv.begin());
+          blocks++;
+          buffer_size = 0;
+        }
+        const auto count = std::min(blake3::block_size - buffer_size, size);
+        std::memcpy(buffer + buffer_size, data, count);
+        buffer_size += count;
+        data += count;
+        size -= count;
+      }
+    }
+
+    output finish() const noexcept {
+      output out = { cv, {}, counter, static_cast<std::uint32_t>(buffer_size), start() | blake3::chunk_end };
+      blake3::load(out.block, buffer, buffer_size);
+      return out;
+    }
+
+    words cv = blake3::iv;
+    std::uint64_t counter = 0;
+    std::uint8_t buffer[blake3::block_size] = {};
+    std::size_t buffer_size = 0;
+    std::size_t blocks = 0;
+  };
+
+  static output parent(const words& left, const words& right) noexcept {
+    output out = { blake3::iv, {}, 0, blake3::block_size, blake3::parent_node };
+    std::copy(left.begin(), left.end(), out.block);
+    std::copy(right.begin(), right.end(), out.block + 8);
+    return out;
+  }
+
+  // Merges completed subtrees. The number of trailing zero bits in the chunk count is the number of subtrees
+  // that are complete once the new chunk is added.
+  void push(words cv, std::uint64_t chunks) noexcept {
+    while (!(chunks & 1)) {
+      cv = parent(stack_[--stack_size_], cv).chaining_value();
+      chunks >>= 1;
+    }
+    stack_[stack_size_++] = cv;
+  }
+
+  kernel kernel_;
+  std::size_t lanes_;
+  chunk_state chunk_;
+  words stack_[54];
+  std::size_t stack_size_ = 0;
+};
+
+inline digest hash(std::span<const std::byte> data, hasher::kernel kernel = blake3::best()) noexcept {
+  hasher hasher{ kernel };
+  hasher.update(data);
+  return hasher.finalize();
+}
+
+}  // namespace installer
@@ -0,0 +1,179 @@
+#pragma once
+#include <installer/hash.hpp>
+#include <installer/mapping.hpp>
+#include <installer/package.hpp>
+#include <installer/stdio_file.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace installer {
+
+// Record of the files that the last install wrote into a target directory.
+// A file is unchanged if its size and modification time still match the record, and its recorded digest tells
+// whether the package has a different version of it. The state is stored in the target directory as a header,
+// a table of fixed-size entries sorted by path and the path strings.
+class install_state {
+public:
+  static constexpr std::string_view filename = ".install-state";
+
+  struct entry {
+    std::string path;
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;  // std::filesystem::file_time_type ticks
+    installer::digest digest;
+  };
+
+  // Loads the state of a target directory. Returns an empty state if there is none or it cannot be read.
+  static install_state load(const std::filesystem::path& target, std::error_code& ec) noexcept {
+    install_state state;
+    const auto mapping = mapping::open(target / filename, ec);
+    if (ec) {
+      return state;
+    }
+    const auto data = mapping.span();
+    if (data.size() < sizeof(header)) {
+      ec = package_errc::corrupt_index;
+      return state;
+    }
+    const auto& header = *reinterpret_cast<const install_state::header*>(data.data());
+    const auto table = sizeof(header);
+    const auto strings = table + header.count * sizeof(record);
+    if (header.magic != magic || header.version != version || header.count > (data.size() - table) / sizeof(record) ||
+      header.strings_size > data.size() - strings) {
+      ec = package_errc::corrupt_index;
+      return state;
+    }
+    const auto records = reinterpret_cast<const record*>(data.data() + table);
+    const auto text = reinterpret_cast<const char*>(data.data() + strings);
+    state.entries_.reserve(static_cast<std::size_t>(header.count));
+    for (std::size_t i = 0; i < header.count; i++) {
+      const auto& record = records[i];
+      if (record.path_offset > header.strings_size || record.path_size > header.strings_size - record.path_offset) {
+        ec = package_errc::corrupt_index;
+        state.entries_.clear();
+        return state;
+      }
+      state.entries_.push_back({ { text + record.path_offset, record.path_size }, record.size, record.mtime, record.digest });
+    }
+    std::sort(state.entries_.begin(), state.entries_.end(), [](const entry& lhs, const entry& rhs) { return lhs.path < rhs.path; });
+    return state;
+  }
+
+  // Writes the state into the target directory, replacing the previous state atomically.
+  void save(const std::filesystem::path& target, std::error_code& ec) const noexcept {
+    header header = { magic, version, entries_.size(), 0 };
+    std::vector<record> records;
+    std::string strings;
+    records.reserve(entries_.size());
+    for (const auto& entry : entries_) {
+      records.push_back({ entry.digest, strings.size(), static_cast<std::uint32_t>(entry.path.size()), 0, entry.size, entry.mtime });
+      strings.append(entry.path);
+    }
+    header.strings_size = strings.size();
+    const auto path = target / filename;
+    auto temp = path;
+    temp += ".tmp";
+    {
+      detail::stdio_file file{ temp, "wb", ec };
+      if (ec) {
+        return;
+      }
+      file.write(std::as_bytes(std::span{ &header, 1 }), ec);
+      file.write(std::as_bytes(std::span{ records }), ec);
+      file.write(std::as_bytes(std::span{ strings }), ec);
+      file.close(ec);
+    }
+    if (!ec) {
+      std::filesystem::rename(temp, path, ec);
+    }
+    if (ec) {
+      std::error_code ignored;
+      std::filesystem::remove(temp, ignored);
+    }
+  }
+
+  const entry* find(std::string_view path) const noexcept {
+    const auto it = std::lower_bound(entries_.begin(), entries_.end(), path, [](const entry& entry, std::string_view path) {
+      return entry.path < path;
+    });
+    if (it == entries_.end() || it->path != path) {
+      return nullptr;
+    }
+    return &*it;
+  }
+
+  // Returns true if the file is recorded with this digest and was not modified since it was recorded.
+  bool unchanged(std::string_view name, const std::filesystem::path& path, const digest& digest) const noexcept {
+    const auto entry = find(name);
+    if (!entry || entry->digest != digest) {
+      return false;
+    }
+    std::error_code ec;
+    const std::filesystem::directory_entry file{ path, ec };
+    if (ec || file.file_size(ec) != entry->size || ec) {
+      return false;
+    }
+    const auto mtime = file.last_write_time(ec);
+    return !ec && mtime.time_since_epoch().count() == entry->mtime;
+  }
+
+  // Records the current size and modification time of an installed file. Entries must be added in path order.
+  void add(std::string_view name, const std::filesystem::path& path, const digest& digest, std::error_code& ec) {
+    const std::filesystem::directory_entry file{ path, ec };
+    if (ec) {
+      return;
+    }
+    entry entry{ std::string{ name }, 0, 0, digest };
+    entry.size = file.file_size(ec);
+    if (!ec) {
+      entry.mtime = file.last_write_time(ec).time_since_epoch().count();
+    }
+    if (!ec) {
+      entries_.push_back(std::move(entry));
+    }
+  }
+
+  // Keeps an entry of a previous state for a file that was skipped.
+  void add(const entry& entry) {
+    entries_.push_back(entry);
+  }
+
+  std::span<const entry> entries() const noexcept {
+    return entries_;
+  }
+
+private:
+  static constexpr std::uint32_t magic = 0x54534349;  // ICST
+  static constexpr std::uint32_t version = 1;
+
+  struct header {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t count;
+    std::uint64_t strings_size;
+  };
+
+  struct record {
+    installer::digest digest;
+    std::uint64_t path_offset;
+    std::uint32_t path_size;
+    std::uint32_t reserved;
+    std::uint64_t size;
+    std::int64_t mtime;
+  };
+
+  static_assert(sizeof(header) == 24 && std::is_trivially_copyable_v<header>);
+  static_assert(sizeof(record) == 64 && std::is_trivially_copyable_v<record>);
+
+  std::vector<entry> entries_;
+};
+
+}  // namespace installer
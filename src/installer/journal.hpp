@@ -0,0 +1,335 @@
+#pragma once
+#include <installer/mapping.hpp>
+#include <installer/package.hpp>
+#include <installer/path.hpp>
+#include <installer/stdio_file.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace installer {
+namespace detail {
+
+// Flushes a file or directory that is not open to the device.
+// Windows journals directory changes and cannot open directories for flushing, so directories are skipped there.
+inline void sync_path(const std::filesystem::path& path, bool directory, std::error_code& ec) noexcept {
+#ifdef _WIN32
+  if (directory) {
+    return;
+  }
+  const auto file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    ec = { static_cast<int>(GetLastError()), std::system_category() };
+    return;
+  }
+  if (!FlushFileBuffers(file)) {
+    ec = { static_cast<int>(GetLastError()), std::system_category() };
+  }
+  CloseHandle(file);
+#else
+  const auto file = ::open(path.c_str(), (directory ? O_RDONLY | O_DIRECTORY : O_WRONLY) | O_CLOEXEC);
+  if (file == -1) {
+    ec = { errno, std::system_category() };
+    return;
+  }
+  if (fsync(file)) {
+    ec = { errno, std::system_category() };
+  }
+  ::close(file);
+#endif
+}
+
+// Removes an installed file and the directories below the target that are empty afterwards. The target must be
+// in the form that normal_target() returns. Adds the directories that were changed to the set. A file that does
+// not exist is not an error.
+inline void remove_file(const std::filesystem::path& target, const std::filesystem::path& path, std::set<std::filesystem::path>& changed,
+  std::error_code& ec) noexcept {
+  if (!std::filesystem::remove(path, ec) || ec) {
+    return;
+  }
+  auto directory = path.parent_path();
+  for (std::error_code ignored; directory != target && std::filesystem::remove(directory, ignored);) {
+    directory = directory.parent_path();
+  }
+  changed.insert(std::move(directory));
+}
+
+}  // namespace detail
+
+// Write-ahead journal of an install into a target directory.
+// The journal lists the files of the install before any of them is written. Files are staged next to their
+// final path under a temporary name and flushed, then the journal is marked as committed, and only then are the
+// staged files renamed over their final paths. Every directory that was changed is flushed once after all
+// renames instead of once per file. Files that the install removes are listed as well and removed together with
+// the renames. An install that was interrupted before the commit is rolled back by removing its staged files, one
+// that was interrupted after the commit is rolled forward by finishing the renames and removals.
+class install_journal {
+public:
+  static constexpr std::string_view filename = ".install-journal";
+  static constexpr std::string_view suffix = ".staged";
+
+  install_journal() noexcept = default;
+
+  // Writes and flushes a journal that lists the package paths that are installed and the ones that are removed.
+  static install_journal begin(const std::filesystem::path& target, std::vector<std::string> names, std::vector<std::string> removed,
+    std::error_code& ec) noexcept {
+    install_journal journal;
+    journal.target_ = detail::normal_target(target);
+    journal.names_ = std::move(names);
+    journal.removed_ = std::move(removed);
+    std::filesystem::create_directories(target, ec);
+    if (ec) {
+      return journal;
+    }
+    std::string strings;
+    for (const auto& names : { &journal.names_, &journal.removed_ }) {
+      for (const auto& name : *names) {
+        strings.append(name);
+        strings.push_back('\0');
+      }
+    }
+    const header header = { magic, version, static_cast<std::uint32_t>(state::staging), static_cast<std::uint32_t>(journal.removed_.size()),
+      journal.names_.size(), strings.size() };
+    const auto path = target / filename;
+    {
+      detail::stdio_file file{ path, "wb", ec };
+      if (ec) {
+        return journal;
+      }
+      file.write(std::as_bytes(std::span{ &header, 1 }), ec);
+      file.write(std::as_bytes(std::span{ strings }), ec);
+      file.close(ec);
+    }
+    if (!ec) {
+      detail::sync_path(path, false, ec);
+    }
+    if (!ec) {
+      detail::sync_path(target, true, ec);
+    }
+    return journal;
+  }
+
+  // Finishes or rolls back an install that was interrupted. Does nothing if there is no journal.
+  static void recover(const std::filesystem::path& target, std::error_code& ec) noexcept {
+    auto journal = load(target, ec);
+    if (ec == std::errc::no_such_file_or_directory) {
+      ec.clear();
+      return;
+    }
+    if (ec == package_errc::corrupt_index) {
+      // A journal is flushed before any file is staged, so there is nothing to roll back if it is incomplete.
+      ec.clear();
+      journal.remove(ec);
+      return;
+    }
+    if (ec) {
+      return;
+    }
+    if (journal.committed_) {
+      journal.finish(ec);
+    } else {
+      journal.rollback(ec);
+    }
+  }
+
+  explicit operator bool() const noexcept {
+    return !target_.empty();
+  }
+
+  bool committed() const noexcept {
+    return committed_;
+  }
+
+  // Returns the temporary path that a file is staged under, or an empty path for an invalid package path.
+  std::filesystem::path staged(std::string_view name) const {
+    auto path = detail::target_path(target_, name);
+    if (!path.empty()) {
+      path += suffix;
+    }
+    return path;
+  }
+
+  // Marks the journal as committed. All staged files must have been flushed.
+  // The directories that contain staged files are flushed first, together with every directory between them and
+  // the target, so that the entries of the staged files and of directories created for them cannot be lost once
+  // the journal says that the install is committed. Each directory is flushed once.
+  void commit(std::error_code& ec) noexcept {
+    std::set<std::filesystem::path> directories{ target_ };
+    for (const auto& name : names_) {
+      const auto path = staged(name);
+      if (path.empty()) {
+        continue;
+      }
+      for (auto directory = path.parent_path(); directory != target_ && directories.insert(directory).second;) {
+        directory = directory.parent_path();
+      }
+    }
+    for (const auto& directory : directories) {
+      detail::sync_path(directory, true, ec);
+      if (ec) {
+        return;
+      }
+    }
+    const auto path = target_ / filename;
+    {
+      detail::stdio_file file{ path, "r+b", ec };
+      if (ec) {
+        return;
+      }
+      const auto value = static_cast<std::uint32_t>(state::committed);
+      file.seek(offsetof(header, state), ec);
+      file.write(std::as_bytes(std::span{ &value, 1 }), ec);
+      file.close(ec);
+    }
+    if (!ec) {
+      detail::sync_path(path, false, ec);
+    }
+    committed_ = !ec;
+  }
+
+  // Renames all staged files over their final paths, removes the files that the install removes, flushes the
+  // directories that contain them and the target directory, and removes the journal. Files that were already
+  // renamed or removed by an earlier attempt are skipped. A file that is neither staged nor at its final path was
+  // lost, and the journal is kept.
+  void finish(std::error_code& ec) noexcept {
+    std::set<std::filesystem::path> directories{ target_ };
+    for (const auto& name : names_) {
+      const auto path = detail::target_path(target_, name);
+      if (path.empty()) {
+        continue;
+      }
+      auto staged = path;
+      staged += suffix;
+      std::filesystem::rename(staged, path, ec);
+      if (ec == std::errc::no_such_file_or_directory) {
+        std::error_code status;
+        if (std::filesystem::exists(path, status)) {
+          ec.clear();
+          continue;
+        }
+        return;
+      }
+      if (ec) {
+        return;
+      }
+      if (auto directory = path.parent_path(); !directory.empty()) {
+        directories.insert(std::move(directory));
+      }
+    }
+    for (const auto& name : removed_) {
+      if (const auto path = detail::target_path(target_, name); !path.empty()) {
+        detail::remove_file(target_, path, directories, ec);
+        if (ec) {
+          return;
+        }
+      }
+    }
+    for (const auto& directory : directories) {
+      if (directory.empty()) {
+        continue;
+      }
+      detail::sync_path(directory, true, ec);
+      if (ec) {
+        return;
+      }
+    }
+    remove(ec);
+  }
+
+  // Removes all staged files and the journal.
+  void rollback(std::error_code& ec) noexcept {
+    for (const auto& name : names_) {
+      if (const auto path = staged(name); !path.empty()) {
+        std::filesystem::remove(path, ec);
+        if (ec) {
+          return;
+        }
+      }
+    }
+    remove(ec);
+  }
+
+private:
+  static constexpr std::uint32_t magic = 0x4E524A49;  // IJRN
+  static constexpr std::uint32_t version = 1;
+
+  enum class state : std::uint32_t {
+    staging = 1,
+    committed = 2,
+  };
+
+  struct header {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t state;
+    std::uint32_t removed;  // paths after the installed ones that are removed
+    std::uint64_t count;
+    std::uint64_t strings_size;
+  };
+
+  static_assert(sizeof(header) == 32 && std::is_trivially_copyable_v<header>);
+
+  static install_journal load(const std::filesystem::path& target, std::error_code& ec) noexcept {
+    install_journal journal;
+    journal.target_ = detail::normal_target(target);
+    const auto mapping = mapping::open(target / filename, ec);
+    if (ec) {
+      return journal;
+    }
+    const auto data = mapping.span();
+    if (data.size() < sizeof(header)) {
+      ec = package_errc::corrupt_index;
+      return journal;
+    }
+    const auto& header = *reinterpret_cast<const install_journal::header*>(data.data());
+    if (header.magic != magic || header.version != version || header.strings_size != data.size() - sizeof(header) ||
+      (header.state != static_cast<std::uint32_t>(state::staging) && header.state != static_cast<std::uint32_t>(state::committed))) {
+      ec = package_errc::corrupt_index;
+      return journal;
+    }
+    std::string_view strings{ reinterpret_cast<const char*>(data.data() + sizeof(header)), static_cast<std::size_t>(header.strings_size) };
+    for (std::uint64_t i = 0; i < header.count + header.removed; i++) {
+      const auto end = strings.find('\0');
+      if (end == std::string_view::npos) {
+        ec = package_errc::corrupt_index;
+        return journal;
+      }
+      (i < header.count ? journal.names_ : journal.removed_).emplace_back(strings.substr(0, end));
+      strings.remove_prefix(end + 1);
+    }
+    journal.committed_ = header.state == static_cast<std::uint32_t>(state::committed);
+    return journal;
+  }
+
+  void remove(std::error_code& ec) noexcept {
+    std::filesystem::remove(target_ / filename, ec);
+    if (!ec) {
+      detail::sync_path(target_, true, ec);
+    }
+    if (!ec) {
+      target_.clear();
+    }
+  }
+
+  std::filesystem::path target_;
+  std::vector<std::string> names_;
+  std::vector<std::string> removed_;
+  bool committed_ = false;
+};
+
+}  // namespace installer
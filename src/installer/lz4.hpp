@@ -0,0 +1,187 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace installer::lz4 {
+
+// LZ4 block format codec.
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+
+constexpr std::size_t min_match = 4;
+constexpr std::size_t last_literals = 5;  // the last bytes of a block are always literals
+constexpr std::size_t match_limit = 12;   // the last match must start this many bytes before the end
+constexpr std::size_t max_offset = 65535;
+
+constexpr std::size_t bound(std::size_t size) noexcept {
+  return size + size / 255 + 16;
+}
+
+namespace detail {
+
+inline std::uint32_t load32(const std::uint8_t* data) noexcept {
+  std::uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// Copies size bytes rounded up to the next multiple of 16. Both buffers must have room for the extra bytes.
+inline void copy(std::uint8_t* dst, const std::uint8_t* src, std::size_t size) noexcept {
+  const auto end = dst + size;
+  do {
+    std::memcpy(dst, src, 16);
+    dst += 16;
+    src += 16;
+  } while (dst < end);
+}
+
+constexpr std::uint32_t hash(std::uint32_t value) noexcept {
+  return (value * 2654435761u) >> 20;
+}
+
+}  // namespace detail
+
+// Compresses src into dst and returns the compressed size.
+// Returns 0 if the compressed data does not fit into dst. Passing a dst that is smaller than src therefore only
+// compresses data that actually shrinks.
+inline std::size_t compress(std::span<const std::byte> src, std::span<std::byte> dst) noexcept {
+  const auto in = reinterpret_cast<const std::uint8_t*>(src.data());
+  const auto size = src.size();
+  auto out = reinterpret_cast<std::uint8_t*>(dst.data());
+  const auto out_end = out + dst.size();
+  const auto out_begin = out;
+
+  const auto emit = [&](std::size_t anchor, std::size_t literals, std::size_t offset, std::size_t match) {
+    const auto extra = [&](std::size_t length) {
+      for (; length >= 255; length -= 255) {
+        *out++ = 255;
+      }
+      *out++ = static_cast<std::uint8_t>(length);
+    };
+    if (static_cast<std::size_t>(out_end - out) < 1 + literals + literals / 255 + 1 + 2 + match / 255 + 1) {
+      return false;
+    }
+    const auto token = out++;
+    *token = static_cast<std::uint8_t>(std::min<std::size_t>(literals, 15) << 4);
+    if (literals >= 15) {
+      extra(literals - 15);
+    }
+    if (literals) {
+      std::memcpy(out, in + anchor, literals);
+      out += literals;
+    }
+    if (offset) {
+      *out++ = static_cast<std::uint8_t>(offset);
+      *out++ = static_cast<std::uint8_t>(offset >> 8);
+      match -= min_match;
+      *token |= static_cast<std::uint8_t>(std::min<std::size_t>(match, 15));
+      if (match >= 15) {
+        extra(match - 15);
+      }
+    }
+    return true;
+  };
+
+  std::size_t anchor = 0;
+  if (size > match_limit) {
+    // Positions are stored off by one, so that zero marks an empty slot.
+    const auto table = std::make_unique<std::uint32_t[]>(std::size_t(1) << 12);
+    std::size_t ip = 0;
+    while (ip < size - match_limit) {
+      const auto sequence = detail::load32(in + ip);
+      auto& slot = table[detail::hash(sequence)];
+      const auto candidate = static_cast<std::size_t>(slot);
+      slot = static_cast<std::uint32_t>(ip + 1);
+      if (candidate && ip - (candidate - 1) <= max_offset && detail::load32(in + candidate - 1) == sequence) {
+        const auto ref = candidate - 1;
+        auto length = min_match;
+        while (ip + length < size - last_literals && in[ref + length] == in[ip + length]) {
+          length++;
+        }
+        if (!emit(anchor, ip - anchor, ip - ref, length)) {
+          return 0;
+        }
+        ip += length;
+        anchor = ip;
+        continue;
+      }
+      ip += 1 + ((ip - anchor) >> 6);
+    }
+  }
+  if (!emit(anchor, size - anchor, 0, 0)) {
+    return 0;
+  }
+  return static_cast<std::size_t>(out - out_begin);
+}
+
+// Decompresses src into dst. Returns false if src is malformed or does not decompress to exactly dst.size() bytes.
+inline bool decompress(std::span<const std::byte> src, std::span<std::byte> dst) noexcept {
+  auto in = reinterpret_cast<const std::uint8_t*>(src.data());
+  const auto in_end = in + src.size();
+  auto out = reinterpret_cast<std::uint8_t*>(dst.data());
+  const auto out_begin = out;
+  const auto out_end = out + dst.size();
+
+  const auto length = [&](std::size_t value) {
+    if (value == 15) {
+      std::uint8_t byte = 255;
+      while (byte == 255) {
+        if (in == in_end) {
+          return SIZE_MAX;
+        }
+        byte = *in++;
+        value += byte;
+      }
+    }
+    return value;
+  };
+
+  while (in < in_end) {
+    const auto token = *in++;
+    const auto literals = length(token >> 4);
+    if (literals > static_cast<std::size_t>(in_end - in) || literals > static_cast<std::size_t>(out_end - out)) {
+      return false;
+    }
+    // Copies in fixed 16 byte steps while there is enough slack, so that short copies compile to a few moves.
+    if (static_cast<std::size_t>(in_end - in) >= literals + 16 && static_cast<std::size_t>(out_end - out) >= literals + 16) {
+      detail::copy(out, in, literals);
+    } else if (literals) {
+      std::memcpy(out, in, literals);
+    }
+    in += literals;
+    out += literals;
+    if (in == in_end) {
+      break;
+    }
+    if (in_end - in < 2) {
+      return false;
+    }
+    const auto offset = static_cast<std::size_t>(in[0]) | static_cast<std::size_t>(in[1]) << 8;
+    in += 2;
+    auto match = length(token & 15);
+    if (match == SIZE_MAX) {
+      return false;
+    }
+    match += min_match;
+    if (!offset || offset > static_cast<std::size_t>(out - out_begin) || match > static_cast<std::size_t>(out_end - out)) {
+      return false;
+    }
+    const auto ref = out - offset;
+    if (offset >= 16 && static_cast<std::size_t>(out_end - out) >= match + 16) {
+      detail::copy(out, ref, match);
+    } else if (offset >= match) {
+      std::memcpy(out, ref, match);
+    } else {
+      for (std::size_t i = 0; i < match; i++) {
+        out[i] = ref[i];
+      }
+    }
+    out += match;
+  }
+  return out == out_end;
+}
+
+}  // namespace installer::lz4
@@ -0,0 +1,137 @@
+#pragma once
+#include <filesystem>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace installer {
+
+// Read-only memory mapping of a whole file.
+class mapping {
+public:
+  mapping() noexcept = default;
+
+  mapping(mapping&& other) noexcept :
+    data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {
+  }
+
+  mapping(const mapping& other) = delete;
+
+  mapping& operator=(mapping&& other) noexcept {
+    if (this != &other) {
+      close();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+
+  mapping& operator=(const mapping& other) = delete;
+
+  ~mapping() {
+    close();
+  }
+
+  static mapping open(const std::filesystem::path& path, std::error_code& ec) noexcept {
+    mapping mapping;
+#ifdef _WIN32
+    const auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      ec = { static_cast<int>(GetLastError()), std::system_category() };
+      return mapping;
+    }
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size)) {
+      ec = { static_cast<int>(GetLastError()), std::system_category() };
+      CloseHandle(file);
+      return mapping;
+    }
+    if (size.QuadPart) {
+      const auto handle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (!handle) {
+        ec = { static_cast<int>(GetLastError()), std::system_category() };
+        CloseHandle(file);
+        return mapping;
+      }
+      const auto data = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+      if (!data) {
+        ec = { static_cast<int>(GetLastError()), std::system_category() };
+      }
+      CloseHandle(handle);
+      if (!data) {
+        CloseHandle(file);
+        return mapping;
+      }
+      mapping.data_ = static_cast<const std::byte*>(data);
+      mapping.size_ = static_cast<std::size_t>(size.QuadPart);
+    }
+    CloseHandle(file);
+#else
+    const auto file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file == -1) {
+      ec = { errno, std::system_category() };
+      return mapping;
+    }
+    struct stat st = {};
+    if (fstat(file, &st)) {
+      ec = { errno, std::system_category() };
+      ::close(file);
+      return mapping;
+    }
+    if (st.st_size) {
+      const auto data = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, file, 0);
+      if (data == MAP_FAILED) {
+        ec = { errno, std::system_category() };
+        ::close(file);
+        return mapping;
+      }
+      mapping.data_ = static_cast<const std::byte*>(data);
+      mapping.size_ = static_cast<std::size_t>(st.st_size);
+    }
+    ::close(file);
+#endif
+    ec.clear();
+    return mapping;
+  }
+
+  const std::byte* data() const noexcept {
+    return data_;
+  }
+
+  std::size_t size() const noexcept {
+    return size_;
+  }
+
+  std::span<const std::byte> span() const noexcept {
+    return { data_, size_ };
+  }
+
+  void close() noexcept {
+    if (data_) {
+#ifdef _WIN32
+      UnmapViewOfFile(data_);
+#else
+      munmap(const_cast<std::byte*>(data_), size_);
+#endif
+      data_ = nullptr;
+      size_ = 0;
+    }
+  }
+
+private:
+  const std::byte* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+}  // namespace installer
@@ -0,0 +1,376 @@
+#pragma once
+#include <installer/hash.hpp>
+#include <installer/mapping.hpp>
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+namespace installer {
+
+enum class package_errc {
+  invalid_magic = 1,
+  unsupported_version,
+  corrupt_index,
+  corrupt_chunk,
+  base_mismatch,
+};
+
+inline const std::error_category& package_category() noexcept {
+  class category : public std::error_category {
+  public:
+    const char* name() const noexcept override {
+      return "package";
+    }
+
+    std::string message(int code) const override {
+      switch (static_cast<package_errc>(code)) {
+      case package_errc::invalid_magic:
+        return "not a package";
+      case package_errc::unsupported_version:
+        return "unsupported package version";
+      case package_errc::corrupt_index:
+        return "corrupt package index";
+      case package_errc::corrupt_chunk:
+        return "corrupt package chunk";
+      case package_errc::base_mismatch:
+        return "installed file does not match the package delta";
+      }
+      return "unknown package error";
+    }
+  };
+  static const category category;
+  return category;
+}
+
+inline std::error_code make_error_code(package_errc code) noexcept {
+  return { static_cast<int>(code), package_category() };
+}
+
+}  // namespace installer
+
+template <>
+struct std::is_error_code_enum<installer::package_errc> : std::true_type {};
+
+namespace installer::format {
+
+// Package layout. All integers are little-endian.
+//
+//   header
+//   data      chunk contents, in the order they were written
+//   index     file table sorted by path, chunk references, chunk table sorted by digest, delta table sorted by
+//             file, delta operations, path strings
+//
+// The index is read in place from a memory mapping. Every structure has a fixed size and alignment, so opening
+// a package only validates the header and the table bounds and never parses or copies the index. The entries of
+// a file are validated when the file is used. Files are lists of references into the
+// chunk table and chunks are addressed by the digest of their uncompressed contents, so identical chunks are
+// stored once.
+//
+// A file can instead be described by a delta against its previous version. The delta is a list of operations
+// that either copy a range of the previous version or insert the contents of a chunk, and the file has no chunk
+// references of its own.
+
+static_assert(std::endian::native == std::endian::little);
+
+constexpr std::uint32_t magic = 0x504B4349;  // ICKP
+constexpr std::uint32_t version = 2;
+constexpr std::size_t alignment = 8;
+
+enum class compression : std::uint32_t {
+  none = 0,
+  lz4 = 1,  // LZ4 block
+};
+
+struct header {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t chunk_size;      // maximum uncompressed size of a chunk
+  std::uint32_t reserved;
+  std::uint64_t file_count;
+  std::uint64_t chunk_count;
+  std::uint64_t ref_count;
+  std::uint64_t delta_count;
+  std::uint64_t op_count;
+  std::uint64_t files_offset;    // file table
+  std::uint64_t refs_offset;     // chunk references of all files, std::uint32_t each
+  std::uint64_t chunks_offset;   // chunk table
+  std::uint64_t deltas_offset;   // delta table
+  std::uint64_t ops_offset;      // operations of all deltas
+  std::uint64_t strings_offset;  // path strings
+  std::uint64_t strings_size;
+  std::uint64_t data_offset;     // chunk contents
+  std::uint64_t data_size;
+  digest index;                  // digest of everything from files_offset to the end of the strings
+};
+
+struct file {
+  installer::digest digest;   // digest of the concatenated chunk digests
+  std::uint64_t path_offset;  // relative to strings_offset, UTF-8 with forward slashes
+  std::uint32_t path_size;
+  std::uint32_t flags;
+  std::uint64_t size;         // uncompressed size
+  std::uint32_t ref_offset;   // index of the first chunk reference
+  std::uint32_t ref_count;
+};
+
+struct chunk {
+  installer::digest digest;         // digest of the uncompressed contents
+  std::uint64_t offset;             // relative to data_offset
+  std::uint32_t stored_size;
+  std::uint32_t size;               // uncompressed size
+  format::compression compression;
+  std::uint32_t reserved;
+};
+
+struct delta {
+  std::uint32_t file;       // index of the file in the file table
+  std::uint32_t op_offset;  // index of the first operation
+  std::uint32_t op_count;
+  std::uint32_t reserved;
+  std::uint64_t base_size;  // size of the previous version
+};
+
+constexpr std::uint32_t base = UINT32_MAX;
+
+struct op {
+  std::uint64_t offset;  // offset in the previous version when copying from the base
+  std::uint32_t size;
+  std::uint32_t chunk;   // index of the chunk to insert, or base to copy from the previous version
+};
+
+static_assert(sizeof(header) == 160 && std::is_trivially_copyable_v<header>);
+static_assert(sizeof(file) == 64 && std::is_trivially_copyable_v<file>);
+static_assert(sizeof(chunk) == 56 && std::is_trivially_copyable_v<chunk>);
+static_assert(sizeof(delta) == 24 && std::is_trivially_copyable_v<delta>);
+static_assert(sizeof(op) == 16 && std::is_trivially_copyable_v<op>);
+
+}  // namespace installer::format
+
+namespace installer {
+
+// Read-only view of a package file.
+// Files, chunks and their contents are returned as references into the memory mapping and stay valid as long
+// as the package is open. Opening a package only checks the header and that the tables lie within the file in
+// order, so the references, chunks and delta of a file must be checked with validate() before they are used.
+class package {
+public:
+  package() noexcept = default;
+
+  static package open(const std::filesystem::path& path, std::error_code& ec) noexcept {
+    package package;
+    package.mapping_ = mapping::open(path, ec);
+    if (!ec) {
+      ec = package.validate();
+    }
+    if (ec) {
+      package.mapping_.close();
+    }
+    return package;
+  }
+
+  bool is_open() const noexcept {
+    return mapping_.data() != nullptr;
+  }
+
+  const format::header& header() const noexcept {
+    return *get<format::header>(0);
+  }
+
+  std::span<const format::file> files() const noexcept {
+    return { get<format::file>(header().files_offset), static_cast<std::size_t>(header().file_count) };
+  }
+
+  std::span<const format::chunk> chunks() const noexcept {
+    return { get<format::chunk>(header().chunks_offset), static_cast<std::size_t>(header().chunk_count) };
+  }
+
+  // Returns the path of a file, or an empty path if it does not lie within the path strings.
+  std::string_view path(const format::file& file) const noexcept {
+    const auto& header = this->header();
+    if (file.path_offset > header.strings_size || file.path_size > header.strings_size - file.path_offset) {
+      return {};
+    }
+    const auto strings = reinterpret_cast<const char*>(mapping_.data() + header.strings_offset);
+    return { strings + file.path_offset, file.path_size };
+  }
+
+  // Returns the chunk table indices of the file contents in order.
+  std::span<const std::uint32_t> refs(const format::file& file) const noexcept {
+    return { get<std::uint32_t>(header().refs_offset) + file.ref_offset, file.ref_count };
+  }
+
+  const format::chunk& chunk(std::uint32_t index) const noexcept {
+    return chunks()[index];
+  }
+
+  std::span<const format::delta> deltas() const noexcept {
+    return { get<format::delta>(header().deltas_offset), static_cast<std::size_t>(header().delta_count) };
+  }
+
+  // Returns the delta of a file against its previous version, or nullptr if the file is stored as chunks.
+  const format::delta* delta(const format::file& file) const noexcept {
+    const auto index = static_cast<std::uint32_t>(&file - files().data());
+    const auto deltas = this->deltas();
+    const auto it = std::lower_bound(deltas.begin(), deltas.end(), index, [](const format::delta& delta, std::uint32_t index) {
+      return delta.file < index;
+    });
+    if (it == deltas.end() || it->file != index) {
+      return nullptr;
+    }
+    return &*it;
+  }
+
+  std::span<const format::op> ops(const format::delta& delta) const noexcept {
+    return { get<format::op>(header().ops_offset) + delta.op_offset, delta.op_count };
+  }
+
+  // Returns the stored, possibly compressed contents of a chunk.
+  std::span<const std::byte> data(const format::chunk& chunk) const noexcept {
+    return { mapping_.data() + header().data_offset + chunk.offset, chunk.stored_size };
+  }
+
+  // Finds a file by its path relative to the package root. Returns nullptr if there is no such file.
+  const format::file* find(std::string_view path) const noexcept {
+    const auto files = this->files();
+    const auto it = std::lower_bound(files.begin(), files.end(), path, [this](const format::file& file, std::string_view path) {
+      return this->path(file) < path;
+    });
+    if (it == files.end() || this->path(*it) != path) {
+      return nullptr;
+    }
+    return &*it;
+  }
+
+  // Finds a chunk by the digest of its uncompressed contents. Returns nullptr if there is no such chunk.
+  const format::chunk* find(const digest& digest) const noexcept {
+    const auto chunks = this->chunks();
+    const auto it = std::lower_bound(chunks.begin(), chunks.end(), digest, [](const format::chunk& chunk, const installer::digest& digest) {
+      return chunk.digest < digest;
+    });
+    if (it == chunks.end() || it->digest != digest) {
+      return nullptr;
+    }
+    return &*it;
+  }
+
+  // Checks that the contents of a chunk lie within the data section.
+  std::error_code validate(const format::chunk& chunk) const noexcept {
+    const auto& header = this->header();
+    if (chunk.offset > header.data_size || chunk.stored_size > header.data_size - chunk.offset || chunk.size > header.chunk_size) {
+      return package_errc::corrupt_index;
+    }
+    return {};
+  }
+
+  // Checks the path of a file, and that its chunk references or its delta lie within the package and add up to
+  // the size of the file. Takes time proportional to the entries of the file.
+  std::error_code validate(const format::file& file) const noexcept {
+    const auto& header = this->header();
+    if (path(file).empty() || file.ref_offset > header.ref_count || file.ref_count > header.ref_count - file.ref_offset) {
+      return package_errc::corrupt_index;
+    }
+    const auto delta = this->delta(file);
+    // A file is stored either as chunks or as a delta, and only an empty file has neither.
+    if ((file.ref_count && delta) || (!file.ref_count && !delta && file.size)) {
+      return package_errc::corrupt_index;
+    }
+    std::uint64_t size = 0;
+    for (const auto ref : refs(file)) {
+      if (ref >= header.chunk_count || validate(chunk(ref))) {
+        return package_errc::corrupt_index;
+      }
+      size += chunk(ref).size;
+    }
+    if (delta) {
+      if (delta->op_offset > header.op_count || delta->op_count > header.op_count - delta->op_offset) {
+        return package_errc::corrupt_index;
+      }
+      for (const auto& op : ops(*delta)) {
+        if (op.chunk == format::base) {
+          if (op.offset > delta->base_size || op.size > delta->base_size - op.offset || op.size > header.chunk_size) {
+            return package_errc::corrupt_index;
+          }
+        } else if (op.chunk >= header.chunk_count || validate(chunk(op.chunk)) || op.size != chunk(op.chunk).size) {
+          return package_errc::corrupt_index;
+        }
+        size += op.size;
+      }
+    }
+    if (size != file.size) {
+      return package_errc::corrupt_index;
+    }
+    return {};
+  }
+
+  // Hashes the index and compares it with the digest in the header.
+  bool verify() const noexcept {
+    const auto& header = this->header();
+    const auto begin = mapping_.data() + header.files_offset;
+    const auto end = mapping_.data() + header.strings_offset + header.strings_size;
+    return hash({ begin, end }) == header.index;
+  }
+
+  void close() noexcept {
+    mapping_.close();
+  }
+
+private:
+  template <typename T>
+  const T* get(std::uint64_t offset) const noexcept {
+    return reinterpret_cast<const T*>(mapping_.data() + offset);
+  }
+
+  // Checks the header and that every table lies within the mapping in the order of the layout. Takes constant time.
+  std::error_code validate() const noexcept {
+    const auto size = static_cast<std::uint64_t>(mapping_.size());
+    const auto contains = [size](std::uint64_t offset, std::uint64_t count, std::uint64_t element) {
+      return offset <= size && count <= (size - offset) / element;
+    };
+    if (size < sizeof(format::header)) {
+      return package_errc::invalid_magic;
+    }
+    const auto& header = this->header();
+    if (header.magic != format::magic) {
+      return package_errc::invalid_magic;
+    }
+    if (header.version != format::version) {
+      return package_errc::unsupported_version;
+    }
+    if (header.files_offset % format::alignment || header.refs_offset % format::alignment ||
+      header.chunks_offset % format::alignment || header.deltas_offset % format::alignment ||
+      header.ops_offset % format::alignment || !contains(header.files_offset, header.file_count, sizeof(format::file)) ||
+      !contains(header.refs_offset, header.ref_count, sizeof(std::uint32_t)) ||
+      !contains(header.chunks_offset, header.chunk_count, sizeof(format::chunk)) ||
+      !contains(header.deltas_offset, header.delta_count, sizeof(format::delta)) ||
+      !contains(header.ops_offset, header.op_count, sizeof(format::op)) ||
+      !contains(header.strings_offset, header.strings_size, 1) || !contains(header.data_offset, header.data_size, 1) ||
+      header.file_count > UINT32_MAX || header.chunk_count >= UINT32_MAX || header.ref_count > UINT32_MAX ||
+      header.op_count > UINT32_MAX) {
+      return package_errc::corrupt_index;
+    }
+    // The index tables follow each other without overlapping, so that the range that verify() hashes lies within
+    // the mapping. The ends cannot overflow, since every table lies within the mapping.
+    const auto end = [](std::uint64_t offset, std::uint64_t count, std::uint64_t element) {
+      return offset + count * element;
+    };
+    if (end(header.files_offset, header.file_count, sizeof(format::file)) > header.refs_offset ||
+      end(header.refs_offset, header.ref_count, sizeof(std::uint32_t)) > header.chunks_offset ||
+      end(header.chunks_offset, header.chunk_count, sizeof(format::chunk)) > header.deltas_offset ||
+      end(header.deltas_offset, header.delta_count, sizeof(format::delta)) > header.ops_offset ||
+      end(header.ops_offset, header.op_count, sizeof(format::op)) > header.strings_offset) {
+      return package_errc::corrupt_index;
+    }
+    return {};
+  }
+
+  mapping mapping_;
+};
+
+}  // namespace installer
@@ -0,0 +1,255 @@
+#pragma once
+#include <installer/delta.hpp>
+#include <installer/hash.hpp>
+#include <installer/lz4.hpp>
+#include <installer/mapping.hpp>
+#include <installer/package.hpp>
+#include <installer/stdio_file.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <span>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace installer {
+
+struct package_options {
+  std::uint32_t chunk_size = 1 << 20;
+  format::compression compression = format::compression::lz4;
+  std::filesystem::path base;           // directory with the previous version to write deltas against
+  std::uint32_t delta_block_size = 4096;
+};
+
+namespace detail {
+
+template <typename T>
+void append(std::vector<std::byte>& buffer, std::span<const T> values) {
+  const auto bytes = std::as_bytes(values);
+  buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+}
+
+inline void align(std::vector<std::byte>& buffer, std::size_t alignment) {
+  buffer.resize((buffer.size() + alignment - 1) / alignment * alignment);
+}
+
+}  // namespace detail
+
+// Writes all regular files below the source directory into a new package.
+// Files are split into chunks of options.chunk_size bytes, and chunks with identical contents are stored once.
+// Every chunk is compressed on its own so that chunks can be decompressed in parallel, and is stored as is when
+// compression does not make it smaller.
+// When options.base is set, files that also exist in that directory are written as deltas against it and the
+// package can only be installed over that version. Only the literal data of a delta is stored.
+// File and chunk contents are streamed, only the index is kept in memory.
+inline void write_package(const std::filesystem::path& source, const std::filesystem::path& target, std::error_code& ec,
+  const package_options& options = {}) noexcept {
+  ec.clear();
+  struct entry {
+    std::filesystem::path path;
+    std::string name;
+  };
+  std::vector<entry> entries;
+  for (std::filesystem::recursive_directory_iterator it{ source, ec }, end; !ec && it != end; it.increment(ec)) {
+    if (it->is_regular_file(ec)) {
+      const auto name = it->path().lexically_relative(source).generic_u8string();
+      entries.push_back({ it->path(), { reinterpret_cast<const char*>(name.data()), name.size() } });
+    }
+  }
+  if (ec) {
+    return;
+  }
+  std::sort(entries.begin(), entries.end(), [](const entry& lhs, const entry& rhs) { return lhs.name < rhs.name; });
+
+  detail::stdio_file output{ target, "wb", ec };
+  if (ec) {
+    return;
+  }
+  const auto fail = [&]() {
+    output.close(ec);
+    std::error_code ignored;
+    std::filesystem::remove(target, ignored);
+  };
+
+  format::header header = {};
+  header.magic = format::magic;
+  header.version = format::version;
+  header.chunk_size = options.chunk_size;
+  header.data_offset = sizeof(header);
+  output.write(std::as_bytes(std::span{ &header, 1 }), ec);
+
+  std::vector<format::file> files;
+  std::vector<format::chunk> chunks;
+  std::vector<std::uint32_t> refs;
+  std::vector<format::delta> deltas;
+  std::vector<format::op> ops;
+  std::string strings;
+  std::unordered_map<digest, std::uint32_t, digest_hash> known;
+  std::vector<std::byte> buffer(options.chunk_size);
+  std::vector<std::byte> compressed(options.chunk_size);
+  files.reserve(entries.size());
+
+  // Appends a chunk unless a chunk with the same contents was already written.
+  const auto store = [&](std::span<const std::byte> data, const digest& digest) {
+    auto [it, inserted] = known.try_emplace(digest, static_cast<std::uint32_t>(chunks.size()));
+    if (inserted) {
+      auto stored = data;
+      format::chunk chunk = {};
+      chunk.digest = digest;
+      chunk.offset = header.data_size;
+      chunk.size = static_cast<std::uint32_t>(data.size());
+      chunk.compression = format::compression::none;
+      if (options.compression == format::compression::lz4) {
+        if (const auto size = lz4::compress(data, std::span{ compressed }.first(data.size() - 1))) {
+          stored = std::span{ compressed }.first(size);
+          chunk.compression = format::compression::lz4;
+        }
+      }
+      chunk.stored_size = static_cast<std::uint32_t>(stored.size());
+      chunks.push_back(chunk);
+      output.write(stored, ec);
+      header.data_size += stored.size();
+    }
+    return it->second;
+  };
+
+  for (const auto& entry : entries) {
+    if (ec) {
+      return fail();
+    }
+    format::file file = {};
+    file.path_offset = strings.size();
+    file.path_size = static_cast<std::uint32_t>(entry.name.size());
+    file.ref_offset = static_cast<std::uint32_t>(refs.size());
+    strings.append(entry.name);
+    hasher digests;
+
+    std::filesystem::path previous_path;
+    if (!options.base.empty()) {
+      previous_path = options.base / entry.path.lexically_relative(source);
+      if (!std::filesystem::is_regular_file(previous_path, ec)) {
+        previous_path.clear();
+      }
+      ec.clear();
+    }
+    if (!previous_path.empty()) {
+      const auto previous = mapping::open(previous_path, ec);
+      if (ec) {
+        return fail();
+      }
+      const auto current = mapping::open(entry.path, ec);
+      if (ec) {
+        return fail();
+      }
+      const auto data = current.span();
+      for (std::size_t offset = 0; offset < data.size(); offset += options.chunk_size) {
+        const auto digest = hash(data.subspan(offset, std::min<std::size_t>(options.chunk_size, data.size() - offset)));
+        digests.update(std::as_bytes(std::span{ digest.bytes }));
+      }
+      format::delta delta = {};
+      delta.file = static_cast<std::uint32_t>(files.size());
+      delta.op_offset = static_cast<std::uint32_t>(ops.size());
+      delta.base_size = previous.size();
+      for (const auto& range : diff(previous.span(), data, options.delta_block_size)) {
+        for (std::uint64_t offset = 0; offset < range.size; offset += options.chunk_size) {
+          const auto size = std::min<std::uint64_t>(options.chunk_size, range.size - offset);
+          if (range.base) {
+            ops.push_back({ range.offset + offset, static_cast<std::uint32_t>(size), format::base });
+          } else {
+            const auto literal = data.subspan(static_cast<std::size_t>(range.offset + offset), static_cast<std::size_t>(size));
+            ops.push_back({ 0, static_cast<std::uint32_t>(size), store(literal, hash(literal)) });
+          }
+          delta.op_count++;
+        }
+      }
+      deltas.push_back(delta);
+      file.size = data.size();
+      file.digest = digests.finalize();
+      files.push_back(file);
+      continue;
+    }
+
+    detail::stdio_file input{ entry.path, "rb", ec };
+    if (ec) {
+      return fail();
+    }
+    while (true) {
+      const auto size = input.read(buffer, ec);
+      if (ec) {
+        return fail();
+      }
+      if (!size) {
+        break;
+      }
+      const auto data = std::span{ buffer }.first(size);
+      const auto digest = hash(data);
+      refs.push_back(store(data, digest));
+      digests.update(std::as_bytes(std::span{ digest.bytes }));
+      file.size += size;
+      file.ref_count++;
+    }
+    file.digest = digests.finalize();
+    files.push_back(file);
+  }
+
+  // Sort the chunk table by digest for lookups and renumber the references.
+  std::vector<std::uint32_t> order(chunks.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](std::uint32_t lhs, std::uint32_t rhs) { return chunks[lhs].digest < chunks[rhs].digest; });
+  std::vector<std::uint32_t> index(chunks.size());
+  std::vector<format::chunk> sorted(chunks.size());
+  for (std::uint32_t i = 0; i < order.size(); i++) {
+    index[order[i]] = i;
+    sorted[i] = chunks[order[i]];
+  }
+  for (auto& ref : refs) {
+    ref = index[ref];
+  }
+  for (auto& op : ops) {
+    if (op.chunk != format::base) {
+      op.chunk = index[op.chunk];
+    }
+  }
+
+  // The index follows the data at the next aligned offset.
+  const auto end = header.data_offset + header.data_size;
+  const auto base = (end + format::alignment - 1) / format::alignment * format::alignment;
+  std::vector<std::byte> table;
+  header.file_count = files.size();
+  header.files_offset = base + table.size();
+  detail::append(table, std::span<const format::file>{ files });
+  header.ref_count = refs.size();
+  header.refs_offset = base + table.size();
+  detail::append(table, std::span<const std::uint32_t>{ refs });
+  detail::align(table, format::alignment);
+  header.chunk_count = sorted.size();
+  header.chunks_offset = base + table.size();
+  detail::append(table, std::span<const format::chunk>{ sorted });
+  header.delta_count = deltas.size();
+  header.deltas_offset = base + table.size();
+  detail::append(table, std::span<const format::delta>{ deltas });
+  header.op_count = ops.size();
+  header.ops_offset = base + table.size();
+  detail::append(table, std::span<const format::op>{ ops });
+  header.strings_offset = base + table.size();
+  header.strings_size = strings.size();
+  detail::append(table, std::span<const char>{ strings });
+  header.index = hash(table);
+
+  const std::byte padding[format::alignment] = {};
+  output.write(std::span{ padding }.first(static_cast<std::size_t>(base - end)), ec);
+  output.write(table, ec);
+  output.seek(0, ec);
+  output.write(std::as_bytes(std::span{ &header, 1 }), ec);
+  if (ec) {
+    return fail();
+  }
+  output.close(ec);
+}
+
+}  // namespace installer
@@ -0,0 +1,37 @@
+#pragma once
+#include <filesystem>
+#include <string_view>
+
+namespace installer::detail {
+
+// Converts a UTF-8 package path to a path without checking it.
+inline std::filesystem::path utf8_path(std::string_view name) {
+  return std::u8string_view{ reinterpret_cast<const char8_t*>(name.data()), name.size() };
+}
+
+// Returns the target directory in lexically normal form without a trailing separator, so that it compares equal
+// to the parent paths of its files.
+inline std::filesystem::path normal_target(const std::filesystem::path& target) {
+  auto path = target.lexically_normal();
+  if (!path.has_filename() && path.has_relative_path()) {
+    path = path.parent_path();
+  }
+  return path;
+}
+
+// Converts a package path to a path below the target directory.
+// Returns an empty path for absolute paths and paths that would leave the target directory.
+inline std::filesystem::path target_path(const std::filesystem::path& target, std::string_view name) {
+  const auto path = utf8_path(name);
+  if (path.empty() || path.has_root_path()) {
+    return {};
+  }
+  for (const auto& element : path) {
+    if (element == "..") {
+      return {};
+    }
+  }
+  return target / path;
+}
+
+}  // namespace installer::detail
@@ -0,0 +1,130 @@
+#pragma once
+#include <ice/context.hpp>
+#include <ice/task.hpp>
+#include <ice/timer.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+
+namespace installer {
+
+// Progress of an install that any thread can add to.
+// Counters are spread over cache line sized slots that threads pick by their id, so workers that add at the
+// same time rarely share a line. Adding is a relaxed increment; reading sums all slots, which is only done at
+// the rate of the reporter.
+class progress {
+public:
+  static constexpr std::size_t slots = 16;
+
+  struct state {
+    std::uint64_t files = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t total_files = 0;
+    std::uint64_t total_bytes = 0;
+    bool done = false;
+
+    // Returns the completed part of the total bytes between 0.0 and 1.0.
+    double fraction() const noexcept {
+      return total_bytes ? static_cast<double>(bytes) / static_cast<double>(total_bytes) : done ? 1.0 : 0.0;
+    }
+
+    bool operator==(const state& other) const noexcept = default;
+  };
+
+  progress() noexcept = default;
+
+  progress(const progress& other) = delete;
+  progress& operator=(const progress& other) = delete;
+
+  // Resets the counters and sets the totals of a new operation.
+  void start(std::uint64_t total_files, std::uint64_t total_bytes) noexcept {
+    for (auto& slot : slots_) {
+      slot.files.store(0, std::memory_order_relaxed);
+      slot.bytes.store(0, std::memory_order_relaxed);
+    }
+    total_files_.store(total_files, std::memory_order_relaxed);
+    total_bytes_.store(total_bytes, std::memory_order_relaxed);
+    done_.store(false, std::memory_order_release);
+  }
+
+  void add(std::uint64_t bytes, std::uint64_t files = 0) noexcept {
+    auto& slot = slots_[index()];
+    if (bytes) {
+      slot.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    if (files) {
+      slot.files.fetch_add(files, std::memory_order_relaxed);
+    }
+  }
+
+  // Marks the operation as finished, whether it succeeded or not.
+  void finish() noexcept {
+    done_.store(true, std::memory_order_release);
+  }
+
+  state sample() const noexcept {
+    state state;
+    state.done = done_.load(std::memory_order_acquire);
+    for (const auto& slot : slots_) {
+      state.files += slot.files.load(std::memory_order_relaxed);
+      state.bytes += slot.bytes.load(std::memory_order_relaxed);
+    }
+    state.total_files = total_files_.load(std::memory_order_relaxed);
+    state.total_bytes = total_bytes_.load(std::memory_order_relaxed);
+    return state;
+  }
+
+private:
+  struct alignas(64) slot {
+    std::atomic<std::uint64_t> files = 0;
+    std::atomic<std::uint64_t> bytes = 0;
+  };
+
+  static std::size_t index() noexcept {
+    thread_local const auto index = std::hash<std::thread::id>{}(std::this_thread::get_id()) % slots;
+    return index;
+  }
+
+  std::array<slot, slots> slots_;
+  std::atomic<std::uint64_t> total_files_ = 0;
+  std::atomic<std::uint64_t> total_bytes_ = 0;
+  std::atomic_bool done_ = false;
+};
+
+// Receives progress updates from report(), always on the context that report() runs on.
+class progress_sink {
+public:
+  virtual ~progress_sink() = default;
+  virtual void update(const progress::state& state) noexcept = 0;
+};
+
+// Samples the progress at a fixed interval and sends the state to the sink when it changed since the last tick,
+// so the sink gets at most one update per tick no matter how often workers add. Sends a last update and returns
+// once the progress is finished. A progress that is reused must be started again before report() is called, or
+// report() returns on the finished state of the last operation. Returns early if the context is stopped.
+inline ice::task<void> report(ice::context& context, const progress& progress, progress_sink& sink,
+  std::chrono::milliseconds interval = std::chrono::milliseconds(33)) noexcept {
+  co_await ice::schedule(context, ice::priority::high);
+  progress::state last;
+  auto deadline = ice::context::clock::now();
+  while (true) {
+    deadline += interval;
+    if (!co_await ice::sleep_until(context, deadline)) {
+      break;
+    }
+    const auto state = progress.sample();
+    if (state != last) {
+      sink.update(state);
+      last = state;
+    }
+    if (state.done) {
+      break;
+    }
+  }
+}
+
+}  // namespace installer
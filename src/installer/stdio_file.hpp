@@ -0,0 +1,77 @@
+#pragma once
+#include <algorithm>
+#include <filesystem>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace installer::detail {
+
+// Buffered file for sequential reads and writes outside of the io_service.
+class stdio_file {
+public:
+  stdio_file() noexcept = default;
+
+  stdio_file(const std::filesystem::path& path, const char* mode, std::error_code& ec) noexcept {
+#ifdef _WIN32
+    wchar_t wmode[8] = {};
+    std::copy_n(mode, std::min<std::size_t>(std::strlen(mode), 7), wmode);
+    file_ = _wfopen(path.c_str(), wmode);
+#else
+    file_ = std::fopen(path.c_str(), mode);
+#endif
+    if (!file_) {
+      ec = { errno, std::generic_category() };
+    }
+  }
+
+  stdio_file(const stdio_file& other) = delete;
+  stdio_file& operator=(const stdio_file& other) = delete;
+
+  ~stdio_file() {
+    if (file_) {
+      std::fclose(file_);
+    }
+  }
+
+  std::size_t read(std::span<std::byte> buffer, std::error_code& ec) noexcept {
+    const auto size = std::fread(buffer.data(), 1, buffer.size(), file_);
+    if (size < buffer.size() && std::ferror(file_)) {
+      ec = std::make_error_code(std::errc::io_error);
+    }
+    return size;
+  }
+
+  void write(std::span<const std::byte> buffer, std::error_code& ec) noexcept {
+    if (std::fwrite(buffer.data(), 1, buffer.size(), file_) != buffer.size()) {
+      ec = std::make_error_code(std::errc::io_error);
+    }
+  }
+
+  void seek(std::uint64_t offset, std::error_code& ec) noexcept {
+#ifdef _WIN32
+    const auto result = _fseeki64(file_, static_cast<long long>(offset), SEEK_SET);
+#else
+    const auto result = fseeko(file_, static_cast<off_t>(offset), SEEK_SET);
+#endif
+    if (result) {
+      ec = std::make_error_code(std::errc::io_error);
+    }
+  }
+
+  void close(std::error_code& ec) noexcept {
+    if (std::fclose(std::exchange(file_, nullptr))) {
+      ec = std::make_error_code(std::errc::io_error);
+    }
+  }
+
+private:
+  std::FILE* file_ = nullptr;
+};
+
+}  // namespace installer::detail
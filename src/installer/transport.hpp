@@ -0,0 +1,209 @@
+#pragma once
+#include <ice/task.hpp>
+#include <ice/trace.hpp>
+#include <installer/mapping.hpp>
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace installer {
+
+// Destination that files are pushed to, like a connected device or a local directory.
+// Operations are issued in order from a single thread and may be in flight at the same time. An implementation
+// must apply the operations on one handle in the order they were issued, so a write can be sent right after the
+// open of its file without waiting for the open to be acknowledged. The caller assigns handles and does not reuse
+// a handle before its close has completed.
+class transport {
+public:
+  using handle = std::uint32_t;
+
+  virtual ~transport() = default;
+
+  // Creates or truncates the file at the given relative path. The size is a hint for preallocation.
+  virtual ice::task<std::error_code> open(handle file, std::string_view path, std::uint64_t size) noexcept = 0;
+
+  // Writes all of the data at the given offset. The data stays valid until the returned task is ready.
+  virtual ice::task<std::error_code> write(handle file, std::uint64_t offset, std::span<const std::byte> data) noexcept = 0;
+
+  // Closes the file. Issued after all writes of the file have completed.
+  virtual ice::task<std::error_code> close(handle file) noexcept = 0;
+};
+
+struct push_options {
+  std::size_t chunk_size = 256 << 10;  // bytes per write
+  std::size_t window = 8;              // operations that may be in flight at the same time
+};
+
+struct push_entry {
+  std::filesystem::path source;
+  std::string target;
+};
+
+namespace detail {
+
+// Operations in flight on one transport, oldest first.
+// The file of a write that is marked as the last one is closed as soon as that write has completed. Data is kept
+// alive by the owner that is passed with it until its write has completed.
+class transport_window {
+public:
+  transport_window(transport& transport, std::size_t size) noexcept : transport_(transport), size_(std::max<std::size_t>(size, 1)) {
+  }
+
+  transport_window(transport_window&& other) = default;
+  transport_window(const transport_window& other) = delete;
+  transport_window& operator=(transport_window&& other) = delete;
+  transport_window& operator=(const transport_window& other) = delete;
+
+  // Returns the first error of any operation.
+  const std::error_code& error() const noexcept {
+    return ec_;
+  }
+
+  // Waits until another operation may be issued.
+  ice::task<void> reserve() noexcept {
+    while (queue_.size() >= size_) {
+      co_await complete();
+    }
+  }
+
+  // Opens a file and closes it right away when it is empty.
+  void open(transport::handle file, std::string_view path, std::uint64_t size) noexcept {
+    queue_.push_back({ transport_.open(file, path, size), file, nullptr, size == 0, issued() });
+  }
+
+  void write(transport::handle file, std::uint64_t offset, std::span<const std::byte> data, std::shared_ptr<const void> owner, bool last) noexcept {
+    queue_.push_back({ transport_.write(file, offset, data), file, std::move(owner), last, issued(), data.size() });
+  }
+
+  // Closes a file whose last write was not issued.
+  void close(transport::handle file) noexcept {
+    queue_.push_back({ transport_.close(file), file, nullptr, false, issued() });
+  }
+
+  // Waits for the oldest operation in flight, if there is one.
+  ice::task<void> wait() noexcept {
+    if (!queue_.empty()) {
+      co_await complete();
+    }
+  }
+
+  // Waits for all operations in flight. Tasks must not be destroyed while they are running.
+  ice::task<void> drain() noexcept {
+    while (!queue_.empty()) {
+      co_await complete();
+    }
+  }
+
+private:
+  struct pending {
+    ice::task<std::error_code> task;
+    transport::handle file = 0;
+    std::shared_ptr<const void> owner;
+    bool last = false;
+    std::int64_t issued = 0;  // while tracing
+    std::uint64_t size = 0;
+  };
+
+  static std::int64_t issued() noexcept {
+    return ice::trace::enabled() ? ice::trace::now() : 0;
+  }
+
+  // Waits for the oldest operation and closes its file after the last write.
+  ice::task<void> complete() noexcept {
+    auto front = std::move(queue_.front());
+    queue_.pop_front();
+    if (const auto ec = co_await std::move(front.task); ec && !ec_) {
+      ec_ = ec;
+    }
+    if (front.issued) {
+      ice::trace::record(transfer_stage, front.issued, ice::trace::now(), front.size);
+    }
+    if (front.last) {
+      queue_.push_back({ transport_.close(front.file), front.file, nullptr, false, issued() });
+    }
+  }
+
+  // Time from issuing an operation until the window sees it complete.
+  static inline const ice::trace::stage transfer_stage{ "transfer" };
+
+  transport& transport_;
+  const std::size_t size_;
+  std::deque<pending> queue_;
+  std::error_code ec_;
+};
+
+}  // namespace detail
+
+// Pushes files to the transport.
+// Up to options.window operations are kept in flight across file boundaries, so the round trip of every
+// operation overlaps with the ones issued after it instead of adding up per chunk and per file. Sources are
+// mapped and written from the mapping. Stops issuing operations on the first error, closes the file that was
+// being written, and returns the error once all operations in flight have completed.
+inline ice::task<std::error_code> push(transport& transport, std::span<const push_entry> entries, push_options options = {}) noexcept {
+  const auto chunk_size = std::max<std::size_t>(options.chunk_size, 1);
+  detail::transport_window window{ transport, options.window };
+  std::error_code ec;
+  for (std::size_t index = 0; index < entries.size(); index++) {
+    const auto file = static_cast<transport::handle>(index);
+    auto source = std::make_shared<mapping>(mapping::open(entries[index].source, ec));
+    if (ec) {
+      break;
+    }
+    const auto data = source->span();
+    co_await window.reserve();
+    if (window.error()) {
+      break;
+    }
+    window.open(file, entries[index].target, data.size());
+    auto opened = !data.empty();  // until the last write of the file is issued
+    for (std::size_t offset = 0; offset < data.size(); offset += chunk_size) {
+      const auto size = std::min(chunk_size, data.size() - offset);
+      co_await window.reserve();
+      if (window.error()) {
+        break;
+      }
+      opened = offset + size != data.size();
+      window.write(file, offset, data.subspan(offset, size), source, !opened);
+    }
+    if (window.error()) {
+      // The file was left without its last write. Its close is issued after all of its writes have completed.
+      if (opened) {
+        co_await window.drain();
+        window.close(file);
+      }
+      break;
+    }
+  }
+  co_await window.drain();
+  co_return ec ? ec : window.error();
+}
+
+// Pushes all regular files below the source directory to the same relative paths on the transport.
+inline ice::task<std::error_code> push(transport& transport, std::filesystem::path source, push_options options = {}) noexcept {
+  std::error_code ec;
+  std::vector<push_entry> entries;
+  for (auto it = std::filesystem::recursive_directory_iterator(source, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+    if (it->is_regular_file(ec)) {
+      const auto target = it->path().lexically_relative(source).generic_u8string();
+      entries.push_back({ it->path(), { reinterpret_cast<const char*>(target.data()), target.size() } });
+    }
+  }
+  if (ec) {
+    co_return ec;
+  }
+  std::sort(entries.begin(), entries.end(), [](const push_entry& lhs, const push_entry& rhs) {
+    return lhs.target < rhs.target;
+  });
+  co_return co_await push(transport, entries, options);
+}
+
+}  // namespace installer
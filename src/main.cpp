@@ -1,11 +1,36 @@
 #include "main.hpp"
 #include <dialog.hpp>
 #include <ice/context.hpp>
+#include <ice/io_service.hpp>
+#include <ice/thread_pool.hpp>
+#include <ice/timer.hpp>
+#include <installer/chunk_cache.hpp>
+#include <installer/extract.hpp>
+#include <installer/package.hpp>
+#include <installer/progress.hpp>
 #include <wrl/client.h>
+#include <filesystem>
 #include <thread>
 
 using Microsoft::WRL::ComPtr;
 
+// Shows the progress of an install in a progress bar control with a range of 0 to 1000.
+// Updates arrive on the io context at most once per report() tick and are posted to the control.
+class ProgressBar : public installer::progress_sink {
+public:
+  explicit ProgressBar(HWND hwnd) noexcept : hwnd_(hwnd) {
+    SendMessage(hwnd_, PBM_SETRANGE32, 0, 1000);
+    SendMessage(hwnd_, PBM_SETPOS, 0, 0);
+  }
+
+  void update(const installer::progress::state& state) noexcept override {
+    PostMessage(hwnd_, PBM_SETPOS, static_cast<WPARAM>(state.fraction() * 1000.0), 0);
+  }
+
+private:
+  HWND hwnd_ = nullptr;
+};
+
 class Application : public Dialog<Application> {
 public:
   Application(HINSTANCE hinstance) noexcept : Dialog(hinstance, nullptr, IDD_MAIN, IDI_MAIN) {
@@ -17,14 +42,15 @@ public:
     thread_.join();
   }
 
+  // Dialog handlers are control work and run ahead of the install continuations on the io context.
   ice::schedule Io() noexcept {
-    return io_;
+    return ice::schedule(io_, ice::priority::high);
   }
 
   ice::task<void> OnCreate() noexcept {
     co_await Io();
     SetStatus(L"Waiting for device...");
-    Sleep(2000);
+    co_await ice::sleep_for(io_, std::chrono::seconds(2));
     EnableWindow(GetControl(IDC_INSTALL), TRUE);
     SetStatus(L"");
     co_return;
@@ -40,7 +66,30 @@ public:
     co_return;
   }
 
+  // Extracts the package next to the executable without blocking the message loop.
   ice::task<void> OnInstall() noexcept {
+    EnableWindow(GetControl(IDC_INSTALL), FALSE);
+    ProgressBar bar{ GetControl(IDC_PROGRESS) };
+    co_await Io();
+    SetStatus(L"Installing...");
+    const auto directory = ModuleDirectory();
+    std::error_code ec;
+    const auto package = installer::package::open(directory / L"installer.pkg", ec);
+    if (!ec) {
+      installer::extract_options options;
+      options.cache = &cache_;
+      options.progress = &progress_;
+      // Clears the finished state of the last attempt before the reporter samples it.
+      progress_.start(0, 0);
+      auto report = installer::report(io_, progress_, bar);
+      ec = co_await installer::extract(package, directory / L"install", pool_, service_, options);
+      co_await std::move(report);
+    }
+    if (ec) {
+      SetStatus(L"Installation failed.");
+      EnableWindow(GetControl(IDC_INSTALL), TRUE);
+      co_return;
+    }
     SendMessage(hwnd_, WM_CLOSE, 0, 0);
     co_return;
   }
@@ -72,6 +121,12 @@ public:
     SendMessage(GetDlgItem(hwnd_, IDC_STATUS), SB_SETTEXT, 0, reinterpret_cast<LPARAM>(status));
   }
 
+  static std::filesystem::path ModuleDirectory() noexcept {
+    wchar_t path[MAX_PATH] = {};
+    GetModuleFileName(nullptr, path, MAX_PATH);
+    return std::filesystem::path(path).parent_path();
+  }
+
   static BOOL Initialize() noexcept {
     INITCOMMONCONTROLSEX icc = {};
     icc.dwSize = sizeof(icc);
@@ -91,6 +146,10 @@ public:
 private:
   ice::context io_;
   std::thread thread_;
+  ice::thread_pool pool_;
+  ice::io_service service_{ io_ };
+  installer::chunk_cache cache_{ 256 << 20 };
+  installer::progress progress_;
 };
 
 int __stdcall wWinMain(HINSTANCE hinstance, HINSTANCE, LPWSTR, int) {
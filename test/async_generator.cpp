@@ -0,0 +1,121 @@
+#include "common.hpp"
+#include <ice/async_generator.hpp>
+#include <ice/file.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Sets the flag when the producer frame is destroyed.
+struct guard {
+  ~guard() {
+    destroyed = true;
+  }
+
+  bool& destroyed;
+};
+
+ice::async_generator<int> produce(int count, int& produced, bool& destroyed) noexcept {
+  guard guard{ destroyed };
+  for (int i = 0; i < count; i++) {
+    produced++;
+    co_yield i;
+  }
+}
+
+ice::task<void> consume(ice::async_generator<int>& generator, int& produced, std::vector<int>& values, std::size_t limit) noexcept {
+  for (auto it = co_await generator.begin(); it != generator.end(); co_await ++it) {
+    EXPECT_EQ(produced, static_cast<int>(values.size()) + 1);
+    values.push_back(*it);
+    if (values.size() == limit) {
+      break;
+    }
+  }
+}
+
+// Yields the values on the context thread, so the consumer suspends between them.
+ice::async_generator<int> post(ice::context& context, int count) noexcept {
+  for (int i = 0; i < count; i++) {
+    co_await ice::schedule(context, true);
+    co_yield i;
+  }
+}
+
+ice::task<int> sum(ice::context& context, int count) noexcept {
+  auto generator = post(context, count);
+  int sum = 0;
+  for (auto it = co_await generator.begin(); it != generator.end(); co_await ++it) {
+    sum += *it;
+  }
+  co_return sum;
+}
+
+ice::task<std::string> read(const ice::file& file, std::size_t chunk, std::size_t& chunks, std::error_code& ec) noexcept {
+  std::vector<std::byte> buffer(chunk);
+  auto generator = file.read_chunks(0, buffer, ec);
+  std::string data;
+  for (auto it = co_await generator.begin(); it != generator.end(); co_await ++it) {
+    data.append(reinterpret_cast<const char*>(it->data()), it->size());
+    chunks++;
+  }
+  co_return data;
+}
+
+}  // namespace
+
+// The producer runs only while the consumer waits for the next value, so at most one value is in flight.
+TEST(async_generator, backpressure) {
+  int produced = 0;
+  bool destroyed = false;
+  std::vector<int> values;
+  {
+    auto generator = produce(100, produced, destroyed);
+    EXPECT_EQ(produced, 0);
+    ice::sync_wait(consume(generator, produced, values, 1000));
+    EXPECT_EQ(produced, 100);
+  }
+  ASSERT_EQ(values.size(), 100u);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(values[i], i);
+  }
+  EXPECT_TRUE(destroyed);
+}
+
+// A consumer that stops early leaves the producer suspended until the generator destroys it.
+TEST(async_generator, stop_early) {
+  int produced = 0;
+  bool destroyed = false;
+  std::vector<int> values;
+  {
+    auto generator = produce(100, produced, destroyed);
+    ice::sync_wait(consume(generator, produced, values, 10));
+    EXPECT_EQ(produced, 10);
+    EXPECT_FALSE(destroyed);
+  }
+  EXPECT_TRUE(destroyed);
+}
+
+TEST(async_generator, suspend) {
+  ice::context context;
+  std::thread runner([&]() { context.run(); });
+  EXPECT_EQ(ice::sync_wait(sum(context, 1000)), 999 * 1000 / 2);
+  context.stop();
+  runner.join();
+}
+
+TEST(async_generator, read_chunks) {
+  const test::directory directory;
+  const auto data = test::data(100000, 1);
+  test::write(directory / "file", data);
+  test::runtime runtime;
+  std::error_code ec;
+  const auto file = ice::file::open(runtime.service, directory / "file", ice::file_mode::read, ec);
+  ASSERT_FALSE(ec) << ec.message();
+  std::size_t chunks = 0;
+  EXPECT_TRUE(ice::sync_wait(read(file, 4096, chunks, ec)) == data);
+  EXPECT_FALSE(ec) << ec.message();
+  EXPECT_EQ(chunks, 25u);
+}
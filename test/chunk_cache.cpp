@@ -0,0 +1,92 @@
+#include "test.hpp"
+#include <installer/chunk_cache.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace {
+
+// Returns a digest that falls into the given shard.
+installer::digest key(std::uint8_t value, std::uint8_t shard = 0) noexcept {
+  installer::digest digest;
+  digest.bytes[0] = value;
+  digest.bytes[installer::digest::size - 1] = shard;
+  return digest;
+}
+
+installer::chunk_cache::buffer data(std::size_t size) {
+  return std::make_shared<std::byte[]>(size);
+}
+
+}  // namespace
+
+TEST(chunk_cache, hits_and_misses) {
+  installer::chunk_cache cache{ 1 << 20 };
+  EXPECT_FALSE(cache.find(key(1)));
+  const auto buffer = data(100);
+  cache.insert(key(1), buffer, 100);
+  EXPECT_EQ(cache.find(key(1)), buffer);
+  EXPECT_EQ(cache.find(key(1)), buffer);
+  EXPECT_FALSE(cache.find(key(2)));
+  const auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 2u);
+  EXPECT_EQ(stats.misses, 2u);
+  EXPECT_EQ(stats.insertions, 1u);
+  EXPECT_EQ(stats.evictions, 0u);
+  EXPECT_EQ(stats.entries, 1u);
+  EXPECT_EQ(stats.size, 100u);
+}
+
+// A shard evicts entries until the new one fits into its part of the budget.
+TEST(chunk_cache, budget) {
+  installer::chunk_cache cache{ installer::chunk_cache::shards * 1000 };
+  for (std::uint8_t i = 0; i < 10; i++) {
+    cache.insert(key(i), data(300), 300);
+    EXPECT_LE(cache.stats().size, 1000u);
+  }
+  const auto stats = cache.stats();
+  EXPECT_EQ(stats.insertions, 10u);
+  EXPECT_EQ(stats.evictions, 7u);
+  EXPECT_EQ(stats.entries, 3u);
+  EXPECT_EQ(stats.size, 900u);
+  for (std::uint8_t i = 7; i < 10; i++) {
+    EXPECT_TRUE(cache.find(key(i)));
+  }
+
+  cache.insert(key(20), data(1001), 1001);
+  EXPECT_FALSE(cache.find(key(20)));
+  cache.insert(key(21, 1), data(1000), 1000);
+  EXPECT_TRUE(cache.find(key(21, 1)));
+}
+
+// An entry that was found since the hand last passed it is kept, and evicted data stays valid while it is used.
+TEST(chunk_cache, second_chance) {
+  installer::chunk_cache cache{ installer::chunk_cache::shards * 1000 };
+  cache.insert(key(1), data(300), 300);
+  cache.insert(key(2), data(300), 300);
+  cache.insert(key(3), data(300), 300);
+  const auto first = cache.find(key(1));
+  cache.find(key(3));
+  cache.insert(key(4), data(300), 300);
+  EXPECT_FALSE(cache.find(key(2)));
+  cache.insert(key(5), data(300), 300);
+  EXPECT_FALSE(cache.find(key(1)));
+  EXPECT_TRUE(cache.find(key(3)));
+  EXPECT_TRUE(cache.find(key(4)));
+  EXPECT_TRUE(cache.find(key(5)));
+  EXPECT_EQ(first.use_count(), 1);
+  EXPECT_EQ(cache.stats().evictions, 2u);
+}
+
+TEST(chunk_cache, clear) {
+  installer::chunk_cache cache{ 1 << 20 };
+  cache.insert(key(1), data(100), 100);
+  EXPECT_TRUE(cache.find(key(1)));
+  cache.clear();
+  EXPECT_FALSE(cache.find(key(1)));
+  const auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.entries, 0u);
+  EXPECT_EQ(stats.size, 0u);
+}
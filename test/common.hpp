@@ -0,0 +1,100 @@
+#pragma once
+#include "test.hpp"
+#include <ice/context.hpp>
+#include <ice/io_service.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <ice/thread_pool.hpp>
+#include <installer/extract.hpp>
+#include <installer/package.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+namespace test {
+
+// Creates an empty directory for a test and removes it afterwards.
+class directory {
+public:
+  directory() {
+    path_ = std::filesystem::temp_directory_path() / "installer-test" / test::current().name;
+    std::filesystem::remove_all(path_);
+    std::filesystem::create_directories(path_);
+  }
+
+  directory(const directory& other) = delete;
+  directory& operator=(const directory& other) = delete;
+
+  ~directory() {
+    std::error_code ec;
+    std::filesystem::remove_all(path_, ec);
+  }
+
+  const std::filesystem::path& path() const noexcept {
+    return path_;
+  }
+
+  std::filesystem::path operator/(std::string_view name) const {
+    return path_ / name;
+  }
+
+private:
+  std::filesystem::path path_;
+};
+
+inline void write(const std::filesystem::path& path, std::string_view data) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream{ path, std::ios::binary }.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+inline std::string read(const std::filesystem::path& path) {
+  std::ifstream file{ path, std::ios::binary };
+  return { std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+// Returns data that compresses partly, so that packages contain compressed and literal ranges.
+inline std::string data(std::size_t size, std::size_t seed) {
+  std::string data(size, '\0');
+  for (std::size_t i = 0; i < size; i++) {
+    data[i] = static_cast<char>(((i + seed) * 2654435761u >> 24) % 48);
+  }
+  return data;
+}
+
+// Context, io_service and thread pool that extract() runs on.
+class runtime {
+public:
+  runtime() {
+    thread_ = std::thread([this]() { context.run(); });
+  }
+
+  runtime(const runtime& other) = delete;
+  runtime& operator=(const runtime& other) = delete;
+
+  ~runtime() {
+    context.stop();
+    thread_.join();
+  }
+
+  std::error_code extract(const installer::package& package, const std::filesystem::path& target, installer::extract_options options = {}) {
+    return ice::sync_wait(start(package, target, options));
+  }
+
+  ice::context context;
+  ice::io_service service{ context };
+  ice::thread_pool pool{ 2 };
+
+private:
+  ice::task<std::error_code> start(const installer::package& package, std::filesystem::path target, installer::extract_options options) noexcept {
+    co_await ice::schedule(context, true);
+    co_return co_await installer::extract(package, std::move(target), pool, service, options);
+  }
+
+  std::thread thread_;
+};
+
+}  // namespace test
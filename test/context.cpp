@@ -0,0 +1,180 @@
+#include "test.hpp"
+#include <ice/context.hpp>
+#include <ice/task.hpp>
+#include <ice/timer.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Posts to the context and records the value. Posts again and records the value plus offset if offset is not 0.
+ice::task<void> post(ice::context& context, std::vector<int>& order, int value, int offset = 0) noexcept {
+  co_await ice::schedule(context, true);
+  order.push_back(value);
+  if (offset) {
+    co_await ice::schedule(context, true);
+    order.push_back(value + offset);
+  }
+}
+
+ice::task<void> post(ice::context& context, ice::priority priority, std::vector<int>& order, int value) noexcept {
+  co_await ice::schedule(context, priority, true);
+  order.push_back(value);
+}
+
+ice::task<void> spin(ice::context& context, std::size_t& count, std::size_t iterations) noexcept {
+  for (std::size_t i = 0; i < iterations; i++) {
+    co_await ice::schedule(context, true);
+    count++;
+  }
+}
+
+ice::task<void> increment(ice::context& context, std::atomic_size_t& count) noexcept {
+  co_await ice::schedule(context, true);
+  count.fetch_add(1, std::memory_order_relaxed);
+}
+
+ice::task<void> expire(ice::context& context, ice::context::clock::time_point deadline, const std::size_t& count, std::size_t& seen) noexcept {
+  co_await ice::sleep_until(context, deadline);
+  seen = count;
+}
+
+ice::task<void> fire(ice::context& context, ice::context::clock::time_point deadline, std::atomic<ice::context::clock::time_point>& fired) noexcept {
+  co_await ice::sleep_until(context, deadline);
+  fired.store(ice::context::clock::now(), std::memory_order_release);
+}
+
+}  // namespace
+
+// Events resume in the order they were scheduled, and events scheduled while a batch runs go behind it.
+TEST(context, fifo) {
+  ice::context context;
+  std::vector<int> order;
+  std::vector<ice::task<void>> tasks;
+  for (int i = 0; i < 100; i++) {
+    tasks.push_back(post(context, order, i, 100));
+  }
+  std::thread runner([&]() { context.run(); });
+  context.stop();
+  runner.join();
+  ASSERT_EQ(order.size(), 200u);
+  for (int i = 0; i < 200; i++) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+// An event that keeps scheduling itself does not keep the runner from expiring timers between batches.
+TEST(context, batch) {
+  ice::context context;
+  std::size_t count = 0;
+  std::size_t seen = 0;
+  auto timer = expire(context, ice::context::clock::now() + std::chrono::milliseconds(1), count, seen);
+  auto spinner = spin(context, count, 1000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  std::thread runner([&]() { context.run(); });
+  context.stop();
+  runner.join();
+  EXPECT_TRUE(timer.is_ready());
+  EXPECT_TRUE(spinner.is_ready());
+  EXPECT_EQ(count, 1000u);
+  EXPECT_LE(seen, 1u);
+}
+
+// Producers on other threads that keep the bulk lane busy do not keep the runner from expiring timers.
+TEST(context, batch_with_producers) {
+  ice::context context;
+  std::thread runner([&]() { context.run(); });
+  std::atomic_size_t count = 0;
+  std::atomic_size_t posted = 0;
+  std::atomic<ice::context::clock::time_point> fired = ice::context::clock::time_point{};
+  const auto start = ice::context::clock::now();
+  std::vector<std::thread> producers;
+  for (int i = 0; i < 2; i++) {
+    producers.emplace_back([&]() {
+      const auto deadline = start + std::chrono::seconds(2);
+      while (fired.load(std::memory_order_acquire) == ice::context::clock::time_point{} && ice::context::clock::now() < deadline) {
+        if (posted.load(std::memory_order_relaxed) - count.load(std::memory_order_relaxed) < 64) {
+          posted.fetch_add(1, std::memory_order_relaxed);
+          increment(context, count).detach();
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  const auto deadline = ice::context::clock::now() + std::chrono::milliseconds(10);
+  fire(context, deadline, fired).detach();
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  while (count.load(std::memory_order_relaxed) < posted.load(std::memory_order_relaxed)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  context.stop();
+  runner.join();
+  EXPECT_LE(deadline, fired.load());
+  EXPECT_LT(fired.load() - deadline, std::chrono::milliseconds(500));
+}
+
+// Producers on other threads wake the runner when it parked, so none of their events waits forever.
+TEST(context, wake) {
+  ice::context context;
+  std::thread runner([&]() { context.run(); });
+  std::atomic_size_t count = 0;
+  std::vector<std::thread> producers;
+  for (int i = 0; i < 4; i++) {
+    producers.emplace_back([&]() {
+      for (int j = 0; j < 1000; j++) {
+        increment(context, count).detach();
+        if (j % 100 == 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (count.load(std::memory_order_relaxed) < 4000 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  context.stop();
+  runner.join();
+  EXPECT_EQ(count.load(), 4000u);
+}
+
+// High priority events run first, but a waiting bulk event runs after at most high_burst of them.
+TEST(context, priority) {
+  ice::context context;
+  std::vector<int> order;
+  std::vector<ice::task<void>> tasks;
+  tasks.push_back(post(context, ice::priority::bulk, order, -1));
+  tasks.push_back(post(context, ice::priority::bulk, order, -2));
+  for (int i = 0; i < 40; i++) {
+    tasks.push_back(post(context, ice::priority::high, order, i));
+  }
+  std::thread runner([&]() { context.run(); });
+  context.stop();
+  runner.join();
+  ASSERT_EQ(order.size(), 42u);
+  EXPECT_LE(0, order.front());
+  std::size_t burst = 0;
+  int high = 0;
+  int bulk = -1;
+  for (const auto value : order) {
+    if (value < 0) {
+      EXPECT_EQ(value, bulk--);
+      EXPECT_LE(burst, ice::context::high_burst);
+      burst = 0;
+    } else {
+      EXPECT_EQ(value, high++);
+      burst++;
+    }
+  }
+  EXPECT_EQ(bulk, -3);
+}
@@ -0,0 +1,112 @@
+#include "common.hpp"
+#include <installer/delta.hpp>
+#include <installer/package_writer.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Rebuilds the target from the base and the ranges that diff() returned.
+std::string apply(const std::string& base, const std::string& target, const std::vector<installer::delta_range>& ranges) {
+  std::string result;
+  for (const auto& range : ranges) {
+    const auto& source = range.base ? base : target;
+    EXPECT_LE(range.offset + range.size, source.size());
+    result.append(source, static_cast<std::size_t>(range.offset), static_cast<std::size_t>(range.size));
+  }
+  return result;
+}
+
+std::vector<installer::delta_range> diff(const std::string& base, const std::string& target, std::size_t block_size) {
+  return installer::diff(std::as_bytes(std::span{ base }), std::as_bytes(std::span{ target }), block_size);
+}
+
+std::uint64_t literal_size(const std::vector<installer::delta_range>& ranges) {
+  std::uint64_t size = 0;
+  for (const auto& range : ranges) {
+    size += range.base ? 0 : range.size;
+  }
+  return size;
+}
+
+}  // namespace
+
+TEST(delta, round_trip) {
+  const auto base = test::data(100000, 1);
+  std::vector<std::string> targets;
+  targets.push_back(base);
+  targets.push_back(base.substr(0, 50000) + "inserted" + base.substr(50000));
+  targets.push_back(base.substr(0, 30000) + base.substr(40000));
+  targets.push_back("prefix" + base + "suffix");
+  targets.push_back(base.substr(60000) + base.substr(0, 60000));
+  targets.push_back(test::data(5000, 9));
+  targets.push_back({});
+  for (const auto& target : targets) {
+    for (const std::size_t block_size : { 64, 4096 }) {
+      EXPECT_EQ(apply(base, target, diff(base, target, block_size)), target) << target.size() << ' ' << block_size;
+    }
+  }
+  EXPECT_EQ(apply({}, base, diff({}, base, 4096)), base);
+}
+
+TEST(delta, matches_moved_blocks) {
+  const auto base = test::data(100000, 1);
+  const auto target = base.substr(0, 50000) + "inserted" + base.substr(50000);
+  const auto ranges = diff(base, target, 4096);
+  EXPECT_LT(literal_size(ranges), 2 * 4096u);
+}
+
+// Installs a version, then a delta package against it, and checks that the target matches the new version.
+TEST(delta, package_round_trip) {
+  const test::directory directory;
+  const auto v1 = directory / "v1";
+  const auto v2 = directory / "v2";
+  const auto base = test::data(300000, 1);
+  test::write(v1 / "a" / "changed.bin", base);
+  test::write(v1 / "a" / "same.bin", test::data(1000, 2));
+  test::write(v2 / "a" / "changed.bin", base.substr(0, 100000) + "inserted" + base.substr(120000));
+  test::write(v2 / "a" / "same.bin", test::data(1000, 2));
+  test::write(v2 / "b" / "added.bin", test::data(70000, 3));
+
+  std::error_code ec;
+  installer::write_package(v1, directory / "v1.pkg", ec);
+  ASSERT_FALSE(ec) << ec.message();
+  installer::package_options options;
+  options.chunk_size = 64 << 10;
+  options.base = v1;
+  installer::write_package(v2, directory / "v2.pkg", ec, options);
+  ASSERT_FALSE(ec) << ec.message();
+  const auto full = installer::package::open(directory / "v1.pkg", ec);
+  ASSERT_FALSE(ec) << ec.message();
+  const auto delta = installer::package::open(directory / "v2.pkg", ec);
+  ASSERT_FALSE(ec) << ec.message();
+
+  test::runtime runtime;
+  const auto target = directory / "target";
+  ASSERT_FALSE(runtime.extract(full, target));
+  ASSERT_FALSE(runtime.extract(delta, target));
+  for (const auto name : { "a/changed.bin", "a/same.bin", "b/added.bin" }) {
+    EXPECT_EQ(test::read(target / name), test::read(v2 / name)) << name;
+  }
+}
+
+// A delta must not be applied to a file that is not the version it was written against.
+TEST(delta, base_mismatch) {
+  const test::directory directory;
+  const auto base = test::data(300000, 1);
+  test::write(directory / "v1" / "file.bin", base);
+  test::write(directory / "v2" / "file.bin", base.substr(0, 100000) + "inserted" + base.substr(100000));
+  std::error_code ec;
+  installer::package_options options;
+  options.base = directory / "v1";
+  installer::write_package(directory / "v2", directory / "v2.pkg", ec, options);
+  ASSERT_FALSE(ec) << ec.message();
+  const auto delta = installer::package::open(directory / "v2.pkg", ec);
+  ASSERT_FALSE(ec) << ec.message();
+
+  const auto target = directory / "target";
+  test::write(target / "file.bin", test::data(300000, 5));
+  test::runtime runtime;
+  EXPECT_EQ(runtime.extract(delta, target), installer::package_errc::base_mismatch);
+  EXPECT_EQ(test::read(target / "file.bin"), test::data(300000, 5));
+}
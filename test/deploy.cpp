@@ -0,0 +1,166 @@
+#include "common.hpp"
+#include <installer/deploy.hpp>
+#include <installer/package_writer.hpp>
+#include <installer/transport.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Transport that keeps files in memory and checks that every operation is issued on the context.
+// With a latency, writes complete that long after they were issued, and the bytes of writes in flight are tracked.
+class memory_transport final : public installer::transport {
+public:
+  explicit memory_transport(ice::context& context, std::chrono::milliseconds latency = {}) noexcept : context_(context), latency_(latency) {
+  }
+
+  ice::task<std::error_code> open(handle file, std::string_view path, std::uint64_t /*size*/) noexcept override {
+    check();
+    opened_.insert(file);
+    paths_[file] = path;
+    files[paths_[file]].clear();
+    opens++;
+    co_return std::error_code{};
+  }
+
+  ice::task<std::error_code> write(handle file, std::uint64_t offset, std::span<const std::byte> data) noexcept override {
+    check();
+    if (!opened_.count(file)) {
+      co_return std::make_error_code(std::errc::bad_file_descriptor);
+    }
+    if (latency_.count()) {
+      pending += data.size();
+      max_pending = std::max(max_pending, pending);
+      co_await ice::sleep_for(context_, latency_);
+      pending -= data.size();
+    }
+    auto& contents = files[paths_[file]];
+    contents.resize(std::max<std::size_t>(contents.size(), offset + data.size()));
+    std::memcpy(contents.data() + offset, data.data(), data.size());
+    co_return std::error_code{};
+  }
+
+  ice::task<std::error_code> close(handle file) noexcept override {
+    check();
+    closes++;
+    co_return opened_.erase(file) ? std::error_code{} : std::make_error_code(std::errc::bad_file_descriptor);
+  }
+
+  std::size_t open_files() const noexcept {
+    return opened_.size();
+  }
+
+  std::map<std::string, std::string> files;
+  std::size_t opens = 0;
+  std::size_t closes = 0;
+  std::size_t foreign = 0;  // operations that were issued on another thread
+  std::size_t pending = 0;
+  std::size_t max_pending = 0;
+
+private:
+  void check() noexcept {
+    foreign += context_.is_current() ? 0 : 1;
+  }
+
+  ice::context& context_;
+  const std::chrono::milliseconds latency_;
+  std::set<handle> opened_;
+  std::map<handle, std::string> paths_;
+};
+
+ice::task<installer::deploy_result> start(ice::context& context, const installer::package& package, std::vector<installer::transport*> targets,
+  ice::thread_pool& pool, installer::deploy_options options = {}) noexcept {
+  co_await ice::schedule(context, true);
+  co_return co_await installer::deploy(package, targets, context, pool, options);
+}
+
+// Writes a package of stored chunks that are large enough to be verified on the thread pool.
+installer::package write(const test::directory& directory) {
+  test::write(directory / "source" / "a.bin", test::data(300000, 1));
+  test::write(directory / "source" / "b" / "c.bin", test::data(200000, 2));
+  test::write(directory / "source" / "empty.bin", {});
+  installer::package_options options;
+  options.chunk_size = 64 << 10;
+  options.compression = installer::format::compression::none;
+  std::error_code ec;
+  installer::write_package(directory / "source", directory / "package", ec, options);
+  EXPECT_FALSE(ec) << ec.message();
+  return installer::package::open(directory / "package", ec);
+}
+
+}  // namespace
+
+TEST(deploy, targets) {
+  const test::directory directory;
+  const auto package = write(directory);
+  test::runtime runtime;
+  memory_transport first{ runtime.context };
+  memory_transport second{ runtime.context };
+  const auto result = ice::sync_wait(start(runtime.context, package, { &first, &second }, runtime.pool));
+  for (const auto target : { &first, &second }) {
+    EXPECT_EQ(target->foreign, 0u);
+    EXPECT_EQ(target->opens, 3u);
+    EXPECT_EQ(target->open_files(), 0u);
+    EXPECT_EQ(target->files["a.bin"], test::read(directory / "source" / "a.bin"));
+    EXPECT_EQ(target->files["b/c.bin"], test::read(directory / "source" / "b" / "c.bin"));
+    EXPECT_EQ(target->files["empty.bin"], "");
+  }
+  for (const auto& ec : result.errors) {
+    EXPECT_FALSE(ec) << ec.message();
+  }
+}
+
+// Chunks count against the memory budget until the targets have written them, not only while they are decoded.
+TEST(deploy, memory) {
+  const test::directory directory;
+  const auto package = write(directory);
+  test::runtime runtime;
+  memory_transport target{ runtime.context, std::chrono::milliseconds(2) };
+  installer::deploy_options options;
+  options.memory = 2 * package.header().chunk_size;
+  options.window = 8;
+  const auto result = ice::sync_wait(start(runtime.context, package, { &target }, runtime.pool, options));
+  ASSERT_FALSE(result.errors[0]) << result.errors[0].message();
+  EXPECT_EQ(target.files["a.bin"], test::read(directory / "source" / "a.bin"));
+  EXPECT_EQ(target.files["b/c.bin"], test::read(directory / "source" / "b" / "c.bin"));
+  EXPECT_LT(0u, target.max_pending);
+  EXPECT_LE(target.max_pending, options.memory);
+}
+
+// A chunk that does not verify stops the deployment and closes the file that is open on every target.
+TEST(deploy, corrupt_chunk) {
+  const test::directory directory;
+  std::uint64_t offset = 0;
+  {
+    const auto package = write(directory);
+    const auto& file = package.files()[0];
+    ASSERT_EQ(package.path(file), "a.bin");
+    offset = package.header().data_offset + package.chunk(package.refs(file)[1]).offset + 100;
+  }
+  {
+    std::fstream stream{ directory / "package", std::ios::in | std::ios::out | std::ios::binary };
+    stream.seekp(static_cast<std::streamoff>(offset));
+    stream.put('x');
+  }
+  std::error_code ec;
+  const auto package = installer::package::open(directory / "package", ec);
+  ASSERT_FALSE(ec) << ec.message();
+  test::runtime runtime;
+  memory_transport first{ runtime.context };
+  memory_transport second{ runtime.context };
+  const auto result = ice::sync_wait(start(runtime.context, package, { &first, &second }, runtime.pool));
+  for (const auto target : { &first, &second }) {
+    EXPECT_EQ(target->foreign, 0u);
+    EXPECT_EQ(target->opens, 1u);
+    EXPECT_EQ(target->closes, 1u);
+    EXPECT_EQ(target->open_files(), 0u);
+  }
+  for (const auto& ec : result.errors) {
+    EXPECT_EQ(ec, installer::package_errc::corrupt_chunk);
+  }
+}
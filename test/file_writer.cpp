@@ -0,0 +1,66 @@
+#include "common.hpp"
+#include <installer/file_writer.hpp>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct entry {
+  std::string path;
+  std::string data;
+};
+
+// Returns small files spread over more directories than the directory cache keeps open, not in path order.
+std::vector<entry> entries(std::size_t count) {
+  std::vector<entry> entries;
+  for (std::size_t i = 0; i < count; i++) {
+    const auto directory = "d" + std::to_string(i % 100) + "/s" + std::to_string(i % 7);
+    entries.push_back({ directory + "/f" + std::to_string(i), test::data(i % 300, i) });
+  }
+  return entries;
+}
+
+ice::task<std::error_code> write(test::runtime& runtime, std::filesystem::path root, const std::vector<entry>& entries, bool sync) noexcept {
+  co_await ice::schedule(runtime.context, true);
+  installer::detail::file_writer writer{ runtime.service, runtime.pool, std::move(root), sync, 8 };
+  for (const auto& entry : entries) {
+    std::error_code ec;
+    auto file = writer.create(entry.path, entry.data.size(), ec);
+    if (ec) {
+      co_return ec;
+    }
+    if (entry.data.empty()) {
+      co_await writer.finish(std::move(file));
+      continue;
+    }
+    const auto owner = std::make_shared<std::string>(entry.data);
+    const std::span data{ reinterpret_cast<const std::byte*>(owner->data()), owner->size() };
+    co_await writer.write(file, 0, data, owner, true);
+  }
+  co_await writer.drain();
+  co_return writer.error();
+}
+
+}  // namespace
+
+// Many small files in many directories are all written completely, with and without syncing.
+TEST(file_writer, small_files) {
+  const auto files = entries(2000);
+  for (const auto sync : { false, true }) {
+    const test::directory directory;
+    test::runtime runtime;
+    const auto ec = ice::sync_wait(write(runtime, directory / "target", files, sync));
+    ASSERT_FALSE(ec) << ec.message();
+    std::size_t count = 0;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory / "target")) {
+      count += entry.is_regular_file() ? 1 : 0;
+    }
+    EXPECT_EQ(count, files.size()) << sync;
+    for (const auto& entry : files) {
+      EXPECT_TRUE(test::read(directory / "target" / entry.path) == entry.data) << entry.path;
+    }
+  }
+}
@@ -0,0 +1,36 @@
+#include "test.hpp"
+#include <ice/frame_pool.hpp>
+#include <thread>
+
+// A freed frame is handed out again by the next allocation of the same size class.
+TEST(frame_pool, reuse) {
+  const auto frame = ice::frame_pool::allocate(100);
+  ice::frame_pool::deallocate(frame, 100);
+  const auto same = ice::frame_pool::allocate(120);
+  EXPECT_EQ(same, frame);
+  const auto other = ice::frame_pool::allocate(100);
+  EXPECT_TRUE(other != frame);
+  ice::frame_pool::deallocate(other, 100);
+  ice::frame_pool::deallocate(same, 120);
+}
+
+// Frames of different size classes are kept apart.
+TEST(frame_pool, classes) {
+  const auto small = ice::frame_pool::allocate(64);
+  ice::frame_pool::deallocate(small, 64);
+  const auto large = ice::frame_pool::allocate(65);
+  EXPECT_TRUE(large != small);
+  EXPECT_EQ(ice::frame_pool::allocate(1), small);
+  ice::frame_pool::deallocate(small, 1);
+  ice::frame_pool::deallocate(large, 65);
+}
+
+// A frame that is freed on another thread moves to the cache of that thread.
+TEST(frame_pool, other_thread) {
+  void* frame = nullptr;
+  std::thread([&]() { frame = ice::frame_pool::allocate(300); }).join();
+  ice::frame_pool::deallocate(frame, 300);
+  const auto same = ice::frame_pool::allocate(300);
+  EXPECT_EQ(same, frame);
+  ice::frame_pool::deallocate(same, 300);
+}
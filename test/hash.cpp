@@ -0,0 +1,60 @@
+#include "test.hpp"
+#include <installer/hash.hpp>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace {
+
+// Inputs of the official BLAKE3 test vectors are the repeating byte sequence 0, 1, ..., 250.
+std::vector<std::byte> input(std::size_t size) {
+  std::vector<std::byte> data(size);
+  for (std::size_t i = 0; i < size; i++) {
+    data[i] = static_cast<std::byte>(i % 251);
+  }
+  return data;
+}
+
+struct vector {
+  std::size_t size;
+  const char* digest;
+};
+
+// https://github.com/BLAKE3-team/BLAKE3/blob/master/test_vectors/test_vectors.json
+constexpr vector vectors[] = {
+  { 0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262" },
+  { 1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213" },
+  { 1023, "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11" },
+  { 1024, "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7" },
+  { 1025, "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444" },
+  { 2048, "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a" },
+  { 31744, "62b6960e1a44bcc1eb1a611a8d6235b6b4b78f32e7abc4fb4c6cdcce94895c47" },
+  { 102400, "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085" },
+};
+
+}  // namespace
+
+TEST(hash, vectors) {
+  for (const auto& vector : vectors) {
+    EXPECT_EQ(installer::hash(input(vector.size)).to_string(), vector.digest) << vector.size;
+  }
+}
+
+TEST(hash, portable_kernel) {
+  for (const auto& vector : vectors) {
+    EXPECT_EQ(installer::hash(input(vector.size), installer::hasher::kernel::portable).to_string(), vector.digest) << vector.size;
+  }
+}
+
+// Updates that split the input at every position must give the same digest as hashing it at once.
+TEST(hash, incremental) {
+  const auto data = input(64 * 1024 + 17);
+  const auto expected = installer::hash(data);
+  for (const std::size_t step : { 1, 63, 64, 1023, 1024, 1025, 8192 }) {
+    installer::hasher hasher;
+    for (std::size_t offset = 0; offset < data.size(); offset += step) {
+      hasher.update(std::span{ data }.subspan(offset, std::min(step, data.size() - offset)));
+    }
+    EXPECT_EQ(hasher.finalize().to_string(), expected.to_string()) << step;
+  }
+}
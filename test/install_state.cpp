@@ -0,0 +1,105 @@
+#include "common.hpp"
+#include <installer/install_state.hpp>
+#include <installer/package_writer.hpp>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <utility>
+
+namespace {
+
+installer::package pack(const std::filesystem::path& source, const std::filesystem::path& path, const std::filesystem::path& base = {}) {
+  installer::package_options options;
+  options.chunk_size = 64 << 10;
+  options.base = base;
+  std::error_code ec;
+  installer::write_package(source, path, ec, options);
+  EXPECT_FALSE(ec) << ec.message();
+  auto package = installer::package::open(path, ec);
+  EXPECT_FALSE(ec) << ec.message();
+  return package;
+}
+
+void extract(test::runtime& runtime, const installer::package& package, const std::filesystem::path& target, bool incremental = true) {
+  installer::extract_options options;
+  options.incremental = incremental;
+  const auto ec = runtime.extract(package, target, options);
+  EXPECT_FALSE(ec) << ec.message();
+}
+
+// Replaces the content of a file with data of the same size and keeps its modification time.
+void replace(const std::filesystem::path& path, std::size_t seed) {
+  const auto time = std::filesystem::last_write_time(path);
+  test::write(path, test::data(std::filesystem::file_size(path), seed));
+  std::filesystem::last_write_time(path, time);
+}
+
+}  // namespace
+
+// Files whose size and modification time match the install state are skipped, others are copied again.
+// The tests replace content behind the same size and modification time to see whether a file was skipped.
+TEST(install_state, unchanged_files) {
+  const test::directory directory;
+  const auto source = directory / "source";
+  const auto target = directory / "target";
+  test::write(source / "a", test::data(1000, 1));
+  test::write(source / "b", test::data(2000, 2));
+  test::write(source / "c", test::data(3000, 3));
+  const auto package = pack(source, directory / "package");
+  test::runtime runtime;
+  extract(runtime, package, target);
+  for (const auto name : { "a", "b", "c" }) {
+    replace(target / name, 9);
+  }
+  extract(runtime, package, target);
+  for (const auto name : { "a", "b", "c" }) {
+    EXPECT_EQ(test::read(target / name), test::data(std::filesystem::file_size(target / name), 9)) << name;
+  }
+
+  const auto a_time = std::filesystem::last_write_time(target / "a");
+  std::filesystem::last_write_time(target / "a", a_time - std::chrono::hours(1));
+  const auto b_time = std::filesystem::last_write_time(target / "b");
+  test::write(target / "b", test::data(2001, 2));
+  std::filesystem::last_write_time(target / "b", b_time);
+  extract(runtime, package, target);
+  EXPECT_EQ(test::read(target / "a"), test::read(source / "a"));
+  EXPECT_EQ(test::read(target / "b"), test::read(source / "b"));
+  EXPECT_EQ(test::read(target / "c"), test::data(3000, 9));
+
+  extract(runtime, package, target, false);
+  EXPECT_EQ(test::read(target / "c"), test::read(source / "c"));
+}
+
+// Files of the previous install that the package no longer contains are removed, with and without a journal,
+// and their empty parent directories are removed up to a target that may end in a separator.
+TEST(install_state, removed_files) {
+  for (const auto [journal, name] : { std::pair{ true, "target" }, { false, "target" }, { true, "target/" }, { false, "target/" } }) {
+    const test::directory directory;
+    const auto source = directory / "source";
+    const auto target = directory / name;
+    for (const auto name : { "a/f1", "a/f2", "a/f3", "a/f4", "b/c/f5" }) {
+      test::write(source / name, test::data(1000, name[3]));
+    }
+    const auto v1 = pack(source, directory / "v1.pkg");
+    std::filesystem::copy(source, directory / "v1", std::filesystem::copy_options::recursive);
+    std::filesystem::remove(source / "a/f4");
+    std::filesystem::remove_all(source / "b");
+    const auto v2 = pack(source, directory / "v2.pkg", directory / "v1");
+
+    test::runtime runtime;
+    installer::extract_options options;
+    options.journal = journal;
+    ASSERT_FALSE(runtime.extract(v1, target, options));
+    test::write(target / "user.txt", "kept");
+    ASSERT_FALSE(runtime.extract(v2, target, options));
+    EXPECT_FALSE(std::filesystem::exists(target / "a/f4")) << journal << name;
+    EXPECT_FALSE(std::filesystem::exists(target / "b")) << journal << name;
+    EXPECT_TRUE(std::filesystem::exists(target / "a/f3")) << journal << name;
+    EXPECT_EQ(test::read(target / "user.txt"), "kept");
+    std::error_code ec;
+    const auto state = installer::install_state::load(target, ec);
+    ASSERT_FALSE(ec) << ec.message();
+    EXPECT_EQ(state.entries().size(), 3u);
+    EXPECT_FALSE(state.find("a/f4"));
+  }
+}
@@ -0,0 +1,138 @@
+#include "common.hpp"
+#include <ice/context.hpp>
+#include <ice/file.hpp>
+#include <ice/io_service.hpp>
+#include <ice/task.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::span<const std::byte> bytes(std::string_view data) noexcept {
+  return std::as_bytes(std::span{ data.data(), data.size() });
+}
+
+// Writes the data in pieces and patches a range in the middle, then reads the file back in pieces of another
+// size until a read returns 0 bytes and records the size of every read.
+ice::task<void> round_trip(ice::context& context, const ice::file& file, std::string& data, std::string& text,
+  std::vector<std::size_t>& sizes) noexcept {
+  co_await ice::schedule(context, true);
+  for (std::size_t offset = 0; offset < data.size(); offset += 4096) {
+    const auto piece = std::string_view{ data }.substr(offset, 4096);
+    const auto result = co_await file.write(offset, bytes(piece));
+    EXPECT_TRUE(result) << result.error.message();
+    EXPECT_EQ(result.size, piece.size());
+  }
+  data.replace(5000, 5, "patch");
+  const auto patch = co_await file.write(5000, bytes("patch"));
+  EXPECT_EQ(patch.size, 5u);
+  std::vector<std::byte> buffer(3000);
+  while (true) {
+    const auto result = co_await file.read(text.size(), buffer);
+    EXPECT_TRUE(result) << result.error.message();
+    sizes.push_back(result.size);
+    if (!result || result.size == 0) {
+      break;
+    }
+    text.append(reinterpret_cast<const char*>(buffer.data()), result.size);
+  }
+  context.stop();
+}
+
+// Reads a piece of the file and stops the context once all pieces have been read.
+ice::task<void> read_piece(ice::context& context, const ice::file& file, std::size_t offset, std::string& text,
+  std::size_t& remaining) noexcept {
+  std::byte buffer[100];
+  const auto result = co_await file.read(offset, buffer);
+  EXPECT_TRUE(result) << result.error.message();
+  text.replace(offset, result.size, reinterpret_cast<const char*>(buffer), result.size);
+  if (!--remaining) {
+    context.stop();
+  }
+}
+
+ice::task<void> sync(const ice::file& file, std::atomic<std::size_t>& completed) noexcept {
+  co_await file.sync();
+  completed.fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace
+
+// Writes and reads at explicit offsets, and a read that crosses the end of the file returns the bytes up to it.
+TEST(io_service, file_round_trip) {
+  const test::directory directory;
+  ice::context context;
+  ice::io_service service{ context };
+  std::error_code ec;
+  const auto file = ice::file::open(service, directory / "file", ice::file_mode::update, ec);
+  ASSERT_FALSE(ec) << ec.message();
+  auto data = test::data(100000, 1);
+  std::string text;
+  std::vector<std::size_t> sizes;
+  const auto task = round_trip(context, file, data, text, sizes);
+  context.run();
+  EXPECT_TRUE(task.is_ready());
+  EXPECT_TRUE(text == data);
+  ASSERT_EQ(sizes.size(), 35u);
+  EXPECT_EQ(sizes[33], 1000u);
+  EXPECT_EQ(sizes[34], 0u);
+  EXPECT_EQ(file.size(ec), data.size());
+  EXPECT_TRUE(test::read(directory / "file") == data);
+}
+
+// Far more operations than the rings hold can be started at the same time, and none of their completions is lost.
+TEST(io_service, more_operations_than_entries) {
+  const test::directory directory;
+  const auto data = test::data(100000, 2);
+  test::write(directory / "file", data);
+  ice::context context;
+  ice::io_service service{ context, 4 };
+  std::error_code ec;
+  const auto file = ice::file::open(service, directory / "file", ice::file_mode::read, ec);
+  ASSERT_FALSE(ec) << ec.message();
+  std::string text(data.size(), '\0');
+  std::size_t remaining = data.size() / 100;
+  std::vector<ice::task<void>> tasks;
+  for (std::size_t offset = 0; offset < data.size(); offset += 100) {
+    tasks.push_back(read_piece(context, file, offset, text, remaining));
+  }
+  context.run();
+  EXPECT_EQ(remaining, 0u);
+  EXPECT_TRUE(text == data);
+}
+
+// Operations that are in flight when the service is destroyed still resume their coroutines.
+TEST(io_service, destroy_with_operations_in_flight) {
+  const test::directory directory;
+  ice::context context;
+  std::thread thread([&]() { context.run(); });
+  std::atomic<std::size_t> completed = 0;
+  std::vector<ice::file> files;
+  std::vector<ice::task<void>> tasks;
+  {
+    ice::io_service service{ context };
+    for (std::size_t i = 0; i < 64; i++) {
+      const auto path = directory / ("file" + std::to_string(i));
+      test::write(path, test::data(64 << 10, i));
+      std::error_code ec;
+      files.push_back(ice::file::open(service, path, ice::file_mode::update, ec));
+      EXPECT_FALSE(ec) << ec.message();
+    }
+    for (const auto& file : files) {
+      tasks.push_back(sync(file, completed));
+    }
+  }
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (completed.load(std::memory_order_acquire) < files.size() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(completed.load(std::memory_order_acquire), files.size());
+  context.stop();
+  thread.join();
+}
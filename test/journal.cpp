@@ -0,0 +1,184 @@
+#include "common.hpp"
+#include <installer/journal.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::vector<std::string> names = { "a/b/first.bin", "second.bin" };
+
+// Installs version 1 of the files and starts an install of version 2 that stages every file.
+installer::install_journal stage(const std::filesystem::path& target) {
+  for (const auto& name : names) {
+    test::write(target / name, "1:" + name);
+  }
+  std::error_code ec;
+  auto journal = installer::install_journal::begin(target, names, {}, ec);
+  EXPECT_FALSE(ec) << ec.message();
+  for (const auto& name : names) {
+    test::write(journal.staged(name), "2:" + name);
+  }
+  return journal;
+}
+
+void expect_version(const std::filesystem::path& target, char version) {
+  for (const auto& name : names) {
+    EXPECT_EQ(test::read(target / name), std::string{ version } + ":" + name);
+    auto staged = target / name;
+    staged += installer::install_journal::suffix;
+    EXPECT_FALSE(std::filesystem::exists(staged)) << staged;
+  }
+  EXPECT_FALSE(std::filesystem::exists(target / installer::install_journal::filename));
+}
+
+}  // namespace
+
+TEST(journal, finish) {
+  const test::directory directory;
+  auto journal = stage(directory.path());
+  std::error_code ec;
+  journal.commit(ec);
+  ASSERT_FALSE(ec) << ec.message();
+  journal.finish(ec);
+  ASSERT_FALSE(ec) << ec.message();
+  expect_version(directory.path(), '2');
+}
+
+// An install that was interrupted after the commit is rolled forward.
+TEST(journal, recover_committed) {
+  const test::directory directory;
+  {
+    auto journal = stage(directory.path());
+    std::error_code ec;
+    journal.commit(ec);
+    ASSERT_FALSE(ec) << ec.message();
+  }
+  std::error_code ec;
+  installer::install_journal::recover(directory.path(), ec);
+  ASSERT_FALSE(ec) << ec.message();
+  expect_version(directory.path(), '2');
+}
+
+// An install that was interrupted while files were renamed finishes the remaining renames.
+TEST(journal, recover_partly_finished) {
+  const test::directory directory;
+  {
+    auto journal = stage(directory.path());
+    std::error_code ec;
+    journal.commit(ec);
+    ASSERT_FALSE(ec) << ec.message();
+    std::filesystem::rename(journal.staged(names[0]), directory / names[0]);
+  }
+  std::error_code ec;
+  installer::install_journal::recover(directory.path(), ec);
+  ASSERT_FALSE(ec) << ec.message();
+  expect_version(directory.path(), '2');
+}
+
+// An install that was interrupted before the commit is rolled back.
+TEST(journal, recover_uncommitted) {
+  const test::directory directory;
+  stage(directory.path());
+  std::error_code ec;
+  installer::install_journal::recover(directory.path(), ec);
+  ASSERT_FALSE(ec) << ec.message();
+  expect_version(directory.path(), '1');
+}
+
+// A journal that was torn while it was written is removed, since no file was staged yet.
+TEST(journal, recover_torn) {
+  const test::directory directory;
+  for (const auto& name : names) {
+    test::write(directory / name, "1:" + name);
+  }
+  std::error_code ec;
+  installer::install_journal::begin(directory.path(), names, {}, ec);
+  ASSERT_FALSE(ec) << ec.message();
+  const auto path = directory / installer::install_journal::filename;
+  for (const auto size : { std::uintmax_t{ 0 }, std::uintmax_t{ 10 }, std::filesystem::file_size(path) - 1 }) {
+    const auto journal = test::read(path);
+    std::filesystem::resize_file(path, size);
+    installer::install_journal::recover(directory.path(), ec);
+    ASSERT_FALSE(ec) << ec.message();
+    expect_version(directory.path(), '1');
+    test::write(path, journal);
+  }
+}
+
+TEST(journal, recover_without_journal) {
+  const test::directory directory;
+  std::error_code ec;
+  installer::install_journal::recover(directory.path(), ec);
+  EXPECT_FALSE(ec) << ec.message();
+}
+
+// A journal that cannot be read is kept, because it may be committed.
+TEST(journal, recover_unreadable) {
+  const test::directory directory;
+  const auto path = directory / installer::install_journal::filename;
+  std::filesystem::create_directories(path);
+  std::error_code ec;
+  installer::install_journal::recover(directory.path(), ec);
+  EXPECT_TRUE(ec);
+  EXPECT_TRUE(std::filesystem::exists(path));
+}
+
+// A relative target with a trailing separator must not flush directories outside of it.
+TEST(journal, trailing_separator) {
+  const test::directory directory;
+  const auto target = std::filesystem::relative(directory.path()) / "";
+  auto journal = stage(target);
+  std::error_code ec;
+  journal.commit(ec);
+  ASSERT_FALSE(ec) << ec.message();
+  journal.finish(ec);
+  ASSERT_FALSE(ec) << ec.message();
+  expect_version(directory.path(), '2');
+  installer::install_journal::recover(target, ec);
+  EXPECT_FALSE(ec) << ec.message();
+}
+
+// A committed file that is neither staged nor installed fails the recovery and keeps the journal.
+TEST(journal, recover_lost_file) {
+  const test::directory directory;
+  {
+    auto journal = stage(directory.path());
+    std::error_code ec;
+    journal.commit(ec);
+    ASSERT_FALSE(ec) << ec.message();
+    std::filesystem::remove(journal.staged(names[0]));
+    std::filesystem::remove(directory / names[0]);
+  }
+  std::error_code ec;
+  installer::install_journal::recover(directory.path(), ec);
+  EXPECT_EQ(ec, std::errc::no_such_file_or_directory);
+  EXPECT_TRUE(std::filesystem::exists(directory / installer::install_journal::filename));
+}
+
+// Files that the install removes are removed after the commit, together with directories that become empty.
+TEST(journal, recover_removed) {
+  const test::directory directory;
+  test::write(directory / "c/d/old.bin", "1");
+  test::write(directory / "c/kept.bin", "1");
+  test::write(directory / "e/old.bin", "1");
+  {
+    std::error_code ec;
+    auto journal = installer::install_journal::begin(directory.path(), {}, { "c/d/old.bin", "e/old.bin", "missing.bin" }, ec);
+    ASSERT_FALSE(ec) << ec.message();
+    installer::install_journal::recover(directory.path(), ec);
+    ASSERT_FALSE(ec) << ec.message();
+    EXPECT_TRUE(std::filesystem::exists(directory / "e/old.bin"));
+    journal = installer::install_journal::begin(directory.path(), {}, { "c/d/old.bin", "e/old.bin", "missing.bin" }, ec);
+    ASSERT_FALSE(ec) << ec.message();
+    journal.commit(ec);
+    ASSERT_FALSE(ec) << ec.message();
+  }
+  std::error_code ec;
+  installer::install_journal::recover(directory.path(), ec);
+  ASSERT_FALSE(ec) << ec.message();
+  EXPECT_FALSE(std::filesystem::exists(directory / "c/d"));
+  EXPECT_FALSE(std::filesystem::exists(directory / "e"));
+  EXPECT_TRUE(std::filesystem::exists(directory / "c/kept.bin"));
+  EXPECT_FALSE(std::filesystem::exists(directory / installer::install_journal::filename));
+}
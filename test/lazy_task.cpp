@@ -0,0 +1,79 @@
+#include "test.hpp"
+#include <ice/context.hpp>
+#include <ice/lazy_task.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace {
+
+ice::lazy_task<int> value(int value, bool& started) noexcept {
+  started = true;
+  co_return value;
+}
+
+ice::lazy_task<std::unique_ptr<std::string>> text(std::string text) noexcept {
+  co_return std::make_unique<std::string>(std::move(text));
+}
+
+ice::lazy_task<int&> reference(int& value) noexcept {
+  co_return value;
+}
+
+ice::lazy_task<void> add(int& value) noexcept {
+  value++;
+  co_return;
+}
+
+ice::lazy_task<int> sum(std::size_t depth) noexcept {
+  if (depth == 0) {
+    co_return 0;
+  }
+  co_return co_await sum(depth - 1) + 1;
+}
+
+ice::task<std::thread::id> other(ice::context& context) noexcept {
+  co_await ice::schedule(context, true);
+  co_return std::this_thread::get_id();
+}
+
+}  // namespace
+
+// A lazy task does not run before it is awaited.
+TEST(lazy_task, lazy) {
+  bool started = false;
+  auto task = value(7, started);
+  EXPECT_FALSE(started);
+  EXPECT_FALSE(task.is_ready());
+  EXPECT_EQ(ice::sync_wait(std::move(task)), 7);
+  EXPECT_TRUE(started);
+}
+
+TEST(lazy_task, results) {
+  const auto pointer = ice::sync_wait(text("text"));
+  ASSERT_TRUE(pointer);
+  EXPECT_EQ(*pointer, "text");
+
+  int number = 1;
+  int& result = ice::sync_wait(reference(number));
+  EXPECT_EQ(&result, &number);
+
+  ice::sync_wait(add(number));
+  EXPECT_EQ(number, 2);
+
+  EXPECT_EQ(ice::sync_wait(sum(10000)), 10000);
+}
+
+// sync_wait blocks until a task that completes on another thread is done and returns its result.
+TEST(sync_wait, other_thread) {
+  ice::context context;
+  std::thread runner([&]() { context.run(); });
+  const auto id = ice::sync_wait(other(context));
+  context.stop();
+  const auto runner_id = runner.get_id();
+  runner.join();
+  EXPECT_EQ(id, runner_id);
+}
@@ -0,0 +1,91 @@
+#include "common.hpp"
+#include <installer/lz4.hpp>
+#include <random>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+
+std::vector<std::byte> bytes(std::initializer_list<std::uint8_t> values) {
+  std::vector<std::byte> data;
+  for (const auto value : values) {
+    data.push_back(static_cast<std::byte>(value));
+  }
+  return data;
+}
+
+std::vector<std::byte> compress(std::span<const std::byte> data) {
+  std::vector<std::byte> compressed(installer::lz4::bound(data.size()));
+  compressed.resize(installer::lz4::compress(data, compressed));
+  return compressed;
+}
+
+}  // namespace
+
+TEST(lz4, round_trip) {
+  for (const std::size_t size : { 0, 1, 15, 16, 64, 1000, 65536, 300000 }) {
+    const auto text = test::data(size, size);
+    const auto data = std::as_bytes(std::span{ text });
+    const auto compressed = compress(data);
+    ASSERT_TRUE(size == 0 || !compressed.empty()) << size;
+    std::vector<std::byte> output(size);
+    ASSERT_TRUE(installer::lz4::decompress(compressed, output)) << size;
+    EXPECT_TRUE(std::equal(output.begin(), output.end(), data.begin(), data.end())) << size;
+  }
+}
+
+TEST(lz4, incompressible) {
+  std::vector<std::byte> data(4096);
+  std::mt19937 random{ 1 };
+  for (auto& byte : data) {
+    byte = static_cast<std::byte>(random());
+  }
+  std::vector<std::byte> small(data.size() - 1);
+  EXPECT_EQ(installer::lz4::compress(data, small), 0u);
+  const auto compressed = compress(data);
+  std::vector<std::byte> output(data.size());
+  ASSERT_TRUE(installer::lz4::decompress(compressed, output));
+  EXPECT_EQ(output, data);
+}
+
+TEST(lz4, wrong_size) {
+  const auto text = test::data(10000, 3);
+  const auto compressed = compress(std::as_bytes(std::span{ text }));
+  std::vector<std::byte> shorter(text.size() - 1);
+  std::vector<std::byte> longer(text.size() + 1);
+  EXPECT_FALSE(installer::lz4::decompress(compressed, shorter));
+  EXPECT_FALSE(installer::lz4::decompress(compressed, longer));
+}
+
+TEST(lz4, corrupt) {
+  std::vector<std::byte> output(64);
+  // Literal length longer than the input.
+  EXPECT_FALSE(installer::lz4::decompress(bytes({ 0x50, 'a', 'b' }), output));
+  // Literal length extension that runs past the input.
+  EXPECT_FALSE(installer::lz4::decompress(bytes({ 0xF0, 255, 255 }), output));
+  // Match with a zero offset.
+  EXPECT_FALSE(installer::lz4::decompress(bytes({ 0x10, 'a', 0, 0 }), output));
+  // Match before the start of the output.
+  EXPECT_FALSE(installer::lz4::decompress(bytes({ 0x10, 'a', 2, 0 }), output));
+  // Offset that is cut off.
+  EXPECT_FALSE(installer::lz4::decompress(bytes({ 0x10, 'a', 1 }), output));
+  // Match that is longer than the output.
+  EXPECT_FALSE(installer::lz4::decompress(bytes({ 0x1F, 'a', 1, 0, 255 }), output));
+}
+
+// Truncated and bit flipped inputs must be rejected or decode to something without writing out of bounds.
+TEST(lz4, damaged) {
+  const auto text = test::data(20000, 7);
+  const auto compressed = compress(std::as_bytes(std::span{ text }));
+  std::vector<std::byte> output(text.size());
+  for (std::size_t size = 0; size < compressed.size(); size += 97) {
+    EXPECT_FALSE(installer::lz4::decompress(std::span{ compressed }.first(size), output)) << size;
+  }
+  std::mt19937 random{ 2 };
+  for (std::size_t i = 0; i < 1000; i++) {
+    auto damaged = compressed;
+    damaged[random() % damaged.size()] ^= static_cast<std::byte>(1 << (random() % 8));
+    installer::lz4::decompress(damaged, output);
+  }
+}
@@ -0,0 +1,31 @@
+#include "test.hpp"
+#include <string_view>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Usage: tests [filter]
+// Runs the tests whose names contain the filter and returns a failure if any check failed.
+int main(int argc, char* argv[]) {
+  if (argc > 2 || (argc == 2 && std::string_view{ argv[1] }.starts_with("--"))) {
+    std::fprintf(stderr, "usage: tests [filter]\n");
+    return EXIT_FAILURE;
+  }
+  const char* filter = argc == 2 ? argv[1] : nullptr;
+  std::size_t failed = 0;
+  std::size_t count = 0;
+  for (const auto& entry : test::registry()) {
+    if (filter && !std::strstr(entry.name, filter)) {
+      continue;
+    }
+    auto& current = test::current();
+    current = { entry.name, 0 };
+    entry.call();
+    std::printf("%-40s %s\n", entry.name, current.failures ? "FAILED" : "ok");
+    std::fflush(stdout);
+    failed += current.failures ? 1 : 0;
+    count++;
+  }
+  std::printf("%zu of %zu tests passed\n", count - failed, count);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
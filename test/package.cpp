@@ -0,0 +1,119 @@
+#include "common.hpp"
+#include <installer/package.hpp>
+#include <installer/package_writer.hpp>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+// Writes a package with two files of several chunks and an empty file.
+installer::package write(const test::directory& directory) {
+  test::write(directory / "source" / "a.bin", test::data(300000, 1));
+  test::write(directory / "source" / "b.bin", test::data(200000, 2));
+  test::write(directory / "source" / "empty.bin", {});
+  installer::package_options options;
+  options.chunk_size = 64 << 10;
+  std::error_code ec;
+  installer::write_package(directory / "source", directory / "package", ec, options);
+  EXPECT_FALSE(ec) << ec.message();
+  return installer::package::open(directory / "package", ec);
+}
+
+// Overwrites a value in the package file.
+template <typename T>
+void patch(const std::filesystem::path& path, std::uint64_t offset, T value) {
+  std::fstream stream{ path, std::ios::in | std::ios::out | std::ios::binary };
+  stream.seekp(static_cast<std::streamoff>(offset));
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+std::uint64_t file_offset(const installer::package& package, std::size_t index, std::size_t member) {
+  return package.header().files_offset + index * sizeof(installer::format::file) + member;
+}
+
+}  // namespace
+
+TEST(package, open) {
+  const test::directory directory;
+  const auto package = write(directory);
+  ASSERT_TRUE(package.is_open());
+  EXPECT_TRUE(package.verify());
+  ASSERT_EQ(package.files().size(), 3u);
+  for (const auto& file : package.files()) {
+    EXPECT_FALSE(package.validate(file)) << package.path(file);
+  }
+  EXPECT_TRUE(package.find("b.bin"));
+  EXPECT_FALSE(package.find("c.bin"));
+}
+
+// Opening a package only checks the header and the table bounds and order.
+TEST(package, corrupt_header) {
+  const test::directory directory;
+  const auto path = directory / "package";
+  installer::format::header header = {};
+  {
+    const auto package = write(directory);
+    ASSERT_TRUE(package.is_open());
+    header = package.header();
+  }
+  const auto original = test::read(path);
+  const auto check = [&](std::uint64_t offset, std::uint64_t value, std::error_code expected) {
+    test::write(path, original);
+    patch(path, offset, value);
+    std::error_code ec;
+    const auto package = installer::package::open(path, ec);
+    EXPECT_EQ(ec, expected) << offset;
+    EXPECT_FALSE(package.is_open()) << offset;
+  };
+  check(offsetof(installer::format::header, magic), 0, installer::package_errc::invalid_magic);
+  check(offsetof(installer::format::header, version), 1, installer::package_errc::unsupported_version);
+  check(offsetof(installer::format::header, file_count), 1ull << 40, installer::package_errc::corrupt_index);
+  check(offsetof(installer::format::header, chunks_offset), original.size(), installer::package_errc::corrupt_index);
+  check(offsetof(installer::format::header, refs_offset), 3, installer::package_errc::corrupt_index);
+  check(offsetof(installer::format::header, data_size), original.size(), installer::package_errc::corrupt_index);
+
+  // Tables that lie within the file but overlap or are out of order would let verify() hash outside of it.
+  check(offsetof(installer::format::header, strings_offset), 0, installer::package_errc::corrupt_index);
+  check(offsetof(installer::format::header, files_offset), header.chunks_offset, installer::package_errc::corrupt_index);
+
+  test::write(path, original.substr(0, 100));
+  std::error_code ec;
+  installer::package::open(path, ec);
+  EXPECT_EQ(ec, installer::package_errc::invalid_magic);
+}
+
+// Entries of a file are checked when the file is used, and extract() refuses a package with a corrupt file.
+TEST(package, corrupt_file) {
+  const test::directory directory;
+  const auto path = directory / "package";
+  std::uint64_t ref_count = 0;
+  std::uint64_t path_offset = 0;
+  std::uint64_t size = 0;
+  std::uint64_t refs = 0;
+  {
+    const auto package = write(directory);
+    ASSERT_EQ(package.path(package.files()[0]), "a.bin");
+    ref_count = file_offset(package, 0, offsetof(installer::format::file, ref_count));
+    path_offset = file_offset(package, 0, offsetof(installer::format::file, path_offset));
+    size = file_offset(package, 2, offsetof(installer::format::file, size));
+    refs = package.header().refs_offset + package.files()[0].ref_offset * sizeof(std::uint32_t);
+  }
+  const auto original = test::read(path);
+  const auto check = [&](auto patch_file) {
+    test::write(path, original);
+    patch_file();
+    std::error_code ec;
+    const auto package = installer::package::open(path, ec);
+    ASSERT_FALSE(ec) << ec.message();
+    const auto files = package.files();
+    EXPECT_TRUE(package.validate(files[0]) || package.validate(files[2]));
+    test::runtime runtime;
+    EXPECT_EQ(runtime.extract(package, directory / "target"), installer::package_errc::corrupt_index);
+  };
+  check([&]() { patch(path, ref_count, std::uint32_t{ 1000 }); });
+  check([&]() { patch(path, ref_count, std::uint32_t{ 0 }); });
+  check([&]() { patch(path, path_offset, std::uint64_t{ 1 } << 40); });
+  check([&]() { patch(path, refs, std::uint32_t{ 1000 }); });
+  check([&]() { patch(path, size, std::uint64_t{ 10 }); });
+}
@@ -0,0 +1,90 @@
+#include "test.hpp"
+#include <ice/context.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <installer/progress.hpp>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Fake user interface that records every update.
+class recording_sink : public installer::progress_sink {
+public:
+  void update(const installer::progress::state& state) noexcept override {
+    updates.push_back(state);
+  }
+
+  std::vector<installer::progress::state> updates;
+};
+
+}  // namespace
+
+TEST(progress, counts_all_threads) {
+  installer::progress progress;
+  progress.start(4000, 4000 * 100);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < 1000; j++) {
+        progress.add(100, 1);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const auto state = progress.sample();
+  EXPECT_EQ(state.files, 4000u);
+  EXPECT_EQ(state.bytes, 400000u);
+  EXPECT_FALSE(state.done);
+  EXPECT_EQ(state.fraction(), 1.0);
+}
+
+// Updates are coalesced per tick, and the last update is the finished state.
+TEST(progress, report) {
+  ice::context context;
+  std::thread runner([&]() { context.run(); });
+  installer::progress progress;
+  recording_sink sink;
+  progress.start(10, 1000);
+  auto report = installer::report(context, progress, sink, std::chrono::milliseconds(1));
+  for (int i = 0; i < 10; i++) {
+    progress.add(100, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  progress.finish();
+  ice::sync_wait(std::move(report));
+  context.stop();
+  runner.join();
+  ASSERT_TRUE(!sink.updates.empty());
+  EXPECT_LE(sink.updates.size(), 12u);
+  EXPECT_TRUE(sink.updates.back().done);
+  EXPECT_EQ(sink.updates.back().bytes, 1000u);
+  for (std::size_t i = 1; i < sink.updates.size(); i++) {
+    EXPECT_TRUE(sink.updates[i] != sink.updates[i - 1]);
+  }
+}
+
+// A progress that is reused keeps reporting after it was started again.
+TEST(progress, restart) {
+  ice::context context;
+  std::thread runner([&]() { context.run(); });
+  installer::progress progress;
+  progress.start(1, 1);
+  progress.finish();
+  recording_sink sink;
+  progress.start(0, 0);
+  auto report = installer::report(context, progress, sink, std::chrono::milliseconds(1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(report.is_ready());
+  progress.start(2, 200);
+  progress.add(200, 2);
+  progress.finish();
+  ice::sync_wait(std::move(report));
+  context.stop();
+  runner.join();
+  ASSERT_TRUE(!sink.updates.empty());
+  EXPECT_EQ(sink.updates.back().files, 2u);
+}
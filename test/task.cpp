@@ -0,0 +1,118 @@
+#include "test.hpp"
+#include <ice/coroutine.hpp>
+#include <ice/task.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#ifdef _MSC_VER
+#define TEST_NOINLINE __declspec(noinline)
+#else
+#define TEST_NOINLINE __attribute__((noinline))
+#endif
+
+namespace {
+
+// Awaitable that suspends until the test resumes it.
+struct trigger {
+  constexpr bool await_ready() const noexcept {
+    return false;
+  }
+
+  void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+    this->awaiter = awaiter;
+  }
+
+  constexpr void await_resume() const noexcept {
+  }
+
+  ice::coroutine_handle<> awaiter;
+};
+
+TEST_NOINLINE std::uintptr_t stack_address() noexcept {
+  volatile char marker = 0;
+  return reinterpret_cast<std::uintptr_t>(&marker);
+}
+
+struct stack_range {
+  void update() noexcept {
+    const auto address = stack_address();
+    lowest = std::min(lowest, address);
+    highest = std::max(highest, address);
+  }
+
+  std::size_t size() const noexcept {
+    return static_cast<std::size_t>(highest - lowest);
+  }
+
+  std::uintptr_t lowest = UINTPTR_MAX;
+  std::uintptr_t highest = 0;
+};
+
+ice::task<int> chain(std::size_t depth, trigger& trigger, stack_range& stack) noexcept {
+  if (depth == 0) {
+    co_await trigger;
+    stack.update();
+    co_return 0;
+  }
+  const auto value = co_await chain(depth - 1, trigger, stack);
+  stack.update();
+  co_return static_cast<int>(value + 1);
+}
+
+ice::task<int> step(trigger& trigger) noexcept {
+  co_await trigger;
+  co_return 1;
+}
+
+ice::task<int> steps(std::size_t count, trigger& trigger, stack_range& stack) noexcept {
+  int sum = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    sum += co_await step(trigger);
+    stack.update();
+  }
+  co_return sum;
+}
+
+// Stores the result of a task that completed.
+ice::task<void> get(ice::task<int>& task, int& value) noexcept {
+  value = co_await task;
+}
+
+}  // namespace
+
+// Completing the innermost task of a deep chain resumes every level with symmetric transfer instead of nesting
+// a resume() call per level on the stack.
+TEST(task, chain_stack) {
+  constexpr std::size_t depth = 4096;
+  trigger trigger;
+  stack_range stack;
+  auto task = chain(depth, trigger, stack);
+  stack = {};
+  stack.update();
+  trigger.awaiter.resume();
+  ASSERT_TRUE(task.is_ready());
+  int value = 0;
+  const auto result = get(task, value);
+  EXPECT_TRUE(result.is_ready());
+  EXPECT_EQ(value, static_cast<int>(depth));
+  EXPECT_LT(stack.size(), 16u << 10);
+}
+
+// A loop that awaits many tasks which suspend and complete one by one uses the same stack for every task.
+TEST(task, loop_stack) {
+  constexpr std::size_t count = 100'000;
+  trigger trigger;
+  stack_range stack;
+  stack.update();
+  auto task = steps(count, trigger, stack);
+  while (!task.is_ready()) {
+    trigger.awaiter.resume();
+  }
+  int value = 0;
+  const auto result = get(task, value);
+  EXPECT_TRUE(result.is_ready());
+  EXPECT_EQ(value, static_cast<int>(count));
+  EXPECT_LT(stack.size(), 16u << 10);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdio>
+
+namespace test {
+
+using function = void (*)();
+
+struct entry {
+  const char* name;
+  function call;
+};
+
+inline std::vector<entry>& registry() {
+  static std::vector<entry> entries;
+  return entries;
+}
+
+struct registration {
+  registration(const char* name, function call) {
+    registry().push_back({ name, call });
+  }
+};
+
+// Name of the running test and the number of failed checks in it.
+struct state {
+  const char* name = "";
+  std::size_t failures = 0;
+};
+
+inline state& current() noexcept {
+  static state state;
+  return state;
+}
+
+// Collects the message of a failed check and reports it when it goes out of scope.
+class failure {
+public:
+  failure(const char* file, int line, const char* check) {
+    message_ << file << ':' << line << ": " << check;
+  }
+
+  failure(const failure& other) = delete;
+  failure& operator=(const failure& other) = delete;
+
+  ~failure() {
+    current().failures++;
+    std::fprintf(stderr, "%s\n", message_.str().c_str());
+  }
+
+  template <typename T>
+  failure& operator<<(const T& value) {
+    message_ << (first_ ? ": " : "") << value;
+    first_ = false;
+    return *this;
+  }
+
+private:
+  std::ostringstream message_;
+  bool first_ = true;
+};
+
+// Turns a failure into void, so that a failed assertion can return from the test.
+struct fatal {
+  void operator=(const failure&) const noexcept {
+  }
+};
+
+}  // namespace test
+
+#define TEST(suite, name)                                                                                                                  \
+  static void suite##_##name();                                                                                                            \
+  static const test::registration suite##_##name##_registration{ #suite "." #name, suite##_##name };                                      \
+  static void suite##_##name()
+
+// Checks continue the test when they fail, assertions return from it. Both accept a message with operator<<.
+#define TEST_CHECK(condition, text, on_failure)                                                                                            \
+  if (condition)                                                                                                                           \
+    ;                                                                                                                                      \
+  else                                                                                                                                     \
+    on_failure test::failure(__FILE__, __LINE__, text)
+
+#define EXPECT_TRUE(condition) TEST_CHECK(static_cast<bool>(condition), "expected " #condition, )
+#define EXPECT_FALSE(condition) TEST_CHECK(!static_cast<bool>(condition), "expected !" #condition, )
+#define EXPECT_EQ(lhs, rhs) TEST_CHECK((lhs) == (rhs), "expected " #lhs " == " #rhs, )
+#define EXPECT_LT(lhs, rhs) TEST_CHECK((lhs) < (rhs), "expected " #lhs " < " #rhs, )
+#define EXPECT_LE(lhs, rhs) TEST_CHECK((lhs) <= (rhs), "expected " #lhs " <= " #rhs, )
+#define ASSERT_TRUE(condition) TEST_CHECK(static_cast<bool>(condition), "expected " #condition, return test::fatal{} =)
+#define ASSERT_FALSE(condition) TEST_CHECK(!static_cast<bool>(condition), "expected !" #condition, return test::fatal{} =)
+#define ASSERT_EQ(lhs, rhs) TEST_CHECK((lhs) == (rhs), "expected " #lhs " == " #rhs, return test::fatal{} =)
@@ -0,0 +1,95 @@
+#include "test.hpp"
+#include <ice/context.hpp>
+#include <ice/task.hpp>
+#include <ice/timer.hpp>
+#include <chrono>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+ice::task<void> sleep(ice::context& context, std::chrono::milliseconds duration, int value, std::vector<int>& order) noexcept {
+  co_await ice::schedule(context, true);
+  co_await ice::sleep_for(context, duration);
+  order.push_back(value);
+}
+
+ice::task<int> delay(ice::context& context, std::chrono::milliseconds duration, int value) noexcept {
+  co_await ice::schedule(context, true);
+  co_await ice::sleep_for(context, duration);
+  co_return value;
+}
+
+// Awaits the tasks and stops the context, so that run() returns on the test thread.
+ice::task<void> join(ice::context& context, std::vector<ice::task<void>>& tasks) noexcept {
+  for (auto& task : tasks) {
+    co_await task;
+  }
+  context.stop();
+}
+
+// Stores the result of with_timeout and stops the context after the delay, so that the task completes first.
+ice::task<void> timeout(ice::context& context, std::chrono::milliseconds duration, std::chrono::milliseconds timeout,
+  std::optional<int>& result) noexcept {
+  co_await ice::schedule(context, true);
+  result = co_await ice::with_timeout(context, delay(context, duration, 7), timeout);
+  co_await ice::sleep_for(context, duration);
+  context.stop();
+}
+
+ice::task<void> wait(ice::context& context, bool& expired) noexcept {
+  co_await ice::schedule(context, true);
+  expired = co_await ice::sleep_for(context, 1h);
+}
+
+}  // namespace
+
+// Timers resume in deadline order, not in the order they were scheduled.
+TEST(timer, sleep_for_order) {
+  ice::context context;
+  std::vector<int> order;
+  std::vector<ice::task<void>> tasks;
+  tasks.push_back(sleep(context, 30ms, 3, order));
+  tasks.push_back(sleep(context, 10ms, 1, order));
+  tasks.push_back(sleep(context, 20ms, 2, order));
+  const auto task = join(context, tasks);
+  context.run();
+  EXPECT_TRUE(task.is_ready());
+  EXPECT_EQ(order, (std::vector<int>{ 1, 2, 3 }));
+}
+
+TEST(timer, with_timeout_completes) {
+  ice::context context;
+  std::optional<int> result;
+  const auto start = ice::context::clock::now();
+  const auto task = timeout(context, 1ms, 10s, result);
+  context.run();
+  EXPECT_LT(ice::context::clock::now() - start, 5s);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(*result, 7);
+}
+
+// The task keeps running after the timeout expired and completes in the background.
+TEST(timer, with_timeout_expires) {
+  ice::context context;
+  std::optional<int> result = 0;
+  const auto task = timeout(context, 50ms, 1ms, result);
+  context.run();
+  EXPECT_TRUE(task.is_ready());
+  EXPECT_FALSE(result.has_value());
+}
+
+// Stopping the context resumes pending timers as cancelled instead of leaking their coroutines.
+TEST(timer, stop_cancels_pending) {
+  ice::context context;
+  std::thread runner([&]() { context.run(); });
+  bool expired = true;
+  auto task = wait(context, expired);
+  context.stop();
+  runner.join();
+  EXPECT_TRUE(task.is_ready());
+  EXPECT_FALSE(expired);
+}
@@ -0,0 +1,83 @@
+#include "test.hpp"
+#include <ice/trace.hpp>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace {
+
+const ice::trace::stage plain_stage{ "test.plain" };
+const ice::trace::stage quoted_stage{ "test \"quoted\" \\ \n" };
+
+// Returns whether the braces and brackets outside of strings are balanced.
+bool balanced(std::string_view text) noexcept {
+  std::string open;
+  auto quoted = false;
+  for (std::size_t i = 0; i < text.size(); i++) {
+    const auto c = text[i];
+    if (quoted) {
+      if (c == '\\') {
+        i++;
+      } else if (c == '"') {
+        quoted = false;
+      }
+    } else if (c == '"') {
+      quoted = true;
+    } else if (c == '{' || c == '[') {
+      open.push_back(c == '{' ? '}' : ']');
+    } else if (c == '}' || c == ']') {
+      if (open.empty() || open.back() != c) {
+        return false;
+      }
+      open.pop_back();
+    }
+  }
+  return !quoted && open.empty();
+}
+
+std::string chrome_trace() {
+  const auto file = std::tmpfile();
+  ice::trace::write_chrome_trace(file);
+  std::string text;
+  std::rewind(file);
+  char buffer[4096];
+  while (const auto size = std::fread(buffer, 1, sizeof(buffer), file)) {
+    text.append(buffer, size);
+  }
+  std::fclose(file);
+  return text;
+}
+
+std::size_t count(std::string_view text, std::string_view pattern) noexcept {
+  std::size_t count = 0;
+  for (auto pos = text.find(pattern); pos != std::string_view::npos; pos = text.find(pattern, pos + 1)) {
+    count++;
+  }
+  return count;
+}
+
+}  // namespace
+
+// The Chrome trace of spans on several threads is well formed, also with stage names that need escaping.
+TEST(trace, chrome_trace) {
+  ice::trace::reset();
+  EXPECT_TRUE(balanced(chrome_trace()));
+
+  ice::trace::enable();
+  {
+    ice::trace::span span{ plain_stage, 100 };
+  }
+  std::thread([]() {
+    ice::trace::span span{ quoted_stage };
+  }).join();
+  ice::trace::record(quoted_stage, ice::trace::now(), ice::trace::now());
+  ice::trace::enable(false);
+
+  const auto text = chrome_trace();
+  ice::trace::reset();
+  EXPECT_TRUE(balanced(text)) << text;
+  EXPECT_EQ(count(text, R"("ph":"X")"), 3u);
+  EXPECT_EQ(count(text, R"("name":"test \"quoted\" \\ \u000a")"), 2u);
+}
@@ -0,0 +1,131 @@
+#include "common.hpp"
+#include <installer/directory_transport.hpp>
+#include <installer/transport.hpp>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Transport that fails one write and tracks which files are open.
+class failing_transport final : public installer::transport {
+public:
+  explicit failing_transport(std::size_t fail) noexcept : fail_(fail) {
+  }
+
+  ice::task<std::error_code> open(handle file, std::string_view /*path*/, std::uint64_t /*size*/) noexcept override {
+    opened_.insert(file);
+    opens++;
+    co_return std::error_code{};
+  }
+
+  ice::task<std::error_code> write(handle file, std::uint64_t /*offset*/, std::span<const std::byte> /*data*/) noexcept override {
+    if (!opened_.count(file)) {
+      co_return std::make_error_code(std::errc::bad_file_descriptor);
+    }
+    if (writes++ == fail_) {
+      co_return std::make_error_code(std::errc::io_error);
+    }
+    co_return std::error_code{};
+  }
+
+  ice::task<std::error_code> close(handle file) noexcept override {
+    closes++;
+    co_return opened_.erase(file) ? std::error_code{} : std::make_error_code(std::errc::bad_file_descriptor);
+  }
+
+  std::size_t open_files() const noexcept {
+    return opened_.size();
+  }
+
+  std::size_t opens = 0;
+  std::size_t writes = 0;
+  std::size_t closes = 0;
+
+private:
+  const std::size_t fail_;
+  std::set<handle> opened_;
+};
+
+std::span<const std::byte> bytes(std::string_view data) noexcept {
+  return std::as_bytes(std::span{ data.data(), data.size() });
+}
+
+// Starts the writes of one file and opens many other files while they are in flight, then closes every file.
+ice::task<std::error_code> open_while_writing(ice::context& context, installer::transport& transport, std::string_view data,
+  installer::transport::handle files) noexcept {
+  co_await ice::schedule(context, true);
+  auto ec = co_await transport.open(0, "a.bin", data.size());
+  std::vector<ice::task<std::error_code>> writes;
+  for (std::size_t offset = 0; offset < data.size() && !ec; offset += 4096) {
+    writes.push_back(transport.write(0, offset, bytes(data.substr(offset, 4096))));
+  }
+  for (installer::transport::handle file = 1; file < files && !ec; file++) {
+    ec = co_await transport.open(file, "b/" + std::to_string(file), 0);
+  }
+  for (auto& write : writes) {
+    if (const auto result = co_await std::move(write); result && !ec) {
+      ec = result;
+    }
+  }
+  for (installer::transport::handle file = 0; file < files; file++) {
+    if (const auto result = co_await transport.close(file); result && !ec) {
+      ec = result;
+    }
+  }
+  co_return ec;
+}
+
+}  // namespace
+
+// A write that fails stops the push and closes the file that was being written.
+TEST(transport, write_error) {
+  const test::directory directory;
+  test::write(directory / "a.bin", test::data(100, 1));
+  test::write(directory / "b.bin", test::data(5000, 2));
+  test::write(directory / "c.bin", test::data(100, 3));
+  const std::vector<installer::push_entry> entries = {
+    { directory / "a.bin", "a.bin" },
+    { directory / "b.bin", "b.bin" },
+    { directory / "c.bin", "c.bin" },
+  };
+  failing_transport transport{ 3 };
+  const auto ec = ice::sync_wait(installer::push(transport, entries, { 100, 4 }));
+  EXPECT_EQ(ec, std::errc::io_error);
+  EXPECT_EQ(transport.opens, 2u);
+  EXPECT_EQ(transport.closes, 2u);
+  EXPECT_EQ(transport.open_files(), 0u);
+  EXPECT_LT(transport.writes, 51u);
+}
+
+TEST(transport, push) {
+  const test::directory directory;
+  test::write(directory / "a.bin", test::data(1000, 1));
+  test::write(directory / "b.bin", {});
+  const std::vector<installer::push_entry> entries = {
+    { directory / "a.bin", "a.bin" },
+    { directory / "b.bin", "b.bin" },
+  };
+  failing_transport transport{ std::size_t(-1) };
+  const auto ec = ice::sync_wait(installer::push(transport, entries, { 100, 4 }));
+  EXPECT_FALSE(ec) << ec.message();
+  EXPECT_EQ(transport.opens, 2u);
+  EXPECT_EQ(transport.writes, 10u);
+  EXPECT_EQ(transport.closes, 2u);
+  EXPECT_EQ(transport.open_files(), 0u);
+}
+
+// Files that are opened while writes are in flight do not disturb the writes, even when the directory transport
+// has to grow its table of open files.
+TEST(transport, open_while_writing) {
+  const test::directory directory;
+  const auto data = test::data(100000, 1);
+  test::runtime runtime;
+  installer::directory_transport transport{ runtime.service, directory / "target" };
+  const auto ec = ice::sync_wait(open_while_writing(runtime.context, transport, data, 257));
+  EXPECT_FALSE(ec) << ec.message();
+  EXPECT_TRUE(test::read(directory / "target" / "a.bin") == data);
+  EXPECT_TRUE(std::filesystem::exists(directory / "target" / "b" / "256"));
+}
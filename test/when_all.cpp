@@ -0,0 +1,107 @@
+#include "test.hpp"
+#include <ice/coroutine.hpp>
+#include <ice/task.hpp>
+#include <ice/when_all.hpp>
+#include <vector>
+
+namespace {
+
+// Awaitable that suspends until the test resumes it.
+struct trigger {
+  constexpr bool await_ready() const noexcept {
+    return false;
+  }
+
+  void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+    this->awaiter = awaiter;
+  }
+
+  constexpr void await_resume() const noexcept {
+  }
+
+  ice::coroutine_handle<> awaiter;
+};
+
+ice::task<int> wait(trigger& trigger, int value) noexcept {
+  co_await trigger;
+  co_return value;
+}
+
+ice::task<void> wait(trigger& trigger, bool& done) noexcept {
+  co_await trigger;
+  done = true;
+}
+
+ice::task<int> ready(int value) noexcept {
+  co_return value;
+}
+
+ice::task<int> both(ice::task<int> value, ice::task<void> done) noexcept {
+  co_await ice::when_all(value, done);
+  co_await done;
+  co_return co_await value;
+}
+
+ice::task<int> sum(std::vector<ice::task<int>>& tasks) noexcept {
+  co_await ice::when_all(tasks);
+  int sum = 0;
+  for (auto& task : tasks) {
+    sum += co_await task;
+  }
+  co_return sum;
+}
+
+// Stores the result of a task that completed.
+ice::task<void> get(ice::task<int>& task, int& value) noexcept {
+  value = co_await task;
+}
+
+}  // namespace
+
+// The awaiting coroutine resumes after the last task completes, in whatever order they complete.
+TEST(when_all, tasks) {
+  trigger triggers[2];
+  bool done = false;
+  auto task = both(wait(triggers[0], 7), wait(triggers[1], done));
+  triggers[1].awaiter.resume();
+  EXPECT_TRUE(done);
+  EXPECT_FALSE(task.is_ready());
+  triggers[0].awaiter.resume();
+  ASSERT_TRUE(task.is_ready());
+  int value = 0;
+  const auto result = get(task, value);
+  EXPECT_TRUE(result.is_ready());
+  EXPECT_EQ(value, 7);
+}
+
+TEST(when_all, range) {
+  trigger triggers[8];
+  std::vector<ice::task<int>> tasks;
+  for (int i = 0; i < 8; i++) {
+    tasks.push_back(wait(triggers[i], i));
+  }
+  auto task = sum(tasks);
+  for (int i = 7; i > 0; i--) {
+    triggers[i].awaiter.resume();
+    EXPECT_FALSE(task.is_ready());
+  }
+  triggers[0].awaiter.resume();
+  ASSERT_TRUE(task.is_ready());
+  int value = 0;
+  const auto result = get(task, value);
+  EXPECT_TRUE(result.is_ready());
+  EXPECT_EQ(value, 28);
+}
+
+// Tasks that are ready before the call complete the wait without suspending.
+TEST(when_all, ready) {
+  std::vector<ice::task<int>> tasks;
+  tasks.push_back(ready(1));
+  tasks.push_back(ready(2));
+  auto task = sum(tasks);
+  ASSERT_TRUE(task.is_ready());
+  int value = 0;
+  const auto result = get(task, value);
+  EXPECT_TRUE(result.is_ready());
+  EXPECT_EQ(value, 3);
+}
@@ -0,0 +1,72 @@
+#include "test.hpp"
+#include <ice/coroutine.hpp>
+#include <ice/sync_wait.hpp>
+#include <ice/task.hpp>
+#include <ice/when_any.hpp>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Awaitable that suspends until the test resumes it.
+struct trigger {
+  constexpr bool await_ready() const noexcept {
+    return false;
+  }
+
+  void await_suspend(ice::coroutine_handle<> awaiter) noexcept {
+    this->awaiter = awaiter;
+  }
+
+  constexpr void await_resume() const noexcept {
+  }
+
+  ice::coroutine_handle<> awaiter;
+};
+
+ice::task<int> wait(trigger& trigger, int value) noexcept {
+  co_await trigger;
+  co_return value;
+}
+
+ice::task<int> ready(int value) noexcept {
+  co_return value;
+}
+
+ice::task<std::size_t> first(std::vector<ice::task<int>> tasks, int& value) noexcept {
+  auto [index, task] = co_await ice::when_any(std::move(tasks));
+  value = co_await std::move(task);
+  co_return index;
+}
+
+}  // namespace
+
+// The task that completes first wins, not the ready task with the lowest index.
+TEST(when_any, first_completed) {
+  trigger triggers[3];
+  std::vector<ice::task<int>> tasks;
+  for (int i = 0; i < 3; i++) {
+    tasks.push_back(wait(triggers[i], i));
+  }
+  int value = -1;
+  auto task = first(std::move(tasks), value);
+  triggers[2].awaiter.resume();
+  ASSERT_TRUE(task.is_ready());
+  triggers[0].awaiter.resume();
+  triggers[1].awaiter.resume();
+  EXPECT_EQ(ice::sync_wait(std::move(task)), 2u);
+  EXPECT_EQ(value, 2);
+}
+
+TEST(when_any, ready_before_await) {
+  trigger trigger;
+  std::vector<ice::task<int>> tasks;
+  tasks.push_back(wait(trigger, 0));
+  tasks.push_back(ready(1));
+  int value = -1;
+  auto task = first(std::move(tasks), value);
+  ASSERT_TRUE(task.is_ready());
+  EXPECT_EQ(ice::sync_wait(std::move(task)), 1u);
+  EXPECT_EQ(value, 1);
+  trigger.awaiter.resume();
+}